@@ -0,0 +1,64 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#include "Benchmarks.h"
+
+using namespace YANNL;
+
+//! Usage: bench [--filter=<substring>] [--min-time=<seconds>] [--output=<file.json>]
+//!   [--data=<directory>] [--tmp=<directory>]
+//! Results are written as JSON to the output file, or to the standard output by
+//! default. Progress is written to the standard error.
+int main(int argc, char* argv[])
+{
+    std::string filter, output, dataPath = "../data", tmpPath = "../output";
+    double minSeconds = 0.5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg(argv[i]);
+        const size_t eq = arg.find('=');
+        const std::string key = arg.substr(0, eq);
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+        if (key == "--filter") { filter = value; }
+        else if (key == "--min-time") { minSeconds = std::stod(value); }
+        else if (key == "--output") { output = value; }
+        else if (key == "--data") { dataPath = value; }
+        else if (key == "--tmp") { tmpPath = value; }
+        else
+        {
+            std::cerr << "Unknown argument " << arg << "\n"
+                << "Usage: bench [--filter=<substring>] [--min-time=<seconds>] [--output=<file.json>]"
+                << " [--data=<directory>] [--tmp=<directory>]\n";
+            return 1;
+        }
+    }
+
+    try
+    {
+        YANNL_Benchmarks benchmarks(minSeconds, filter, dataPath, tmpPath);
+        benchmarks.execLayerBenchmarks();
+        benchmarks.execSerializationBenchmarks();
+        benchmarks.execReaderBenchmarks();
+        benchmarks.execInferenceBenchmarks();
+        benchmarks.execServingBenchmarks();
+        benchmarks.execTrainingBenchmarks();
+
+        if (output.empty())
+        {
+            benchmarks.writeJSON(std::cout);
+        }
+        else
+        {
+            std::ofstream file(output);
+            benchmarks.writeJSON(file);
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "Exception! " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,1133 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_BENCHMARKS_H
+#define YANNL_BENCHMARKS_H
+
+#include "MLP.h"
+#include "InferenceServer.h"
+#include "MnistReader.h"
+#include "CsvReader.h"
+#include "SimpleXMLReader.h"
+#include "XMLDocument.h"
+#include "NetworkXML.h"
+#include <chrono>   // std::chrono
+#include <cstdio>   // std::remove
+#include <ctime>    // std::time
+#include <stdexcept> // std::runtime_error
+
+using namespace YANNL;
+
+//! Result of one benchmark. Times are per iteration, in nanoseconds.
+struct BenchmarkResult
+{
+    std::string name;
+    size_t iterations = 0;      // Iterations per repetition
+    size_t repetitions = 0;
+    double minNs = 0.0;
+    double medianNs = 0.0;
+    double meanNs = 0.0;
+    double itemsPerIteration = 0.0;
+    //! Percentiles of single calls, only measured by latency benchmarks.
+    double p50Ns = 0.0;
+    double p99Ns = 0.0;
+    //! Measured throughput, for load benchmarks; otherwise derived from medianNs.
+    double itemsPerSecond = 0.0;
+};
+
+class YANNL_Benchmarks
+{
+public:
+    //! @param minSeconds Minimum time spent measuring each benchmark.
+    //! @param filter Only the benchmarks whose name contains @p filter are run.
+    //! @param dataPath Directory of the data files (iris_flowers.csv).
+    //! @param outputPath Directory where temporary files are written.
+    explicit YANNL_Benchmarks(double minSeconds, const std::string& filter,
+        const std::string& dataPath, const std::string& outputPath) :
+        m_MinSeconds(minSeconds), m_Filter(filter), m_DataPath(dataPath), m_OutputPath(outputPath)
+    {
+
+    }
+
+    void execLayerBenchmarks()
+    {
+        for (size_t width : { 16, 64, 256, 1024 })
+        {
+            denseForward(width);
+            denseBackward(width);
+            denseUpdateWeights(width);
+        }
+
+        for (size_t width : { 10, 100, 1000 })
+        {
+            softmaxForward(width);
+        }
+
+        for (size_t width : { 1024, 4096 })
+        {
+            dropoutForward(width, RandomEngine::MersenneTwister);
+            dropoutForward(width, RandomEngine::Philox);
+        }
+
+        // First layer of an MNIST network then a layer on its pooled channels
+        for (ConvAlgorithm algorithm : { ConvAlgorithm::Direct, ConvAlgorithm::Im2col })
+        {
+            convForward(ImageShape(1, 28, 28), 8, 3, algorithm);
+            convForward(ImageShape(1, 28, 28), 8, 5, algorithm);
+            convForward(ImageShape(8, 12, 12), 16, 3, algorithm);
+            convBackward(ImageShape(1, 28, 28), 8, 5, algorithm);
+            convBackward(ImageShape(8, 12, 12), 16, 3, algorithm);
+        }
+    }
+
+    void execSerializationBenchmarks()
+    {
+        saveToFile();
+        loadFromFile();
+        networkXML();
+        checkpoint();
+    }
+
+    void execReaderBenchmarks()
+    {
+        readMnist();
+        readXMLStream();
+        queryXML();
+        readCsv();
+    }
+
+    void execInferenceBenchmarks()
+    {
+        networkPredict();
+        planPredict();
+        planTopClasses();
+        planLatency();
+        sessionLatency();
+    }
+
+    //! Synthetic load on an InferenceServer: closed-loop clients each submit a request
+    //! and wait for its result before the next one. Throughput and latency are reported
+    //! for several maximum batch sizes.
+    void execServingBenchmarks()
+    {
+        for (size_t batchSize : { 1, 4, 16, 64 })
+        {
+            serverLoad(batchSize, 64);
+        }
+    }
+
+    void execTrainingBenchmarks()
+    {
+        irisEpoch();
+        xorEpoch();
+        mnistShapedEpoch();
+        mnistConvEpoch();
+    }
+
+    //! Writes the results as JSON: a context object describing the run and an array
+    //! of benchmarks.
+    void writeJSON(std::ostream& os) const
+    {
+        os.precision(6);
+        os << std::fixed;
+        os << "{\n"
+            << "  \"context\": {\n"
+            << "    \"date\": " << static_cast<long long>(std::time(nullptr)) << ",\n"
+            << "    \"compiler\": \"" << compiler() << "\",\n"
+            << "    \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n"
+            << "    \"min_seconds\": " << m_MinSeconds << "\n"
+            << "  },\n"
+            << "  \"benchmarks\": [";
+
+        for (size_t n = 0; n < m_Results.size(); n++)
+        {
+            const BenchmarkResult& r = m_Results[n];
+            const double itemsPerSecond = r.itemsPerSecond > 0.0 ? r.itemsPerSecond
+                : r.medianNs > 0.0 ? r.itemsPerIteration * 1.0E9 / r.medianNs : 0.0;
+
+            os << (n == 0 ? "\n" : ",\n")
+                << "    {\n"
+                << "      \"name\": \"" << r.name << "\",\n"
+                << "      \"iterations\": " << r.iterations << ",\n"
+                << "      \"repetitions\": " << r.repetitions << ",\n"
+                << "      \"min_ns\": " << r.minNs << ",\n"
+                << "      \"median_ns\": " << r.medianNs << ",\n"
+                << "      \"mean_ns\": " << r.meanNs << ",\n"
+                << "      \"items_per_second\": " << itemsPerSecond;
+
+            if (r.p99Ns > 0.0)
+            {
+                os << ",\n"
+                    << "      \"p50_ns\": " << r.p50Ns << ",\n"
+                    << "      \"p99_ns\": " << r.p99Ns;
+            }
+
+            os << "\n    }";
+        }
+
+        os << "\n  ]\n}\n";
+    }
+
+private:
+    static constexpr size_t kRepetitions = 5;
+    static constexpr size_t kMaxLatencySamples = 1000000;
+
+    const double m_MinSeconds;
+    const std::string m_Filter;
+    const std::string m_DataPath;
+    const std::string m_OutputPath;
+    std::vector<BenchmarkResult> m_Results;
+    volatile double m_Sink = 0.0; // Keeps the measured results alive
+
+    //! Runs @p func enough times for each repetition to last m_MinSeconds / kRepetitions
+    //! and records the time per iteration.
+    //! @param itemsPerIteration Items (samples, weights, bytes...) processed by one call,
+    //!   used to report the throughput.
+    //! @param func Function measured. Returns a value which is accumulated so that the
+    //!   compiler cannot discard the computation.
+    template <class Function>
+    void run(const std::string& name, double itemsPerIteration, Function func)
+    {
+        if (!m_Filter.empty() && name.find(m_Filter) == std::string::npos)
+        {
+            return;
+        }
+
+        std::cerr << ">> Benchmarking " << name << "... ";
+
+        // Calibrate the number of iterations per repetition
+        const double repetitionSeconds = m_MinSeconds / kRepetitions;
+        size_t iterations = 1;
+
+        while (true)
+        {
+            const double seconds = measure(iterations, func);
+
+            if (seconds >= repetitionSeconds || iterations >= (size_t(1) << 30))
+            {
+                break;
+            }
+
+            // Aim slightly above the target to avoid another round
+            const double factor = seconds > 0.0 ? 1.2 * repetitionSeconds / seconds : 10.0;
+            iterations = static_cast<size_t>(std::ceil(iterations * std::min(10.0, std::max(2.0, factor))));
+        }
+
+        std::vector<double> timesNs;
+
+        for (size_t r = 0; r < kRepetitions; r++)
+        {
+            timesNs.push_back(measure(iterations, func) * 1.0E9 / iterations);
+        }
+
+        std::sort(timesNs.begin(), timesNs.end());
+
+        BenchmarkResult result;
+        result.name = name;
+        result.iterations = iterations;
+        result.repetitions = kRepetitions;
+        result.minNs = timesNs.front();
+        result.medianNs = timesNs[timesNs.size() / 2];
+        result.meanNs = std::accumulate(timesNs.begin(), timesNs.end(), 0.0) / timesNs.size();
+        result.itemsPerIteration = itemsPerIteration;
+        m_Results.push_back(result);
+
+        std::cerr << result.medianNs << " ns. \n";
+    }
+
+    //! Times each call of @p func separately, for m_MinSeconds or at most kMaxLatencySamples
+    //! calls, and records the 50th and 99th percentiles of the latency. The calls are
+    //! preceded by a warm-up of 1% of the samples.
+    template <class Function>
+    void runLatency(const std::string& name, Function func)
+    {
+        if (!m_Filter.empty() && name.find(m_Filter) == std::string::npos)
+        {
+            return;
+        }
+
+        std::cerr << ">> Benchmarking " << name << "... ";
+
+        std::vector<double> timesNs;
+        timesNs.reserve(kMaxLatencySamples);
+        double sink = 0.0;
+
+        for (size_t n = 0; n < kMaxLatencySamples / 100; n++)
+        {
+            sink += func();
+        }
+
+        const auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>(m_MinSeconds);
+        auto t0 = std::chrono::steady_clock::now();
+
+        while (timesNs.size() < kMaxLatencySamples && t0 < end)
+        {
+            sink += func();
+            const auto t1 = std::chrono::steady_clock::now();
+            timesNs.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+            t0 = t1;
+        }
+
+        m_Sink = m_Sink + sink;
+        std::sort(timesNs.begin(), timesNs.end());
+
+        BenchmarkResult result;
+        result.name = name;
+        result.iterations = timesNs.size();
+        result.repetitions = 1;
+        result.minNs = timesNs.front();
+        result.medianNs = timesNs[timesNs.size() / 2];
+        result.meanNs = std::accumulate(timesNs.begin(), timesNs.end(), 0.0) / timesNs.size();
+        result.itemsPerIteration = 1.0;
+        result.p50Ns = result.medianNs;
+        result.p99Ns = timesNs[timesNs.size() * 99 / 100];
+        m_Results.push_back(result);
+
+        std::cerr << "p50 " << result.p50Ns << " ns, p99 " << result.p99Ns << " ns. \n";
+    }
+
+    template <class Function>
+    double measure(size_t iterations, Function& func)
+    {
+        double sink = 0.0;
+        auto t0 = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iterations; i++)
+        {
+            sink += func();
+        }
+
+        auto t1 = std::chrono::steady_clock::now();
+        m_Sink = m_Sink + sink;
+
+        return std::chrono::duration<double>(t1 - t0).count();
+    }
+
+    static std::string compiler()
+    {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc " + std::to_string(_MSC_VER);
+#else
+        return "unknown";
+#endif
+    }
+
+    static std::vector<double> randomVector(size_t size, std::mt19937& gen)
+    {
+        std::uniform_real_distribution<double> dist(-1.0, 1.0);
+        std::vector<double> v(size);
+
+        for (double& d : v)
+        {
+            d = dist(gen);
+        }
+
+        return v;
+    }
+
+    void denseForward(size_t width)
+    {
+        std::shared_ptr<SeedGenerator> seedGen = std::make_shared<SeedGenerator>(true, 1);
+        std::shared_ptr<const SGDOptimizer> optimizer = std::make_shared<SGDOptimizer>(0.01, 0.9);
+        HiddenLayer layer(width, width, ActivationFunctions::Logistic, optimizer, seedGen);
+        std::mt19937 gen(2);
+        const std::vector<double> inputs = randomVector(width, gen);
+
+        run("dense_forward/" + std::to_string(width), static_cast<double>(width * width),
+            [&]()
+            {
+                return layer.propagateForward(inputs, false)[0];
+            });
+    }
+
+    void denseBackward(size_t width)
+    {
+        std::shared_ptr<SeedGenerator> seedGen = std::make_shared<SeedGenerator>(true, 1);
+        std::shared_ptr<const SGDOptimizer> optimizer = std::make_shared<SGDOptimizer>(0.01, 0.9);
+        HiddenLayer hidden(width, width, ActivationFunctions::Logistic, optimizer, seedGen);
+        OutputRegressionLayer output(width, width, ActivationFunctions::Logistic, optimizer, seedGen);
+        std::mt19937 gen(2);
+        const std::vector<double> inputs = randomVector(width, gen);
+        const std::vector<double> expected = randomVector(width, gen);
+
+        output.propagateForward(hidden.propagateForward(inputs, false), false);
+        output.propagateBackwardOuputLayer(expected);
+
+        run("dense_backward/" + std::to_string(width), static_cast<double>(width * width),
+            [&]()
+            {
+                hidden.propagateBackwardHiddenLayer(output);
+                return hidden.sumDelta(0);
+            });
+    }
+
+    void denseUpdateWeights(size_t width)
+    {
+        std::shared_ptr<SeedGenerator> seedGen = std::make_shared<SeedGenerator>(true, 1);
+        // Tiny learning rate so that repeated updates do not blow up the weights
+        std::shared_ptr<const SGDOptimizer> optimizer = std::make_shared<SGDOptimizer>(1.0E-9, 0.0);
+        HiddenLayer hidden(width, width, ActivationFunctions::Logistic, optimizer, seedGen);
+        OutputRegressionLayer output(width, width, ActivationFunctions::Logistic, optimizer, seedGen);
+        std::mt19937 gen(2);
+        const std::vector<double> inputs = randomVector(width, gen);
+        const std::vector<double> expected = randomVector(width, gen);
+
+        output.propagateForward(hidden.propagateForward(inputs, false), false);
+        output.propagateBackwardOuputLayer(expected);
+
+        // The update resets the gradients and skips the neurons without gradients,
+        // so each iteration propagates backward again. Subtract dense_backward
+        // to get the cost of the update alone.
+        run("backward_update_weights/" + std::to_string(width), static_cast<double>(width * (width + 1)),
+            [&]()
+            {
+                hidden.propagateBackwardHiddenLayer(output);
+                hidden.updateWeights(1);
+                return hidden.sumDelta(0);
+            });
+    }
+
+    static std::string convName(const std::string& prefix, const ImageShape& shape, size_t filtersN,
+        size_t kernelSize, ConvAlgorithm algorithm)
+    {
+        return prefix + std::to_string(shape.channels) + "x" + std::to_string(shape.height) + "x"
+            + std::to_string(shape.width) + "_f" + std::to_string(filtersN) + "_k" + std::to_string(kernelSize)
+            + (algorithm == ConvAlgorithm::Direct ? "/direct" : "/im2col");
+    }
+
+    void convForward(const ImageShape& shape, size_t filtersN, size_t kernelSize, ConvAlgorithm algorithm)
+    {
+        std::shared_ptr<SeedGenerator> seedGen = std::make_shared<SeedGenerator>(true, 1);
+        std::shared_ptr<const SGDOptimizer> optimizer = std::make_shared<SGDOptimizer>(0.01, 0.9);
+        Conv2DLayer layer(shape, filtersN, kernelSize, 1, 0, ActivationFunctions::Logistic, optimizer, seedGen);
+        layer.setAlgorithm(algorithm);
+        std::mt19937 gen(2);
+        const std::vector<double> inputs = randomVector(shape.size(), gen);
+
+        // Items are multiply-adds
+        run(convName("conv_forward/", shape, filtersN, kernelSize, algorithm),
+            static_cast<double>(layer.size() * shape.channels * kernelSize * kernelSize),
+            [&]()
+            {
+                return layer.propagateForward(inputs, false)[0];
+            });
+    }
+
+    //! Gradients of the filters and deltas of the inputs, asked by a dense layer before.
+    void convBackward(const ImageShape& shape, size_t filtersN, size_t kernelSize, ConvAlgorithm algorithm)
+    {
+        std::shared_ptr<SeedGenerator> seedGen = std::make_shared<SeedGenerator>(true, 1);
+        std::shared_ptr<const SGDOptimizer> optimizer = std::make_shared<SGDOptimizer>(0.01, 0.9);
+        Conv2DLayer layer(shape, filtersN, kernelSize, 1, 0, ActivationFunctions::Logistic, optimizer, seedGen);
+        layer.setAlgorithm(algorithm);
+        OutputRegressionLayer output(10, layer.size(), ActivationFunctions::Logistic, optimizer, seedGen);
+        std::mt19937 gen(2);
+        const std::vector<double> inputs = randomVector(shape.size(), gen);
+        const std::vector<double> expected = randomVector(10, gen);
+
+        output.propagateForward(layer.propagateForward(inputs, false), false);
+        output.propagateBackwardOuputLayer(expected);
+
+        run(convName("conv_backward/", shape, filtersN, kernelSize, algorithm),
+            static_cast<double>(layer.size() * shape.channels * kernelSize * kernelSize),
+            [&]()
+            {
+                layer.propagateBackwardHiddenLayer(output);
+                return layer.sumDelta(0);
+            });
+    }
+
+    void softmaxForward(size_t width)
+    {
+        std::shared_ptr<SeedGenerator> seedGen = std::make_shared<SeedGenerator>(true, 1);
+        std::shared_ptr<const SGDOptimizer> optimizer = std::make_shared<SGDOptimizer>(0.01, 0.9);
+        OutputClassificationLayer layer(width, 64, optimizer, seedGen);
+        std::mt19937 gen(2);
+        const std::vector<double> inputs = randomVector(64, gen);
+
+        run("softmax_forward/" + std::to_string(width), static_cast<double>(width),
+            [&]()
+            {
+                return layer.propagateForward(inputs, false)[0];
+            });
+    }
+
+    void dropoutForward(size_t width, RandomEngine engine)
+    {
+        std::shared_ptr<SeedGenerator> seedGen = std::make_shared<SeedGenerator>(true, 1, engine);
+        DropoutLayer layer(0.5, width, seedGen);
+        std::mt19937 gen(2);
+        const std::vector<double> inputs = randomVector(width, gen);
+        std::vector<double> values(width);
+
+        run(std::string(engine == RandomEngine::Philox ? "dropout_forward_philox/" : "dropout_forward/")
+            + std::to_string(width), static_cast<double>(width),
+            [&]()
+            {
+                values = inputs;
+                layer.propagateForwardInPlace(values, false);
+                return values[0];
+            });
+    }
+
+        //! Network of the MNIST example shape: 784 inputs, 128 hidden, 10 outputs.
+    static NeuralNetwork mnistShapedNetwork()
+    {
+        NeuralNetwork net(28 * 28, 0.01, 0.4, true, 1);
+        net.addHiddenLayer(128, ActivationFunctions::ReLU);
+        net.addOutputClassificationLayer(10);
+
+        return net;
+    }
+
+    //! Network of the MNIST example shape with a dropout layer, trained for a few samples.
+    static NeuralNetwork mnistShapedDropoutNetwork(std::vector<std::vector<double>>& images)
+    {
+        NeuralNetwork net(28 * 28, 0.01, 0.4, true, 1);
+        net.addHiddenLayer(128, ActivationFunctions::ReLU);
+        net.addDropoutLayer(0.5);
+        net.addOutputClassificationLayer(10);
+
+        std::mt19937 gen(2);
+
+        for (size_t n = 0; n < 32; n++)
+        {
+            images.push_back(randomVector(28 * 28, gen));
+            net.propagateForward(images.back());
+            net.propagateBackwardAndUpdateWeights(Utils::convertLabelToVect(n % 10, 0, 9));
+        }
+
+        return net;
+    }
+
+    void networkPredict()
+    {
+        std::vector<std::vector<double>> images;
+        NeuralNetwork net = mnistShapedDropoutNetwork(images);
+        size_t n = 0;
+
+        run("network_predict/784-128-10", 1.0,
+            [&]()
+            {
+                net.propagateForward(images[n++ % images.size()], true);
+                return static_cast<double>(net.probableClass());
+            });
+    }
+
+    void planPredict()
+    {
+        std::vector<std::vector<double>> images;
+        const InferencePlan plan = mnistShapedDropoutNetwork(images).compile();
+        size_t n = 0;
+
+        run("plan_predict/784-128-10", 1.0,
+            [&]()
+            {
+                return static_cast<double>(plan.probableClass(images[n++ % images.size()]));
+            });
+    }
+
+    void planTopClasses()
+    {
+        std::vector<std::vector<double>> images;
+        const InferencePlan plan = mnistShapedDropoutNetwork(images).compile();
+        size_t n = 0;
+
+        run("plan_top_3/784-128-10", 1.0,
+            [&]()
+            {
+                return plan.topClasses(images[n++ % images.size()], 3)[0].second;
+            });
+    }
+
+    void planLatency()
+    {
+        std::vector<std::vector<double>> images;
+        const InferencePlan plan = mnistShapedDropoutNetwork(images).compile();
+        size_t n = 0;
+
+        runLatency("plan_latency/784-128-10",
+            [&]()
+            {
+                return plan.predict(images[n++ % images.size()])[0];
+            });
+    }
+
+    //! Same calculation as plan_latency without allocation per call.
+    void sessionLatency()
+    {
+        std::vector<std::vector<double>> images;
+        InferenceSession session(std::make_shared<InferencePlan>(mnistShapedDropoutNetwork(images).compile()));
+        size_t n = 0;
+
+        runLatency("session_latency/784-128-10",
+            [&]()
+            {
+                return session.predict(images[n++ % images.size()].data())[0];
+            });
+    }
+
+    void serverLoad(size_t batchSize, size_t clientsN)
+    {
+        const std::string name = "server_load/784-128-10/batch:" + std::to_string(batchSize)
+            + "/clients:" + std::to_string(clientsN);
+
+        if (!m_Filter.empty() && name.find(m_Filter) == std::string::npos)
+        {
+            return;
+        }
+
+        std::cerr << ">> Benchmarking " << name << "... ";
+
+        std::vector<std::vector<double>> images;
+        const std::shared_ptr<const InferencePlan> plan =
+            std::make_shared<InferencePlan>(mnistShapedDropoutNetwork(images).compile());
+        InferenceServer server(plan, batchSize);
+
+        std::vector<std::vector<double>> clientTimesNs(clientsN);
+        std::vector<std::thread> clients;
+        const auto t0 = std::chrono::steady_clock::now();
+        const auto end = t0 + std::chrono::duration<double>(m_MinSeconds);
+
+        for (size_t c = 0; c < clientsN; c++)
+        {
+            clients.emplace_back([&, c]()
+                {
+                    double sink = 0.0;
+
+                    for (size_t n = c; std::chrono::steady_clock::now() < end; n++)
+                    {
+                        const auto start = std::chrono::steady_clock::now();
+                        sink += server.predict(images[n % images.size()]).get()[0];
+                        clientTimesNs[c].push_back(std::chrono::duration<double, std::nano>(
+                            std::chrono::steady_clock::now() - start).count());
+                    }
+
+                    m_Sink = m_Sink + sink;
+                });
+        }
+
+        for (std::thread& client : clients)
+        {
+            client.join();
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        std::vector<double> timesNs;
+
+        for (const std::vector<double>& times : clientTimesNs)
+        {
+            timesNs.insert(timesNs.end(), times.cbegin(), times.cend());
+        }
+
+        std::sort(timesNs.begin(), timesNs.end());
+
+        BenchmarkResult result;
+        result.name = name;
+        result.iterations = timesNs.size();
+        result.repetitions = 1;
+        result.minNs = timesNs.front();
+        result.medianNs = timesNs[timesNs.size() / 2];
+        result.meanNs = std::accumulate(timesNs.begin(), timesNs.end(), 0.0) / timesNs.size();
+        result.itemsPerIteration = 1.0;
+        result.p50Ns = result.medianNs;
+        result.p99Ns = timesNs[timesNs.size() * 99 / 100];
+        result.itemsPerSecond = timesNs.size() / seconds;
+        m_Results.push_back(result);
+
+        std::cerr << result.itemsPerSecond << " requests/s, mean batch "
+            << static_cast<double>(server.requestsCount()) / server.batchesCount()
+            << ", p50 " << result.p50Ns << " ns, p99 " << result.p99Ns << " ns. \n";
+    }
+
+    //! A benchmark writing to the output directory first writes its file once: if the
+    //! directory is missing, it would otherwise time failed writes as valid results.
+    //! @returns @p written; false after a message naming the skipped @p benchmarks.
+    static bool checkWritten(const std::string& benchmarks, bool written, const std::string& path)
+    {
+        if (!written)
+        {
+            std::cerr << ">> Skipping " << benchmarks << ": cannot write " << path << ". \n";
+        }
+
+        return written;
+    }
+
+    void saveToFile()
+    {
+        const NeuralNetwork net = mnistShapedNetwork();
+        const std::string path = m_OutputPath + "/bench-network.txt";
+
+        if (!checkWritten("save_to_file", net.saveToFile(path), path))
+        {
+            return;
+        }
+
+        run("save_to_file/784-128-10", static_cast<double>(net.parametersCount()),
+            [&]()
+            {
+                if (!net.saveToFile(path))
+                {
+                    throw std::runtime_error("save_to_file: cannot write " + path + ".");
+                }
+
+                return 1.0;
+            });
+
+        std::remove(path.c_str());
+    }
+
+    void loadFromFile()
+    {
+        const NeuralNetwork net = mnistShapedNetwork();
+        const std::string path = m_OutputPath + "/bench-network.txt";
+
+        if (!checkWritten("load_from_file", net.saveToFile(path), path))
+        {
+            return;
+        }
+
+        run("load_from_file/784-128-10", static_cast<double>(net.parametersCount()),
+            [&]()
+            {
+                return static_cast<double>(NeuralNetwork::loadFromFile(path).parametersCount());
+            });
+
+        std::remove(path.c_str());
+    }
+
+    //! Same network as save_to_file and load_from_file in XML with base64 blocks of weights.
+    void networkXML()
+    {
+        const NeuralNetwork net = mnistShapedNetwork();
+        const std::string path = m_OutputPath + "/bench-network.xml";
+
+        if (!checkWritten("save_xml and load_xml", NetworkXML::saveToFile(net, path), path))
+        {
+            return;
+        }
+
+        run("save_xml/784-128-10", static_cast<double>(net.parametersCount()),
+            [&]()
+            {
+                if (!NetworkXML::saveToFile(net, path))
+                {
+                    throw std::runtime_error("save_xml: cannot write " + path + ".");
+                }
+
+                return 1.0;
+            });
+
+        run("load_xml/784-128-10", static_cast<double>(net.parametersCount()),
+            [&]()
+            {
+                return static_cast<double>(NetworkXML::loadFromFile(path).parametersCount());
+            });
+
+        std::remove(path.c_str());
+    }
+
+    //! Time for which a checkpoint stalls the training, the snapshot, and time to write
+    //! it in full, to compare with save_to_file.
+    void checkpoint()
+    {
+        const NeuralNetwork net = mnistShapedNetwork();
+        const std::string prefix = m_OutputPath + "/bench-checkpoint";
+        TrainingState state;
+
+        run("checkpoint_snapshot/784-128-10", static_cast<double>(net.parametersCount()),
+            [&]()
+            {
+                net.copyTrainingState(state);
+                return state.parameters.back();
+            });
+
+        std::vector<std::string> kept;
+
+        {
+            CheckpointWriter writer(prefix, 1);
+            size_t epoch = 0;
+
+            run("checkpoint_write/784-128-10", static_cast<double>(net.parametersCount()),
+                [&]()
+                {
+                    writer.save(net, ++epoch, 0);
+                    writer.wait();
+                    return static_cast<double>(epoch);
+                });
+
+            kept = writer.checkpoints();
+        }
+
+        for (const std::string& file : kept)
+        {
+            std::remove(file.c_str());
+        }
+
+        std::remove((prefix + ".latest").c_str());
+    }
+
+    //! Writes @p count random 28x28 images and their labels in the MNIST format.
+    static void writeMnistShaped(const std::string& imagesPath, const std::string& labelsPath,
+        uint32_t count)
+    {
+        auto writeBigEndian = [](std::ofstream& file, uint32_t n)
+        {
+            const char bytes[4] = { static_cast<char>(n >> 24), static_cast<char>(n >> 16),
+                static_cast<char>(n >> 8), static_cast<char>(n) };
+            file.write(bytes, 4);
+        };
+
+        std::mt19937 gen(3);
+        std::ofstream images(imagesPath, std::ios::out | std::ios::binary);
+        writeBigEndian(images, 0x803);
+        writeBigEndian(images, count);
+        writeBigEndian(images, 28);
+        writeBigEndian(images, 28);
+
+        for (uint32_t n = 0; n < count * 28 * 28; n++)
+        {
+            images.put(static_cast<char>(gen() & 0xFF));
+        }
+
+        std::ofstream labels(labelsPath, std::ios::out | std::ios::binary);
+        writeBigEndian(labels, 0x801);
+        writeBigEndian(labels, count);
+
+        for (uint32_t n = 0; n < count; n++)
+        {
+            labels.put(static_cast<char>(gen() % 10));
+        }
+    }
+
+    void readMnist()
+    {
+        const uint32_t count = 1000;
+        const std::string imagesPath = m_OutputPath + "/bench-images.idx3-ubyte";
+        const std::string labelsPath = m_OutputPath + "/bench-labels.idx1-ubyte";
+        writeMnistShaped(imagesPath, labelsPath, count);
+
+        run("read_mnist_images/1000", static_cast<double>(count),
+            [&]()
+            {
+                MnistReader::ImageContainer images;
+                return static_cast<double>(MnistReader::readMnist(imagesPath, images).count);
+            });
+
+        run("read_mnist_labels/1000", static_cast<double>(count),
+            [&]()
+            {
+                MnistReader::LabelContainer labels;
+                return static_cast<double>(MnistReader::readMnist(labelsPath, labels));
+            });
+
+        std::remove(imagesPath.c_str());
+        std::remove(labelsPath.c_str());
+    }
+
+    //! Regression-shaped CSV of 20000 rows of 32 features and a target, read with the
+    //! former `file >> double >> char` loop of the Iris example and with CsvReader.
+    void readCsv()
+    {
+        const size_t rowsN = 20000, colsN = 33;
+        const std::string path = m_OutputPath + "/bench-dataset.csv";
+
+        {
+            std::mt19937 gen(3);
+            std::ofstream file(path);
+            file.precision(8);
+
+            for (size_t c = 0; c < colsN; c++)
+            {
+                file << (c == 0 ? "" : ",") << "x" << c;
+            }
+
+            file << "\n";
+
+            for (size_t r = 0; r < rowsN; r++)
+            {
+                const std::vector<double> values = randomVector(colsN, gen);
+
+                for (size_t c = 0; c < colsN; c++)
+                {
+                    file << (c == 0 ? "" : ",") << values[c];
+                }
+
+                file << "\n";
+            }
+        }
+
+        run("read_csv_iostream/20000x33", static_cast<double>(rowsN),
+            [&]()
+            {
+                std::ifstream file(path);
+                std::string line;
+                std::getline(file, line);
+                std::vector<double> values;
+                double value = 0.0;
+                char c = 0;
+
+                while (file >> value)
+                {
+                    values.push_back(value);
+                    file >> c;
+                }
+
+                return static_cast<double>(values.size());
+            });
+
+        for (size_t threadsN : { 1, 4 })
+        {
+            CsvOptions options;
+            options.threadsN = threadsN;
+            options.chunkSize = size_t(1) << 20;
+
+            run("read_csv/20000x33/threads:" + std::to_string(threadsN), static_cast<double>(rowsN),
+                [&]()
+                {
+                    return static_cast<double>(CsvReader::read(path, options).rowsN);
+                });
+        }
+
+        std::remove(path.c_str());
+    }
+
+    //! Document shaped like a serialized network: layers of neurons with attributes and
+    //! numeric values.
+    static std::string networkShapedXML(size_t layersN, size_t neuronsN, size_t weightsN, size_t& nodesN)
+    {
+        std::ostringstream oss;
+        oss.precision(17);
+        std::mt19937 gen(4);
+        std::uniform_real_distribution<double> dist(-1.0, 1.0);
+        nodesN = 1;
+
+        oss << "<network name=\"bench\">\n";
+
+        for (size_t l = 0; l < layersN; l++)
+        {
+            oss << "  <layer index=\"" << l << "\" type=\"hidden\">\n";
+            ++nodesN;
+
+            for (size_t n = 0; n < neuronsN; n++)
+            {
+                oss << "    <neuron index=\"" << n << "\">\n";
+                ++nodesN;
+
+                for (size_t w = 0; w < weightsN; w++)
+                {
+                    oss << "      <weight>" << dist(gen) << "</weight>\n";
+                    ++nodesN;
+                }
+
+                oss << "    </neuron>\n";
+            }
+
+            oss << "  </layer>\n";
+        }
+
+        oss << "</network>\n";
+
+        return oss.str();
+    }
+
+    //! Stream reader and one-buffer parser reading a file: a small document and a
+    //! multi-megabyte one.
+    void readXMLStream()
+    {
+        const std::string path = m_OutputPath + "/bench-network.xml";
+
+        for (size_t neuronsN : { 64, 1024 })
+        {
+            size_t nodesN = 0;
+            const std::string xml = networkShapedXML(4, neuronsN, 16, nodesN);
+            std::ofstream(path, std::ios::binary) << xml;
+
+            run("read_xml_stream/" + std::to_string(nodesN) + "_nodes", static_cast<double>(xml.size()),
+                [&]()
+                {
+                    std::ifstream ifs(path);
+                    return static_cast<double>(YANNL::readXMLStream(ifs)->children.size());
+                });
+
+            run("read_xml_document/" + std::to_string(nodesN) + "_nodes", static_cast<double>(xml.size()),
+                [&]()
+                {
+                    return static_cast<double>(XMLDocument::readFile(path).size());
+                });
+        }
+
+        std::remove(path.c_str());
+    }
+
+    //! Lookup of a node deep in a large document: path parsed at each call, compiled
+    //! once, and compiled with the index of the children by name.
+    void queryXML()
+    {
+        size_t nodesN = 0;
+        std::istringstream iss(networkShapedXML(4, 1024, 16, nodesN));
+        std::unique_ptr<XMLNode> xml = YANNL::readXMLStream(iss);
+        const std::string path = "/network/layer[3]/neuron[1000]/weight[15]";
+        const std::string suffix = "/" + std::to_string(nodesN) + "_nodes";
+
+        run("xml_query/string_path" + suffix, 1.0,
+            [&]()
+            {
+                return static_cast<double>(xml->getNode(path)->value.size());
+            });
+
+        const XMLQuery compiled(path);
+
+        run("xml_query/compiled" + suffix, 1.0,
+            [&]()
+            {
+                return static_cast<double>(compiled.node(*xml)->value.size());
+            });
+
+        const XMLQuery indexed(path, true);
+
+        run("xml_query/compiled_indexed" + suffix, 1.0,
+            [&]()
+            {
+                return static_cast<double>(indexed.node(*xml)->value.size());
+            });
+    }
+
+    //! Trains @p net one epoch on-line on the samples and returns the error.
+    static double trainEpoch(NeuralNetwork& net, const std::vector<std::vector<double>>& inputs,
+        const std::vector<std::vector<double>>& outputs)
+    {
+        double error = 0.0;
+
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            net.propagateForward(inputs[i]);
+            error += net.calcError(outputs[i]);
+            net.propagateBackwardAndUpdateWeights(outputs[i]);
+        }
+
+        return error;
+    }
+
+    void irisEpoch()
+    {
+        std::ifstream file(m_DataPath + "/iris_flowers.csv");
+
+        if (!file)
+        {
+            std::cerr << ">> Skipping iris_epoch: " << m_DataPath << "/iris_flowers.csv not found. \n";
+            return;
+        }
+
+        std::vector<std::vector<double>> inputs, outputs;
+        std::string line;
+        std::getline(file, line); // Ignore header line
+
+        char c; // To eat the commas
+        double sepalLength = 0.0, sepalWidth = 0.0, petalLength = 0.0, petalWidth = 0.0;
+        std::string irisClass;
+
+        while (file >> sepalLength >> c >> sepalWidth >> c >> petalLength >> c
+            >> petalWidth >> c >> irisClass)
+        {
+            inputs.push_back({ sepalLength, sepalWidth, petalLength, petalWidth });
+            outputs.push_back({ irisClass == "iris_setosa" ? 1.0 : 0.0,
+                irisClass == "iris_versicolor" ? 1.0 : 0.0,
+                irisClass == "iris_virginica" ? 1.0 : 0.0 });
+        }
+
+        NeuralNetwork net(4, 0.001, 0.9, true, 10);
+        net.addHiddenLayer(3, ActivationFunctions::Logistic);
+        net.addHiddenLayer(3, ActivationFunctions::Logistic);
+        net.addOutputClassificationLayer(3);
+
+        run("epoch/iris", static_cast<double>(inputs.size()),
+            [&]()
+            {
+                return trainEpoch(net, inputs, outputs);
+            });
+    }
+
+    void xorEpoch()
+    {
+        const std::vector<std::vector<double>> inputs = { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
+        const std::vector<std::vector<double>> outputs = { { 0 }, { 1 }, { 1 }, { 0 } };
+
+        NeuralNetwork net(2, 0.5, 0.9, true, 10);
+        net.addHiddenLayer(5, ActivationFunctions::Logistic);
+        net.addOutputRegressionLayer(1, ActivationFunctions::Logistic);
+
+        run("epoch/xor", static_cast<double>(inputs.size()),
+            [&]()
+            {
+                return trainEpoch(net, inputs, outputs);
+            });
+    }
+
+    void mnistShapedEpoch()
+    {
+        const size_t count = 200;
+        std::mt19937 gen(5);
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        std::vector<std::vector<double>> inputs(count, std::vector<double>(28 * 28));
+        std::vector<std::vector<double>> outputs(count, std::vector<double>(10, 0.0));
+
+        for (size_t i = 0; i < count; i++)
+        {
+            for (double& pixel : inputs[i])
+            {
+                pixel = dist(gen);
+            }
+
+            outputs[i][gen() % 10] = 1.0;
+        }
+
+        NeuralNetwork net = mnistShapedNetwork();
+
+        run("epoch/mnist_shaped_200", static_cast<double>(count),
+            [&]()
+            {
+                return trainEpoch(net, inputs, outputs);
+            });
+    }
+
+    //! Same samples as mnistShapedEpoch() with a convolutional network instead of the
+    //! hidden layer of 128 neurons: 8 filters of 5x5, max pooling of 2x2.
+    void mnistConvEpoch()
+    {
+        const size_t count = 200;
+        std::mt19937 gen(5);
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        std::vector<std::vector<double>> inputs(count, std::vector<double>(28 * 28));
+        std::vector<std::vector<double>> outputs(count, std::vector<double>(10, 0.0));
+
+        for (size_t i = 0; i < count; i++)
+        {
+            for (double& pixel : inputs[i])
+            {
+                pixel = dist(gen);
+            }
+
+            outputs[i][gen() % 10] = 1.0;
+        }
+
+        NeuralNetwork net(28 * 28, 0.01, 0.4, true, 1);
+        net.setInputShape(ImageShape(1, 28, 28));
+        net.addConv2DLayer(8, 5, ActivationFunctions::ISRLU);
+        net.addMaxPoolLayer(2);
+        net.addOutputClassificationLayer(10);
+
+        run("epoch/mnist_conv_200", static_cast<double>(count),
+            [&]()
+            {
+                return trainEpoch(net, inputs, outputs);
+            });
+    }
+};
+
+#endif // YANNL_BENCHMARKS_H
@@ -0,0 +1,658 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_CSV_READER_H
+#define YANNL_CSV_READER_H
+
+#include "SampleStream.h"
+#include "Utils.h"
+#include <algorithm>        // std::find
+#include <cstdint>          // uint64_t
+#include <cstdlib>          // std::strtod
+#include <cstring>          // std::memcpy
+#include <fstream>          // std::ifstream
+#include <memory>           // std::unique_ptr
+#include <sstream>          // std::ostringstream
+#include <string>           // std::string
+#include <unordered_map>    // std::unordered_map
+#include <vector>           // std::vector
+
+namespace YANNL
+{
+
+//! Samples read by CsvReader. The features of all the rows are stored row by row in
+//! one contiguous matrix which can be passed as is to MLP::fit(features, colsN, targets).
+struct CsvDataset
+{
+    size_t rowsN = 0;
+    //! Number of features per row, i.e. number of columns without the target.
+    size_t colsN = 0;
+    //! Names of the features and of the target; empty if the file has no header.
+    std::vector<std::string> featureNames;
+    std::string targetName;
+    //! rowsN * colsN values, row by row.
+    std::vector<double> features;
+    //! Value of the target column of each row, or index of its label in @ref labels.
+    std::vector<double> targets;
+    //! Labels of the target column by index, in their order of first appearance.
+    //! Empty if the target column is numeric.
+    std::vector<std::string> labels;
+
+    //! @returns colsN features of row @p r.
+    const double* row(size_t r) const
+    {
+        return features.data() + r * colsN;
+    }
+
+    //! @returns Targets converted to the type expected by MLP::fit, e.g. t_Labels.
+    template <class T>
+    std::vector<T> targetsAs() const
+    {
+        std::vector<T> converted;
+        converted.reserve(targets.size());
+
+        for (double target : targets)
+        {
+            converted.push_back(static_cast<T>(target));
+        }
+
+        return converted;
+    }
+};
+
+//! Parsing options of CsvReader::read().
+struct CsvOptions
+{
+    char delimiter = ',';
+    //! Whether the first line holds the names of the columns.
+    bool header = true;
+    //! Index of the target column among all the columns; the last one by default.
+    size_t targetColumn = std::string::npos;
+    //! Whether the target column holds labels, mapped to indexes, instead of numbers.
+    bool labels = false;
+    //! Number of threads parsing each chunk, calling thread included.
+    size_t threadsN = 1;
+    //! Number of bytes read at once.
+    size_t chunkSize = size_t(16) << 20;
+};
+
+//! @brief Reader of numeric CSV files, e.g. for regression datasets of several GB.
+//! The file is read by chunks of complete lines with bulk reads. Each chunk is split
+//! at line boundaries between the parsing threads, which write the numbers of their
+//! lines without any allocation per value; the parts are then appended in order.
+//! Fields can be surrounded by spaces but not quoted. Empty lines are skipped.
+class CsvReader
+{
+public:
+    //! @throws std::ios_base::failure If the file cannot be opened.
+    //! @throws std::domain_error If a value is not a number or a line does not have the
+    //!   number of columns of the first line.
+    static CsvDataset read(const std::string& filename, const CsvOptions& options = CsvOptions())
+    {
+        std::ifstream file(filename, std::ios::in | std::ios::binary);
+
+        if (!file)
+        {
+            throw std::ios_base::failure(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Read CSV] Error opening file " << filename << ".").str()
+            );
+        }
+
+        return read(file, options);
+    }
+
+    //! See @ref read(const std::string&, const CsvOptions&).
+    static CsvDataset read(std::istream& is, const CsvOptions& options = CsvOptions())
+    {
+        Reader reader(options);
+        Chunks chunks(options.chunkSize);
+
+        while (chunks.next(is, reader))
+        {
+            // Each call parses one chunk
+        }
+
+        return reader.takeDataset();
+    }
+
+    //! Parses the number in [@p begin, @p end) as std::strtod does, without allocation.
+    //! Numbers of at most 19 significant digits and a power of ten of at most 22 are
+    //! calculated exactly with one multiplication or division; the others are copied
+    //! to a local buffer for std::strtod.
+    //! @returns false if the text is not a number.
+    static bool parseNumber(const char* begin, const char* end, double& value)
+    {
+        static const double kPowersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+            1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+        const char* p = begin;
+        const bool negative = p < end && *p == '-';
+        p += (p < end && (*p == '-' || *p == '+')) ? 1 : 0;
+
+        uint64_t mantissa = 0;
+        int digitsN = 0, exponent = 0;
+        bool anyDigit = false, exact = true;
+
+        for (bool fraction = false; p < end; p++)
+        {
+            if (*p == '.' && !fraction)
+            {
+                fraction = true;
+                continue;
+            }
+
+            if (*p < '0' || *p > '9')
+            {
+                break;
+            }
+
+            anyDigit = true;
+            exponent -= fraction ? 1 : 0;
+
+            if (mantissa != 0 || *p != '0')
+            {
+                exact = exact && digitsN < 19;
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                digitsN++;
+            }
+        }
+
+        if (anyDigit && p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char* e = p + 1;
+            const bool negativeExp = e < end && *e == '-';
+            e += (e < end && (*e == '-' || *e == '+')) ? 1 : 0;
+            int exp = 0;
+
+            for (p = e; p < end && *p >= '0' && *p <= '9'; p++)
+            {
+                exp = exp < 10000 ? exp * 10 + (*p - '0') : exp;
+            }
+
+            anyDigit = p > e;
+            exponent += negativeExp ? -exp : exp;
+        }
+
+        if (anyDigit && p == end && exact && mantissa <= (uint64_t(1) << 53)
+            && exponent >= -22 && exponent <= 22)
+        {
+            const double m = static_cast<double>(mantissa);
+            value = exponent < 0 ? m / kPowersOf10[-exponent] : m * kPowersOf10[exponent];
+            value = negative ? -value : value;
+            return true;
+        }
+
+        // Long numbers, inf, nan...
+        char local[64];
+        const size_t length = static_cast<size_t>(end - begin);
+        std::string copy;
+        const char* text = local;
+
+        if (length < sizeof(local))
+        {
+            std::memcpy(local, begin, length);
+            local[length] = '\0';
+        }
+        else
+        {
+            copy.assign(begin, end);
+            text = copy.c_str();
+        }
+
+        char* parsedEnd = nullptr;
+        value = std::strtod(text, &parsedEnd);
+
+        return length > 0 && parsedEnd == text + length;
+    }
+
+private:
+    friend class CsvSampleStream;
+
+    //! Bulk reads of complete lines.
+    class Chunks
+    {
+    public:
+        explicit Chunks(size_t chunkSize) :
+            m_ChunkSize(std::max<size_t>(1, chunkSize))
+        {
+
+        }
+
+        //! Reads the next chunk and parses its complete lines with @p reader; the
+        //! incomplete last line is kept for the next chunk.
+        //! @returns false once the end of @p is is reached, the last line being parsed.
+        template <class Reader>
+        bool next(std::istream& is, Reader& reader)
+        {
+            m_Buffer.resize(m_PendingN + m_ChunkSize);
+            is.read(m_Buffer.data() + m_PendingN, m_ChunkSize);
+            const size_t size = m_PendingN + static_cast<size_t>(is.gcount());
+            const bool last = !is;
+
+            // Only complete lines are parsed before the end of the stream
+            size_t end = size;
+
+            while (!last && end > 0 && m_Buffer[end - 1] != '\n')
+            {
+                end--;
+            }
+
+            reader.parse(m_Buffer.data(), m_Buffer.data() + end);
+
+            m_PendingN = size - end;
+            std::copy(m_Buffer.begin() + end, m_Buffer.begin() + size, m_Buffer.begin());
+
+            return !last;
+        }
+
+    private:
+        const size_t m_ChunkSize;
+        std::vector<char> m_Buffer;
+        size_t m_PendingN = 0; // Bytes of an incomplete line kept from the previous chunk
+    };
+
+    //! Values of the lines parsed by one thread.
+    struct Part
+    {
+        size_t rowsN = 0;
+        size_t linesN = 0;
+        std::vector<double> features;
+        std::vector<double> targets;
+        //! Labels in their order of first appearance in the part; targets are indexes
+        //! in this list until the part is appended to the dataset.
+        std::vector<std::string> labels;
+        std::string error; // First error of the part, parsing stops there
+    };
+
+    //! State of a reading across the chunks.
+    class Reader
+    {
+    public:
+        explicit Reader(const CsvOptions& options) :
+            m_Options(options), m_HeaderPending(options.header)
+        {
+
+        }
+
+        //! Parses complete lines.
+        void parse(const char* begin, const char* end)
+        {
+            if (m_HeaderPending || m_ColumnsN == 0)
+            {
+                begin = parseFirstLine(begin, end);
+            }
+
+            if (begin == end)
+            {
+                return;
+            }
+
+            const size_t threadsN = std::max<size_t>(1, m_Options.threadsN);
+            std::vector<const char*> bounds{ begin };
+
+            for (size_t t = 1; t < threadsN; t++)
+            {
+                const char* bound = std::max(bounds.back(), begin + (end - begin) * t / threadsN);
+                bound = std::find(bound, end, '\n');
+                bounds.push_back(bound == end ? end : bound + 1);
+            }
+
+            bounds.push_back(end);
+
+            std::vector<Part> parts(threadsN);
+            Utils::parallelFor(threadsN, threadsN,
+                [&](size_t first, size_t last)
+                {
+                    for (size_t t = first; t < last; t++)
+                    {
+                        parsePart(bounds[t], bounds[t + 1], parts[t]);
+                    }
+                });
+
+            for (Part& part : parts)
+            {
+                append(part);
+            }
+        }
+
+        CsvDataset takeDataset()
+        {
+            return std::move(m_Dataset);
+        }
+
+        //! Rows parsed so far; labels are kept between chunks.
+        const CsvDataset& dataset() const
+        {
+            return m_Dataset;
+        }
+
+        //! Removes the rows parsed so far but keeps the labels.
+        void clearRows()
+        {
+            m_Dataset.rowsN = 0;
+            m_Dataset.features.clear();
+            m_Dataset.targets.clear();
+        }
+
+        //! @returns Number of columns, target included; 0 until the first line is parsed.
+        size_t columnsCount() const
+        {
+            return m_ColumnsN;
+        }
+
+    private:
+        const CsvOptions m_Options;
+        bool m_HeaderPending = true;
+        size_t m_ColumnsN = 0; // Target included
+        size_t m_TargetColumn = 0;
+        size_t m_LinesN = 0;
+        CsvDataset m_Dataset;
+        std::unordered_map<std::string, size_t> m_LabelIndexes;
+
+        //! Reads the header or counts the columns of the first non-empty line.
+        //! @returns Beginning of the data lines.
+        const char* parseFirstLine(const char* begin, const char* end)
+        {
+            while (begin != end)
+            {
+                const char* lineEnd = std::find(begin, end, '\n');
+                const char* next = lineEnd == end ? end : lineEnd + 1;
+                trim(begin, lineEnd);
+
+                if (begin == lineEnd)
+                {
+                    m_LinesN++;
+                    begin = next;
+                    continue;
+                }
+
+                std::vector<std::string> names;
+
+                for (const char* field = begin; field <= lineEnd; )
+                {
+                    const char* fieldEnd = std::find(field, lineEnd, m_Options.delimiter);
+                    const char* nameBegin = field;
+                    const char* nameEnd = fieldEnd;
+                    trim(nameBegin, nameEnd);
+                    names.emplace_back(nameBegin, nameEnd);
+                    field = fieldEnd + 1;
+                }
+
+                m_ColumnsN = names.size();
+                m_TargetColumn = m_Options.targetColumn < m_ColumnsN ? m_Options.targetColumn : m_ColumnsN - 1;
+                m_Dataset.colsN = m_ColumnsN - 1;
+
+                if (!m_HeaderPending)
+                {
+                    return begin;
+                }
+
+                m_HeaderPending = false;
+                m_LinesN++;
+                m_Dataset.targetName = names[m_TargetColumn];
+                names.erase(names.begin() + m_TargetColumn);
+                m_Dataset.featureNames = std::move(names);
+
+                return next;
+            }
+
+            return begin;
+        }
+
+        void parsePart(const char* begin, const char* end, Part& part) const
+        {
+            std::unordered_map<std::string, size_t> labelIndexes;
+            std::string label; // Reused key, allocated once
+
+            for (const char* line = begin; line < end; )
+            {
+                const char* lineEnd = std::find(line, end, '\n');
+                const char* next = lineEnd == end ? end : lineEnd + 1;
+                part.linesN++;
+                trim(line, lineEnd);
+
+                if (line == lineEnd)
+                {
+                    line = next;
+                    continue;
+                }
+
+                size_t column = 0;
+
+                for (const char* field = line; field <= lineEnd; column++)
+                {
+                    const char* fieldEnd = std::find(field, lineEnd, m_Options.delimiter);
+                    const char* valueBegin = field;
+                    const char* valueEnd = fieldEnd;
+                    trim(valueBegin, valueEnd);
+                    field = fieldEnd + 1;
+
+                    if (column >= m_ColumnsN)
+                    {
+                        continue; // Only counted
+                    }
+
+                    if (column == m_TargetColumn && m_Options.labels)
+                    {
+                        label.assign(valueBegin, valueEnd);
+                        auto inserted = labelIndexes.emplace(label, part.labels.size());
+
+                        if (inserted.second)
+                        {
+                            part.labels.push_back(label);
+                        }
+
+                        part.targets.push_back(static_cast<double>(inserted.first->second));
+                        continue;
+                    }
+
+                    double value = 0.0;
+
+                    if (!parseNumber(valueBegin, valueEnd, value))
+                    {
+                        part.error = "invalid number '" + std::string(valueBegin, valueEnd)
+                            + "' in column " + std::to_string(column) + ".";
+                        return;
+                    }
+
+                    (column == m_TargetColumn ? part.targets : part.features).push_back(value);
+                }
+
+                if (column != m_ColumnsN)
+                {
+                    part.error = std::to_string(column) + " columns instead of "
+                        + std::to_string(m_ColumnsN) + ".";
+                    return;
+                }
+
+                part.rowsN++;
+                line = next;
+            }
+        }
+
+        void append(Part& part)
+        {
+            if (!part.error.empty())
+            {
+                throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                    << "[Read CSV] Line " << m_LinesN + part.linesN << ": " << part.error).str()
+                );
+            }
+
+            // Local label indexes are converted to the indexes of the dataset. Parts are
+            // appended in order so that the labels keep their order of first appearance.
+            std::vector<double> indexes;
+
+            for (const std::string& label : part.labels)
+            {
+                auto inserted = m_LabelIndexes.emplace(label, m_Dataset.labels.size());
+
+                if (inserted.second)
+                {
+                    m_Dataset.labels.push_back(label);
+                }
+
+                indexes.push_back(static_cast<double>(inserted.first->second));
+            }
+
+            for (double& target : part.targets)
+            {
+                target = m_Options.labels ? indexes[static_cast<size_t>(target)] : target;
+            }
+
+            m_Dataset.features.insert(m_Dataset.features.end(), part.features.cbegin(), part.features.cend());
+            m_Dataset.targets.insert(m_Dataset.targets.end(), part.targets.cbegin(), part.targets.cend());
+            m_Dataset.rowsN += part.rowsN;
+            m_LinesN += part.linesN;
+        }
+
+        //! Removes the spaces and carriage returns around [begin, end).
+        static void trim(const char*& begin, const char*& end)
+        {
+            while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '\r'))
+            {
+                begin++;
+            }
+
+            while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+            {
+                end--;
+            }
+        }
+    };
+};
+
+//! @brief CSV file read as a SampleStream, chunk by chunk, to train on files larger than
+//! the memory: only one chunk of CsvOptions::chunkSize bytes is parsed at a time. The
+//! rows are counted when the stream is opened.
+class CsvSampleStream : public SampleStream
+{
+public:
+    //! @throws std::ios_base::failure If the file cannot be opened.
+    //! @throws std::domain_error See CsvReader::read().
+    explicit CsvSampleStream(const std::string& filename, const CsvOptions& options = CsvOptions()) :
+        m_Filename(filename), m_Options(options)
+    {
+        m_Size = countRows();
+        rewind();
+
+        while (m_Reader->columnsCount() == 0 && !m_Ended)
+        {
+            m_Ended = !m_Chunks->next(m_File, *m_Reader);
+        }
+
+        m_InputSize = m_Reader->dataset().colsN;
+    }
+
+    size_t inputSize() const override
+    {
+        return m_InputSize;
+    }
+
+    size_t size() const override
+    {
+        return m_Size;
+    }
+
+    size_t read(size_t maxSamples, std::vector<double>& inputs, std::vector<double>& targets) override
+    {
+        inputs.clear();
+        targets.clear();
+        size_t readN = 0;
+
+        while (readN < maxSamples)
+        {
+            const CsvDataset& rows = m_Reader->dataset();
+
+            if (m_Row == rows.rowsN)
+            {
+                if (m_Ended)
+                {
+                    break;
+                }
+
+                m_Reader->clearRows();
+                m_Row = 0;
+                m_Ended = !m_Chunks->next(m_File, *m_Reader);
+                continue;
+            }
+
+            const size_t n = std::min(maxSamples - readN, rows.rowsN - m_Row);
+            inputs.insert(inputs.end(), rows.row(m_Row), rows.row(m_Row + n));
+            targets.insert(targets.end(), rows.targets.cbegin() + m_Row, rows.targets.cbegin() + m_Row + n);
+            m_Row += n;
+            readN += n;
+        }
+
+        return readN;
+    }
+
+    //! Reopens the file. Labels get the same indexes as they appear in the same order.
+    void rewind() override
+    {
+        m_File.close();
+        m_File.clear();
+        m_File.open(m_Filename, std::ios::in | std::ios::binary);
+
+        if (!m_File)
+        {
+            throw std::ios_base::failure(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Read CSV] Error opening file " << m_Filename << ".").str()
+            );
+        }
+
+        m_Chunks = std::make_unique<CsvReader::Chunks>(m_Options.chunkSize);
+        m_Reader = std::make_unique<CsvReader::Reader>(m_Options);
+        m_Row = 0;
+        m_Ended = false;
+    }
+
+private:
+    const std::string m_Filename;
+    const CsvOptions m_Options;
+    size_t m_Size = 0;
+    size_t m_InputSize = 0;
+    std::ifstream m_File;
+    std::unique_ptr<CsvReader::Chunks> m_Chunks;
+    std::unique_ptr<CsvReader::Reader> m_Reader;
+    size_t m_Row = 0; // Next row of the current chunk
+    bool m_Ended = false;
+
+    //! Counts the lines which are not empty, header excluded.
+    size_t countRows() const
+    {
+        std::ifstream file(m_Filename, std::ios::in | std::ios::binary);
+
+        if (!file)
+        {
+            throw std::ios_base::failure(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Read CSV] Error opening file " << m_Filename << ".").str()
+            );
+        }
+
+        std::vector<char> buffer(size_t(1) << 20);
+        size_t linesN = 0;
+        bool content = false;
+
+        while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0)
+        {
+            const size_t size = static_cast<size_t>(file.gcount());
+
+            for (size_t i = 0; i < size; i++)
+            {
+                const char c = buffer[i];
+                linesN += (c == '\n' && content) ? 1 : 0;
+                content = c == '\n' ? false : (content || (c != ' ' && c != '\t' && c != '\r'));
+            }
+        }
+
+        linesN += content ? 1 : 0;
+
+        return m_Options.header && linesN > 0 ? linesN - 1 : linesN;
+    }
+};
+
+}
+
+#endif // YANNL_CSV_READER_H
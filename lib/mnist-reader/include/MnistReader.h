@@ -5,6 +5,7 @@
 #ifndef YANNL_MNIST_READER_H
 #define YANNL_MNIST_READER_H
 
+#include "SampleStream.h"
 #include "Utils.h"
 #include <fstream>  // std::ifstream
 #include <sstream>  // std::ostringstream
@@ -199,6 +200,8 @@ public:
     }
 
 private:
+    friend class MnistSampleStream;
+
     static uint32_t swapEndian(uint32_t n)
     {
         uint8_t ch1 = n & 0xFF;
@@ -236,4 +239,103 @@ private:
     MnistReader() {};
 };
 
+//! @brief MNIST images and labels read as a SampleStream, block by block, instead of
+//! loading the whole files. Each image is normalized like MnistReader::normalize().
+class MnistSampleStream : public YANNL::SampleStream
+{
+public:
+    //! @throws std::ios_base::failure If a file cannot be opened, is not a file of images,
+    //!   respectively labels, or if the files do not have the same number of items.
+    explicit MnistSampleStream(const std::string& imagesFilename, const std::string& labelsFilename) :
+        m_Images(imagesFilename, std::ios::in | std::ios::binary),
+        m_Labels(labelsFilename, std::ios::in | std::ios::binary)
+    {
+        int32_t imagesMagic = 0, labelsMagic = 0, labelsCount = 0;
+        MnistReader::MnistFileAttrs attrs;
+
+        m_Images.read((char*)&imagesMagic, sizeof(imagesMagic));
+        m_Images.read((char*)&attrs.count, sizeof(attrs.count));
+        m_Images.read((char*)&attrs.rowsN, sizeof(attrs.rowsN));
+        m_Images.read((char*)&attrs.colsN, sizeof(attrs.colsN));
+        m_Labels.read((char*)&labelsMagic, sizeof(labelsMagic));
+        m_Labels.read((char*)&labelsCount, sizeof(labelsCount));
+
+        if (!m_Images || !m_Labels || MnistReader::swapEndian(imagesMagic) != 0x803
+            || MnistReader::swapEndian(labelsMagic) != 0x801
+            || MnistReader::swapEndian(attrs.count) != MnistReader::swapEndian(labelsCount))
+        {
+            throw std::ios_base::failure(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Read MNIST] " << imagesFilename << " and " << labelsFilename
+                << " are not matching files of images and labels.").str()
+            );
+        }
+
+        m_Count = static_cast<size_t>(MnistReader::swapEndian(attrs.count));
+        m_PixelsN = static_cast<size_t>(MnistReader::swapEndian(attrs.rowsN))
+            * static_cast<size_t>(MnistReader::swapEndian(attrs.colsN));
+    }
+
+    size_t inputSize() const override
+    {
+        return m_PixelsN;
+    }
+
+    size_t size() const override
+    {
+        return m_Count;
+    }
+
+    size_t read(size_t maxSamples, std::vector<double>& inputs, std::vector<double>& targets) override
+    {
+        const size_t n = std::min(maxSamples, m_Count - m_Next);
+        m_Pixels.resize(n * m_PixelsN);
+        m_LabelBytes.resize(n);
+        m_Images.read((char*)m_Pixels.data(), m_Pixels.size());
+        m_Labels.read((char*)m_LabelBytes.data(), m_LabelBytes.size());
+
+        if (!m_Images || !m_Labels)
+        {
+            throw std::ios_base::failure("[Read MNIST] Files are shorter than their headers tell.");
+        }
+
+        inputs.resize(n * m_PixelsN);
+        targets.resize(n);
+
+        for (size_t s = 0; s < n; s++)
+        {
+            const uint8_t* image = m_Pixels.data() + s * m_PixelsN;
+            const int min = *std::min_element(image, image + m_PixelsN);
+            const double diff = *std::max_element(image, image + m_PixelsN) - min;
+
+            for (size_t p = 0; p < m_PixelsN; p++)
+            {
+                inputs[s * m_PixelsN + p] = (image[p] - min) / diff;
+            }
+
+            targets[s] = m_LabelBytes[s];
+        }
+
+        m_Next += n;
+        return n;
+    }
+
+    void rewind() override
+    {
+        m_Images.clear();
+        m_Labels.clear();
+        m_Images.seekg(16, std::ios::beg);
+        m_Labels.seekg(8, std::ios::beg);
+        m_Next = 0;
+    }
+
+private:
+    std::ifstream m_Images;
+    std::ifstream m_Labels;
+    size_t m_Count = 0;
+    size_t m_PixelsN = 0;
+    size_t m_Next = 0;
+    std::vector<uint8_t> m_Pixels;
+    std::vector<uint8_t> m_LabelBytes;
+};
+
 #endif // YANNL_MNIST_READER_H
\ No newline at end of file
@@ -0,0 +1,291 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_AUTOTUNER_H
+#define YANNL_AUTOTUNER_H
+
+#include "NeuralNetwork.h"
+#include <chrono>   // std::chrono
+#include <fstream>  // std::ifstream & std::ofstream
+#include <map>      // std::map
+#include <thread>   // std::thread::hardware_concurrency
+
+namespace YANNL
+{
+
+//! Configuration found by an Autotuner for a topology on this host.
+struct TunedConfig
+{
+    //! Batch size of the training, e.g. for MLP::setBatchSize().
+    size_t batchSize = 1;
+    //! Threads updating the weights, for NeuralNetwork::setThreadCount().
+    size_t threadsN = 1;
+    //! Samples per call of InferencePlan::predictBatch(), e.g. the maximum batch size of
+    //! an InferenceServer.
+    size_t predictBatchSize = 1;
+    //! Throughputs measured with this configuration.
+    double samplesPerSecond = 0.0;
+    double predictionsPerSecond = 0.0;
+};
+
+//! @brief Finds the fastest batch sizes and thread count for a network on this host with
+//! short timed trials: training samples (forward and backward propagations, one update per
+//! batch) for each candidate batch size and thread count, then batch predictions for each
+//! candidate batch size. The configurations are cached in a small text file, one line per
+//! topology and number of hardware threads, so that the trials run once.
+//!
+//! Larger training batches always make fewer updates, so the smallest batch size, then
+//! thread count, reaching kTolerance of the best training throughput is chosen: it keeps
+//! as many updates per epoch as possible for about the same speed.
+class Autotuner
+{
+public:
+    //! Training throughput, relative to the best one, accepted for a smaller configuration.
+    static constexpr double kTolerance = 0.95;
+
+    //! @param cachePath File caching the configurations; empty to not cache them.
+    //! @param trialSeconds Duration of each trial.
+    explicit Autotuner(const std::string& cachePath, double trialSeconds = 0.05) :
+        m_CachePath(cachePath), m_TrialSeconds(trialSeconds)
+    {
+        for (size_t threadsN = 1; threadsN <= std::max(1u, std::thread::hardware_concurrency()); threadsN *= 2)
+        {
+            m_ThreadCounts.push_back(threadsN);
+        }
+    }
+
+    // No need to apply the rule of five as the class contains no raw pointers
+
+    //! Sets the candidates of the trials. By default, batch sizes from 1 to 256 and
+    //! thread counts from 1 to the number of hardware threads by powers of 2.
+    //! @throws std::domain_error If a list is empty or contains 0.
+    void setCandidates(const std::vector<size_t>& batchSizes, const std::vector<size_t>& threadCounts)
+    {
+        for (const std::vector<size_t>* candidates : { &batchSizes, &threadCounts })
+        {
+            if (candidates->empty() || std::find(candidates->begin(), candidates->end(), 0) != candidates->end())
+            {
+                throw std::domain_error("[Autotuner] Candidates must be non-empty and non-zero.");
+            }
+        }
+
+        m_BatchSizes = batchSizes;
+        m_ThreadCounts = threadCounts;
+    }
+
+    //! @returns Configuration cached for the topology of @p net, or found by trials and
+    //!   then cached. The network is trained by the trials and then restored to its state.
+    //! @throws std::domain_error If the neural network has no output layers.
+    TunedConfig tune(NeuralNetwork& net)
+    {
+        const std::string key = topologyKey(net);
+        std::map<std::string, TunedConfig> cache = readCache();
+        const auto cached = cache.find(key);
+
+        if (cached != cache.end())
+        {
+            return cached->second;
+        }
+
+        TunedConfig config = runTrials(net);
+        cache[key] = config;
+        writeCache(cache);
+
+        return config;
+    }
+
+    //! Tunes @p net then sets its thread count.
+    TunedConfig apply(NeuralNetwork& net)
+    {
+        const TunedConfig config = tune(net);
+        net.setThreadCount(config.threadsN);
+
+        return config;
+    }
+
+    //! @returns Key of @p net in the cache: input size, type and size of each layer and
+    //!   number of hardware threads, e.g. 784-H128-D128-C10@8. Convolutional layers are
+    //!   K, max and average pooling layers M and A, followed by their parameters count.
+    static std::string topologyKey(const NeuralNetwork& net)
+    {
+        static const char types[7] = { 'H', 'D', 'C', 'R', 'K', 'M', 'A' };
+        const NetworkFootprint footprint = net.footprint();
+        std::ostringstream os;
+        os << footprint.inputSize;
+
+        for (const LayerFootprint& layer : footprint.layers)
+        {
+            os << "-" << types[static_cast<size_t>(layer.type)] << layer.size;
+
+            if (isImageLayer(layer.type))
+            {
+                os << "/" << layer.parametersN;
+            }
+        }
+
+        os << "@" << std::thread::hardware_concurrency();
+
+        return os.str();
+    }
+
+private:
+    const std::string m_CachePath;
+    const double m_TrialSeconds;
+    std::vector<size_t> m_BatchSizes{ 1, 4, 16, 64, 256 };
+    std::vector<size_t> m_ThreadCounts;
+
+    TunedConfig runTrials(NeuralNetwork& net) const
+    {
+        if (!net.isLastLayerAnOutput())
+        {
+            throw std::domain_error("[Autotuner] Neural network has no output layers.");
+        }
+
+        // Nothing is reported while the trials train the network
+        TrainingState state;
+        net.copyTrainingState(state);
+        const size_t threadsN = net.threadCount();
+        const std::shared_ptr<TrainingObserver> observer = net.observer();
+        const std::shared_ptr<LayerProfiler> profiler = net.layerProfiler();
+        net.setObserver(nullptr);
+        net.setLayerProfiler(nullptr);
+
+        const std::vector<double> inputs(net.inputSize(), 0.5);
+        std::vector<double> expected(net.footprint().layers.back().size, 0.0);
+        expected[0] = 1.0;
+        TunedConfig config;
+        std::vector<TunedConfig> trials;
+
+        for (size_t batchSize : m_BatchSizes)
+        {
+            for (size_t trialThreadsN : m_ThreadCounts)
+            {
+                net.setThreadCount(trialThreadsN);
+                TunedConfig trial;
+                trial.batchSize = batchSize;
+                trial.threadsN = trialThreadsN;
+                trial.samplesPerSecond = throughput(batchSize,
+                    [&]()
+                    {
+                        for (size_t n = 0; n < batchSize; n++)
+                        {
+                            net.propagateForward(inputs);
+                            net.propagateBackward(expected);
+                        }
+
+                        net.updateWeights();
+                    });
+                trials.push_back(trial);
+                config.samplesPerSecond = std::max(config.samplesPerSecond, trial.samplesPerSecond);
+            }
+        }
+
+        const double best = config.samplesPerSecond;
+
+        for (const TunedConfig& trial : trials)
+        {
+            if (trial.samplesPerSecond >= kTolerance * best)
+            {
+                config = trial;
+                break;
+            }
+        }
+
+        const InferencePlan plan = net.compile();
+
+        for (size_t batchSize : m_BatchSizes)
+        {
+            const std::vector<std::vector<double>> batch(batchSize, inputs);
+            const double predictionsPerSecond = throughput(batchSize,
+                [&]()
+                {
+                    plan.predictBatch(batch);
+                });
+
+            if (predictionsPerSecond > config.predictionsPerSecond)
+            {
+                config.predictBatchSize = batchSize;
+                config.predictionsPerSecond = predictionsPerSecond;
+            }
+        }
+
+        net.restoreTrainingState(state);
+        net.setThreadCount(threadsN);
+        net.setObserver(observer);
+        net.setLayerProfiler(profiler);
+
+        return config;
+    }
+
+    //! Calls @p func, processing @p samplesN samples, for at least the trial duration.
+    //! @returns Samples per second.
+    template<typename Func>
+    double throughput(size_t samplesN, Func func) const
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        size_t callsN = 0;
+        double seconds = 0.0;
+
+        do
+        {
+            func();
+            ++callsN;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        } while (seconds < m_TrialSeconds);
+
+        return callsN * samplesN / seconds;
+    }
+
+    //! @returns Configurations of the cache file; none if there is no file or cache.
+    std::map<std::string, TunedConfig> readCache() const
+    {
+        std::map<std::string, TunedConfig> cache;
+        std::ifstream file(m_CachePath);
+        std::string line;
+
+        while (std::getline(file, line))
+        {
+            std::istringstream is(line);
+            std::string key;
+            TunedConfig config;
+
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            else if (is >> key >> config.batchSize >> config.threadsN >> config.predictBatchSize
+                >> config.samplesPerSecond >> config.predictionsPerSecond)
+            {
+                cache[key] = config;
+            }
+        }
+
+        return cache;
+    }
+
+    //! Rewrites the whole cache file; nothing if it cannot be written as the trials can
+    //! be run again.
+    void writeCache(const std::map<std::string, TunedConfig>& cache) const
+    {
+        if (m_CachePath.empty())
+        {
+            return;
+        }
+
+        std::ofstream file(m_CachePath);
+        file << "# topology batchSize threadsN predictBatchSize samplesPerSecond predictionsPerSecond\n";
+
+        for (const std::pair<const std::string, TunedConfig>& entry : cache)
+        {
+            const TunedConfig& config = entry.second;
+            file << entry.first << " " << config.batchSize << " " << config.threadsN << " "
+                << config.predictBatchSize << " " << config.samplesPerSecond << " "
+                << config.predictionsPerSecond << "\n";
+        }
+    }
+};
+
+}
+
+#endif // YANNL_AUTOTUNER_H
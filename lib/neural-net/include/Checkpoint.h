@@ -0,0 +1,470 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_CHECKPOINT_H
+#define YANNL_CHECKPOINT_H
+
+#include "NeuralNetwork.h"
+#include <algorithm>            // std::remove & std::find
+#include <condition_variable>   // std::condition_variable
+#include <cstdint>              // uint64_t
+#include <cstdio>               // std::rename & std::remove
+#include <cstring>              // std::memcpy
+#include <deque>                // std::deque
+#include <exception>            // std::exception_ptr
+#include <fstream>              // std::ofstream & std::ifstream
+#include <iomanip>              // std::setw
+#include <iterator>             // std::istreambuf_iterator
+#include <mutex>                // std::mutex
+#include <thread>               // std::thread
+
+namespace YANNL
+{
+
+//! @brief Writes binary checkpoints of the training state of a network without stalling
+//! the training. save() only copies the state into one of two buffers; a background
+//! thread writes the other one. Each checkpoint is written to a temporary file renamed
+//! once complete, so a crash never leaves a truncated checkpoint. Only the last
+//! checkpoints are kept; their names are listed, oldest first, in the index file
+//! `<prefix>.latest`, itself replaced atomically.
+//!
+//! Format, in the byte order of the machine: "YANNLCKP", version (uint64), epoch, step,
+//! learning rate, then the topology, parameters, optimizer state, generators and, since
+//! version 2, scheduler state, each preceded by its count, and a FNV-1a hash of all the
+//! previous bytes.
+class CheckpointWriter
+{
+public:
+    //! Starts the writing thread. Checkpoints listed by an existing index are kept
+    //! as if this writer had written them.
+    //! @param prefix Path and prefix of the files, e.g. "../output/mnist" for
+    //!   "../output/mnist-000012.ckpt" at epoch 12 and the index "../output/mnist.latest".
+    //! @param keepLast Number of checkpoints kept. 3 by default.
+    //! @throws std::domain_error If @p keepLast is 0.
+    explicit CheckpointWriter(const std::string& prefix, size_t keepLast = 3) :
+        m_Prefix(prefix), m_KeepLast(keepLast), m_Kept(readIndex(prefix))
+    {
+        if (m_KeepLast == 0)
+        {
+            throw std::domain_error("[Checkpoint writer] At least one checkpoint must be kept.");
+        }
+
+        m_Thread = std::thread(&CheckpointWriter::run, this);
+    }
+
+    //! Writes the pending checkpoint and stops the writing thread. Errors are lost:
+    //! call wait() first to get them.
+    ~CheckpointWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+
+        m_Cv.notify_all();
+        m_Thread.join();
+    }
+
+    // Owns a thread: neither copyable nor movable
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    //! Takes a snapshot of the training state of @p net and returns while it is written.
+    //! Only waits if the previous snapshot is still queued behind the one being written.
+    //! @param epoch Epoch stored in the checkpoint and in its name.
+    //! @param step Number of weight updates stored in the checkpoint.
+    //! @param schedulerState State of the learning rate scheduler of the training loop,
+    //!   if any, see LearningRateScheduler::copyState().
+    //! @throws std::ios_base::failure If writing a previous checkpoint failed.
+    void save(const NeuralNetwork& net, size_t epoch, size_t step,
+        const std::vector<double>& schedulerState = std::vector<double>())
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Cv.wait(lock, [this]() { return !m_Queued; });
+        rethrowError();
+
+        // The writing thread only reads the other buffer
+        TrainingState& state = m_States[m_Filled];
+        lock.unlock();
+
+        net.copyTrainingState(state);
+        state.epoch = epoch;
+        state.step = step;
+        state.schedulerState = schedulerState;
+
+        lock.lock();
+        m_Queued = true;
+        lock.unlock();
+        m_Cv.notify_all();
+    }
+
+    //! Waits until all the snapshots taken are written.
+    //! @throws std::ios_base::failure If writing a checkpoint failed.
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Cv.wait(lock, [this]() { return !m_Queued && !m_Writing; });
+        rethrowError();
+    }
+
+    //! @returns Paths of the checkpoints kept, oldest first.
+    std::vector<std::string> checkpoints() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        return std::vector<std::string>(m_Kept.cbegin(), m_Kept.cend());
+    }
+
+    //! @returns Path of the checkpoint of @p epoch.
+    std::string path(size_t epoch) const
+    {
+        std::ostringstream os;
+        os << m_Prefix << "-" << std::setw(6) << std::setfill('0') << epoch << ".ckpt";
+
+        return os.str();
+    }
+
+    //! Reads a checkpoint written by a CheckpointWriter.
+    //! @throws std::domain_error If the file cannot be read or is not a valid checkpoint.
+    static TrainingState read(const std::string& filepath)
+    {
+        std::ifstream file(filepath, std::ios::binary);
+        std::string bytes;
+
+        if (file)
+        {
+            bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        if (bytes.size() < kMagicSize + sizeof(uint64_t) || bytes.compare(0, kMagicSize, magic()) != 0
+            || hash(bytes.data(), bytes.size() - sizeof(uint64_t)) != value<uint64_t>(bytes, bytes.size() - sizeof(uint64_t)))
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Read checkpoint] " << filepath << " is not accessible or not a valid checkpoint.").str()
+            );
+        }
+
+        size_t offset = kMagicSize;
+
+        const uint64_t version = next<uint64_t>(bytes, offset);
+
+        if (version == 0 || version > kVersion)
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Read checkpoint] Version of " << filepath << " is not supported.").str()
+            );
+        }
+
+        TrainingState state;
+        state.epoch = static_cast<size_t>(next<uint64_t>(bytes, offset));
+        state.step = static_cast<size_t>(next<uint64_t>(bytes, offset));
+        state.learningRate = next<double>(bytes, offset);
+        state.topology.resize(static_cast<size_t>(next<uint64_t>(bytes, offset)));
+        checkRemaining(bytes, offset, state.topology.size() * sizeof(uint64_t));
+
+        for (size_t& value : state.topology)
+        {
+            value = static_cast<size_t>(next<uint64_t>(bytes, offset));
+        }
+
+        readValues(bytes, offset, state.parameters);
+        readValues(bytes, offset, state.optimizerState);
+        state.generators.resize(static_cast<size_t>(next<uint64_t>(bytes, offset)));
+
+        for (std::string& generator : state.generators)
+        {
+            const size_t length = static_cast<size_t>(next<uint64_t>(bytes, offset));
+            checkRemaining(bytes, offset, length);
+            generator.assign(bytes, offset, length);
+            offset += length;
+        }
+
+        if (version >= 2)
+        {
+            readValues(bytes, offset, state.schedulerState);
+        }
+
+        return state;
+    }
+
+    //! Restores in @p net the training state of the most recent checkpoint listed by
+    //! the index of @p prefix, e.g. when the training restarts after a crash.
+    //! @returns Epoch and step of the checkpoint, in @p state; false if there is none.
+    //! @throws std::domain_error If the checkpoint is not valid or is not of the
+    //!   topology of @p net.
+    static bool restoreLatest(const std::string& prefix, NeuralNetwork& net, TrainingState& state)
+    {
+        const std::deque<std::string> kept = readIndex(prefix);
+
+        if (kept.empty())
+        {
+            return false;
+        }
+
+        state = read(kept.back());
+        net.restoreTrainingState(state);
+
+        return true;
+    }
+
+private:
+    static constexpr size_t kMagicSize = 8;
+    static constexpr uint64_t kVersion = 2;
+
+    const std::string m_Prefix;
+    const size_t m_KeepLast;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Cv;
+    //! Snapshots: m_States[m_Filled] is filled by save() while the other one is written.
+    TrainingState m_States[2];
+    size_t m_Filled = 0;
+    bool m_Queued = false;
+    bool m_Writing = false;
+    bool m_Stop = false;
+    std::exception_ptr m_Error;
+    std::deque<std::string> m_Kept;
+    std::thread m_Thread;
+
+    void run()
+    {
+        std::string bytes;
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        while (true)
+        {
+            m_Cv.wait(lock, [this]() { return m_Stop || m_Queued; });
+
+            if (!m_Queued)
+            {
+                return;
+            }
+
+            const TrainingState& state = m_States[m_Filled];
+            m_Filled = 1 - m_Filled;
+            m_Queued = false;
+            m_Writing = true;
+            lock.unlock();
+            m_Cv.notify_all();
+
+            std::exception_ptr error;
+
+            try
+            {
+                write(state, bytes);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            m_Writing = false;
+
+            if (error)
+            {
+                m_Error = error;
+            }
+
+            m_Cv.notify_all();
+        }
+    }
+
+    //! Writes the checkpoint of @p state, then the index and deletes the oldest
+    //! checkpoints beyond the ones kept.
+    void write(const TrainingState& state, std::string& bytes)
+    {
+        bytes.assign(magic(), kMagicSize);
+        append<uint64_t>(bytes, kVersion);
+        append<uint64_t>(bytes, state.epoch);
+        append<uint64_t>(bytes, state.step);
+        append<double>(bytes, state.learningRate);
+        append<uint64_t>(bytes, state.topology.size());
+
+        for (size_t value : state.topology)
+        {
+            append<uint64_t>(bytes, value);
+        }
+
+        appendValues(bytes, state.parameters);
+        appendValues(bytes, state.optimizerState);
+        append<uint64_t>(bytes, state.generators.size());
+
+        for (const std::string& generator : state.generators)
+        {
+            append<uint64_t>(bytes, generator.size());
+            bytes += generator;
+        }
+
+        appendValues(bytes, state.schedulerState);
+
+        append<uint64_t>(bytes, hash(bytes.data(), bytes.size()));
+
+        const std::string filepath = path(state.epoch);
+        writeAtomically(filepath, bytes);
+
+        std::deque<std::string> removed;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            // An epoch written again, e.g. by a new training, becomes the latest checkpoint
+            m_Kept.erase(std::remove(m_Kept.begin(), m_Kept.end(), filepath), m_Kept.end());
+            m_Kept.push_back(filepath);
+
+            while (m_Kept.size() > m_KeepLast)
+            {
+                const std::string oldest = m_Kept.front();
+                m_Kept.pop_front();
+
+                // Never remove a checkpoint that is still listed
+                if (std::find(m_Kept.cbegin(), m_Kept.cend(), oldest) == m_Kept.cend())
+                {
+                    removed.push_back(oldest);
+                }
+            }
+
+            std::string index;
+
+            for (const std::string& kept : m_Kept)
+            {
+                index += kept + "\n";
+            }
+
+            writeAtomically(m_Prefix + ".latest", index);
+        }
+
+        // Removed only once the index does not list them anymore
+        for (const std::string& file : removed)
+        {
+            std::remove(file.c_str());
+        }
+    }
+
+    static const char* magic()
+    {
+        return "YANNLCKP";
+    }
+
+    void rethrowError()
+    {
+        if (m_Error)
+        {
+            std::exception_ptr error = m_Error;
+            m_Error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    //! Writes @p bytes to a temporary file, then renames it to @p filepath.
+    static void writeAtomically(const std::string& filepath, const std::string& bytes)
+    {
+        const std::string tmp = filepath + ".tmp";
+
+        {
+            std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+            file.write(bytes.data(), bytes.size());
+            file.close();
+
+            if (!file)
+            {
+                std::remove(tmp.c_str());
+                throw std::ios_base::failure("[Checkpoint writer] Cannot write " + tmp + ".");
+            }
+        }
+
+        // Replaces an existing file on POSIX. Elsewhere it must be removed first.
+        if (std::rename(tmp.c_str(), filepath.c_str()) != 0
+            && (std::remove(filepath.c_str()) != 0 || std::rename(tmp.c_str(), filepath.c_str()) != 0))
+        {
+            std::remove(tmp.c_str());
+            throw std::ios_base::failure("[Checkpoint writer] Cannot rename " + tmp + ".");
+        }
+    }
+
+    //! @returns Checkpoints listed by the index of @p prefix, oldest first; none if
+    //!   there is no index.
+    static std::deque<std::string> readIndex(const std::string& prefix)
+    {
+        std::ifstream file(prefix + ".latest");
+        std::deque<std::string> kept;
+        std::string line;
+
+        while (std::getline(file, line))
+        {
+            if (!line.empty())
+            {
+                kept.push_back(line);
+            }
+        }
+
+        return kept;
+    }
+
+    template<typename T>
+    static void append(std::string& bytes, T value)
+    {
+        bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static void appendValues(std::string& bytes, const std::vector<double>& values)
+    {
+        append<uint64_t>(bytes, values.size());
+        bytes.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double));
+    }
+
+    template<typename T>
+    static T value(const std::string& bytes, size_t offset)
+    {
+        T value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+
+        return value;
+    }
+
+    template<typename T>
+    static T next(const std::string& bytes, size_t& offset)
+    {
+        checkRemaining(bytes, offset, sizeof(T));
+        offset += sizeof(T);
+
+        return value<T>(bytes, offset - sizeof(T));
+    }
+
+    static void readValues(const std::string& bytes, size_t& offset, std::vector<double>& values)
+    {
+        const size_t valuesN = static_cast<size_t>(next<uint64_t>(bytes, offset));
+        checkRemaining(bytes, offset, valuesN * sizeof(double));
+        values.resize(valuesN);
+        std::memcpy(values.data(), bytes.data() + offset, valuesN * sizeof(double));
+        offset += valuesN * sizeof(double);
+    }
+
+    //! @throws std::domain_error If less than @p size bytes remain before the hash.
+    static void checkRemaining(const std::string& bytes, size_t offset, size_t size)
+    {
+        if (size > bytes.size() - sizeof(uint64_t) - offset)
+        {
+            throw std::domain_error("[Read checkpoint] Checkpoint is truncated.");
+        }
+    }
+
+    //! FNV-1a hash of @p size bytes.
+    static uint64_t hash(const char* bytes, size_t size)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+
+        for (size_t n = 0; n < size; n++)
+        {
+            hash ^= static_cast<unsigned char>(bytes[n]);
+            hash *= 1099511628211ULL;
+        }
+
+        return hash;
+    }
+};
+
+}
+
+#endif // YANNL_CHECKPOINT_H
@@ -0,0 +1,118 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_DROPOUT_MASK_H
+#define YANNL_DROPOUT_MASK_H
+
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <vector>   // std::vector
+
+namespace YANNL
+{
+
+//! @brief Units kept by a dropout layer, packed 64 per word. A 4096-wide layer
+//! fits in 512 bytes and the mask is applied with branchless loops over each word.
+class DropoutMask
+{
+public:
+    explicit DropoutMask(size_t size = 0) :
+        m_Size(size), m_Words(wordsCount(size))
+    {
+
+    }
+
+    // No need to apply the rule of five as the class contains no raw pointers
+
+    size_t size() const
+    {
+        return m_Size;
+    }
+
+    bool kept(size_t n) const
+    {
+        return (m_Words[n / kBits] >> (n % kBits)) & 1;
+    }
+
+    void set(size_t n, bool keep)
+    {
+        const uint64_t bit = uint64_t(1) << (n % kBits);
+        m_Words[n / kBits] = keep ? (m_Words[n / kBits] | bit) : (m_Words[n / kBits] & ~bit);
+    }
+
+    //! Keeps all the units.
+    void keepAll()
+    {
+        for (size_t w = 0; w < m_Words.size(); w++)
+        {
+            const size_t bits = bitsInWord(w);
+            m_Words[w] = bits == kBits ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+        }
+    }
+
+    //! Keeps unit n if uniforms[n] >= @p rate, 64 units at a time.
+    void draw(const double* uniforms, double rate)
+    {
+        for (size_t w = 0; w < m_Words.size(); w++)
+        {
+            const size_t begin = w * kBits;
+            const size_t bits = bitsInWord(w);
+            uint64_t word = 0;
+
+            for (size_t b = 0; b < bits; b++)
+            {
+                word |= static_cast<uint64_t>(uniforms[begin + b] >= rate) << b;
+            }
+
+            m_Words[w] = word;
+        }
+    }
+
+    //! Writes inputs[n] / (1 - rate) for the kept units and 0 for the dropped ones.
+    //! @p inputs and @p outputs can be the same buffer to apply the mask in place.
+    void apply(const double* inputs, double* outputs, double rate) const
+    {
+        const double keepRate = 1 - rate;
+
+        for (size_t w = 0; w < m_Words.size(); w++)
+        {
+            const size_t begin = w * kBits;
+            const size_t bits = bitsInWord(w);
+            const uint64_t word = m_Words[w];
+
+            for (size_t b = 0; b < bits; b++)
+            {
+                outputs[begin + b] = ((word >> b) & 1) ? inputs[begin + b] / keepRate : 0.0;
+            }
+        }
+    }
+
+    //! @returns Memory used by the bits of the mask.
+    size_t bytes() const
+    {
+        return m_Words.size() * sizeof(uint64_t);
+    }
+
+private:
+    static constexpr size_t kBits = 64;
+
+    size_t m_Size = 0;
+    std::vector<uint64_t> m_Words;
+
+    static size_t wordsCount(size_t size)
+    {
+        return (size + kBits - 1) / kBits;
+    }
+
+    //! @returns Number of units in word @p w; fewer than 64 in the last word.
+    size_t bitsInWord(size_t w) const
+    {
+        const size_t remaining = m_Size - w * kBits;
+        return remaining < kBits ? remaining : kBits;
+    }
+};
+
+}
+
+#endif // YANNL_DROPOUT_MASK_H
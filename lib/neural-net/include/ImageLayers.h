@@ -0,0 +1,1301 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_IMAGE_LAYERS_H
+#define YANNL_IMAGE_LAYERS_H
+
+#include "NeuronLayer.h"
+
+namespace YANNL
+{
+
+//! Shape of the values of an image layer: channels of height x width values, stored
+//! channel by channel then row by row. The outputs of a dense layer of N neurons are
+//! N channels of 1 x 1.
+struct ImageShape
+{
+    size_t channels = 0;
+    size_t height = 0;
+    size_t width = 0;
+
+    ImageShape() = default;
+
+    ImageShape(size_t channelsN, size_t heightN, size_t widthN) :
+        channels(channelsN), height(heightN), width(widthN)
+    {
+
+    }
+
+    size_t size() const
+    {
+        return channels * height * width;
+    }
+
+    bool operator==(const ImageShape& shape) const
+    {
+        return channels == shape.channels && height == shape.height && width == shape.width;
+    }
+
+    bool operator!=(const ImageShape& shape) const
+    {
+        return !(*this == shape);
+    }
+
+    //! Writes the shape as channels x height x width.
+    friend std::ostream& operator<<(std::ostream& os, const ImageShape& shape)
+    {
+        os << shape.channels << "x" << shape.height << "x" << shape.width;
+        return os;
+    }
+};
+
+//! @returns Whether layers of @p type are image layers, see ImageLayer.
+inline bool isImageLayer(LayerType type)
+{
+    return type == LayerType::Conv2D || type == LayerType::MaxPool || type == LayerType::AvgPool;
+}
+
+//! Algorithm of the convolution of a Conv2DLayer. Both give exactly the same values.
+enum class ConvAlgorithm
+{
+    //! Direct for small kernels, im2col otherwise.
+    Auto = 0,
+    //! Loops over the kernel then over the outputs, without any buffer.
+    Direct,
+    //! Copies the windows of the inputs into columns, then multiplies the filters by
+    //! the columns like the weights of a dense layer by its inputs.
+    Im2col
+};
+
+//! @brief Layer of a network on images, see Conv2DLayer and PoolLayer. Its inputs and
+//! outputs are channels of an ImageShape so that image layers can be stacked, and
+//! followed by dense layers which read the outputs as a vector.
+//! The deltas of the inputs are only calculated when the previous layer asks for them
+//! with sumDelta(), once per backward propagation: the first layer of a network never
+//! calculates them.
+class ImageLayer : public NeuronLayer // public inheritance to be able to use std::make_shared
+{
+public:
+    // No need to apply the rule of five as the class contains no raw pointers
+
+    const ImageShape& inputShape() const
+    {
+        return m_InputShape;
+    }
+
+    const ImageShape& outputShape() const
+    {
+        return m_OutputShape;
+    }
+
+    //! @returns Size of the square kernel, or of the pool.
+    size_t kernelSize() const
+    {
+        return m_KernelSize;
+    }
+
+    size_t stride() const
+    {
+        return m_Stride;
+    }
+
+    size_t size() const override
+    {
+        return m_OutputShape.size();
+    }
+
+    //! @returns Number of values of the scratch buffer of calcOutputs().
+    virtual size_t scratchSize() const
+    {
+        return 0;
+    }
+
+    //! Calculates the outputs of @p inputs without modifying the layer, for an
+    //! InferencePlan. The outputs are exactly those of propagateForward().
+    //! @param scratch scratchSize() values owned by the caller, so that threads
+    //!   sharing the layer each use their own.
+    virtual void calcOutputs(const double* inputs, double* outputs, double* scratch) const = 0;
+
+    //! @returns Copy of the layer, e.g. for an InferencePlan.
+    virtual std::shared_ptr<const ImageLayer> clone() const = 0;
+
+    std::vector<double> propagateForward(const std::vector<double>& inputs, bool ignoreDropout) override
+    {
+        if (m_KeepInputs)
+        {
+            m_Inputs = inputs;
+        }
+
+        m_Outputs.resize(m_OutputShape.size());
+        calcTrainingOutputs(inputs.data(), m_Outputs.data());
+
+        return m_Outputs;
+    }
+
+    size_t probableClass() const override
+    {
+        throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+            << "[Probable class] Output layer cannot be a convolutional or pooling one.").str()
+        );
+
+        return 0;
+    }
+
+    double calcError(const std::vector<double>& expectedOutputs) const override
+    {
+        throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+            << "[Calculate error] Output layer cannot be a convolutional or pooling one.").str()
+        );
+
+        return 0.0;
+    }
+
+    void propagateBackwardOuputLayer(const std::vector<double>& expectedOutputs) override
+    {
+        throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+            << "[Propagate backward] Output layer cannot be a convolutional or pooling one.").str()
+        );
+    }
+
+    void propagateBackwardHiddenLayer(const NeuronLayer& nextLayer) override
+    {
+        // Dropout of the next layer is fused in the loop like in DenseLayer
+        const DropoutMask* mask = nextLayer.dropoutMask();
+        const double rate = nextLayer.dropoutRate();
+        m_Deltas.resize(m_OutputShape.size());
+
+        for (size_t n = 0; n < m_Deltas.size(); n++)
+        {
+            // dE/do = Sum(deltaOutputNeurons * w), through the dropout if any
+            double sum = nextLayer.sumDelta(n);
+
+            if (mask != nullptr)
+            {
+                sum = mask->kept(n) ? sum / (1.0 - rate) : 0.0;
+            }
+
+            // dE/dn = dE/do * f'(o)
+            m_Deltas[n] = m_Func ? sum * m_Func->calcDerivate(m_Outputs[n]) : sum;
+        }
+
+        m_InputDeltasValid = false;
+        calcGradients();
+    }
+
+    //! @returns dE/di of input @p weightN, calculated for all the inputs on the first call
+    //!   after propagating backward.
+    double sumDelta(size_t weightN) const override
+    {
+        if (!m_InputDeltasValid)
+        {
+            m_InputDeltas.assign(m_InputShape.size(), 0.0);
+            calcInputDeltas(m_InputDeltas.data());
+            m_InputDeltasValid = true;
+        }
+
+        return m_InputDeltas[weightN];
+    }
+
+    bool droppedNeuron(size_t neuronN) const override
+    {
+        return false;
+    }
+
+    bool dropoutLayer() const override
+    {
+        return false;
+    }
+
+    double dropoutRate() const override
+    {
+        return 0.0;
+    }
+
+    const DropoutMask* dropoutMask() const override
+    {
+        return nullptr;
+    }
+
+    std::string generatorState() const override
+    {
+        return std::string();
+    }
+
+    void restoreGeneratorState(const std::string& state) override
+    {
+
+    }
+
+    void keepInputs(bool keep) override
+    {
+        m_KeepInputs = keep;
+        releaseInputs();
+    }
+
+    const std::vector<double>& storedInputs() const override
+    {
+        return m_Inputs;
+    }
+
+    void releaseInputs() override
+    {
+        if (!m_KeepInputs)
+        {
+            m_Inputs.clear();
+            m_Inputs.shrink_to_fit();
+        }
+    }
+
+    std::vector<double> replayForward(const std::vector<double>& inputs) override
+    {
+        const bool keep = m_KeepInputs;
+        m_KeepInputs = true;
+        std::vector<double> outputs = propagateForward(inputs, false);
+        m_KeepInputs = keep;
+
+        return outputs;
+    }
+
+protected:
+    const ImageShape m_InputShape;
+    const ImageShape m_OutputShape;
+    const size_t m_KernelSize = 0;
+    const size_t m_Stride = 0;
+    //! nullptr for the identity.
+    const std::shared_ptr<ActivationFunction> m_Func;
+
+    std::vector<double> m_Inputs;
+    bool m_KeepInputs = true;
+    std::vector<double> m_Outputs;
+    //! dE/dn of each output.
+    std::vector<double> m_Deltas;
+    mutable std::vector<double> m_InputDeltas;
+    mutable bool m_InputDeltasValid = false;
+
+    //! @throws std::domain_error If the shapes are empty or the kernel or the stride is 0.
+    explicit ImageLayer(const ImageShape& inputShape, const ImageShape& outputShape, size_t kernelSize,
+        size_t stride, ActivationFunctions afunc) :
+        m_InputShape(inputShape), m_OutputShape(outputShape), m_KernelSize(kernelSize), m_Stride(stride),
+        m_Func(afunc == ActivationFunctions::Identity ? nullptr : ActivationFunctionFactory::build(afunc))
+    {
+        if (inputShape.size() == 0 || outputShape.size() == 0 || kernelSize == 0 || stride == 0)
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Image layer] Kernel of " << kernelSize << " and stride of " << stride
+                << " do not fit inputs of " << inputShape << ".").str()
+            );
+        }
+    }
+
+    //! @returns Number of outputs along a dimension of @p inputsN values, padded with
+    //!   @p padding zeros on each side; 0 if the kernel does not fit.
+    static size_t outputsCount(size_t inputsN, size_t kernelSize, size_t stride, size_t padding)
+    {
+        return inputsN + 2 * padding < kernelSize || stride == 0 ? 0
+            : (inputsN + 2 * padding - kernelSize) / stride + 1;
+    }
+
+    //! Calculates the outputs while training, storing what is needed to propagate backward.
+    virtual void calcTrainingOutputs(const double* inputs, double* outputs)
+    {
+        calcOutputs(inputs, outputs, nullptr);
+    }
+
+    //! Accumulates the gradients of the parameters from m_Deltas and m_Inputs.
+    virtual void calcGradients() = 0;
+
+    //! Adds dE/di of each input to @p inputDeltas, from m_Deltas.
+    virtual void calcInputDeltas(double* inputDeltas) const = 0;
+
+    void inspectShapes(std::ostream& os) const
+    {
+        os << " " << m_KernelSize << "x" << m_KernelSize << " stride " << m_Stride
+            << ": " << m_InputShape << " -> " << m_OutputShape;
+    }
+
+    void saveShapes(std::ofstream& output) const
+    {
+        output << "InputShape: " << m_InputShape.channels << " " << m_InputShape.height << " "
+            << m_InputShape.width << "\n"
+            << "Kernel: " << m_KernelSize << "\n"
+            << "Stride: " << m_Stride << "\n";
+    }
+
+    static void readShapes(std::ifstream& file, ImageShape& inputShape, size_t& kernelSize, size_t& stride)
+    {
+        std::string tag;
+
+        Utils::checkTag(file, tag, "InputShape:");
+        file >> inputShape.channels >> inputShape.height >> inputShape.width;
+        file >> tag >> kernelSize;
+        file >> tag >> stride;
+    }
+};
+
+//! @brief Convolutional layer: filters of channels x kernel x kernel weights and a bias
+//! slide over the input channels, with a stride and zero padding, and each filter gives
+//! an output channel. The weights are shared by all the positions so the layer has far
+//! fewer parameters than a dense layer of the same outputs.
+//!
+//! The convolution is either direct or im2col, see ConvAlgorithm: im2col copies the
+//! windows of the inputs into a matrix of channels x kernel x kernel rows and one column
+//! per output position, then multiplies it by the matrix of the filters. Both accumulate
+//! each output in the order of the weights of the filter, then add the bias, like
+//! Neuron::propagateForward(), so that they give the same values.
+class Conv2DLayer : public ImageLayer // public inheritance to be able to use std::make_shared
+{
+public:
+    //! Up to this number of weights per filter, e.g. a 5 x 5 kernel on a single channel,
+    //! the direct convolution is as fast as copying the inputs into columns, see
+    //! ConvAlgorithm::Auto.
+    static constexpr size_t kDirectMaxWeights = 25;
+
+    //! Creates a layer with random weights.
+    //! @param inputShape Shape of the inputs, e.g. 1 x 28 x 28 for grayscale images.
+    //! @param filtersN Number of filters, i.e. of output channels.
+    //! @param kernelSize Height and width of the filters.
+    //! @param stride Distance between two positions of the filters.
+    //! @param padding Zeros added around each input channel.
+    //! @throws std::domain_error If the kernel does not fit the padded inputs or if
+    //!   @p filtersN, @p kernelSize or @p stride is 0.
+    explicit Conv2DLayer(const ImageShape& inputShape, size_t filtersN, size_t kernelSize, size_t stride,
+        size_t padding, ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer,
+        const std::shared_ptr<SeedGenerator>& seedGen) :
+        Conv2DLayer(inputShape, filtersN, kernelSize, stride, padding, afunc, optimizer)
+    {
+        const size_t weightsN = filterWeightsCount();
+
+        if (seedGen->engine() == RandomEngine::Philox)
+        {
+            // Weight w of filter f is value w of stream f, like DenseLayer::addPhiloxNeurons()
+            const Philox4x32 philox(seedGen->key());
+
+            for (size_t f = 0; f < filtersN; f++)
+            {
+                philox.fillUniform(m_Weights.data() + f * weightsN, 0, weightsN, -0.5, 0.5, f);
+            }
+
+            return;
+        }
+
+        // One generator per filter, like one per neuron in Neuron
+        for (size_t f = 0; f < filtersN; f++)
+        {
+            std::mt19937 weightGenerator(seedGen->seed());
+            std::uniform_real_distribution<double> weightDist(-0.5, 0.5);
+
+            for (size_t w = 0; w < weightsN; w++)
+            {
+                m_Weights[f * weightsN + w] = weightDist(weightGenerator);
+            }
+        }
+    }
+
+    //! Creates a layer of zero parameters, to be read with setParameter().
+    //! @throws std::domain_error See above.
+    explicit Conv2DLayer(const ImageShape& inputShape, size_t filtersN, size_t kernelSize, size_t stride,
+        size_t padding, ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        ImageLayer(inputShape, ImageShape(filtersN, outputsCount(inputShape.height, kernelSize, stride, padding),
+            outputsCount(inputShape.width, kernelSize, stride, padding)), kernelSize, stride, afunc),
+        m_AFunc(afunc), m_Optimizer(optimizer), m_Padding(padding),
+        m_Weights(filtersN * inputShape.channels * kernelSize * kernelSize),
+        m_WeightsPrevChange(m_Weights.size()), m_Gradients(m_Weights.size()),
+        m_Biases(filtersN), m_BiasesPrevChange(filtersN), m_BiasGradients(filtersN)
+    {
+
+    }
+
+    //! Creates a layer with predefined parameters.
+    //! @param params Filter by filter, the weights then the bias, see copyParameters().
+    //! @throws std::domain_error See above, or if the number of parameters is not the
+    //!   one of the filters.
+    explicit Conv2DLayer(const ImageShape& inputShape, size_t filtersN, size_t kernelSize, size_t stride,
+        size_t padding, ActivationFunctions afunc, const std::vector<double>& params,
+        const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        Conv2DLayer(inputShape, filtersN, kernelSize, stride, padding, afunc, optimizer)
+    {
+        if (params.size() != parametersCount())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Convolutional layer] Parameters are inconsistent: expected "
+                << parametersCount() << " provided " << params.size() << ".").str()
+            );
+        }
+
+        restoreParameters(params, 0);
+    }
+
+    // No need to apply the rule of five as the class contains no raw pointers
+
+    LayerType type() const override
+    {
+        return LayerType::Conv2D;
+    }
+
+    size_t filtersCount() const
+    {
+        return m_Biases.size();
+    }
+
+    size_t padding() const
+    {
+        return m_Padding;
+    }
+
+    ActivationFunctions activationFunction() const
+    {
+        return m_AFunc;
+    }
+
+    //! Chooses the algorithm of the convolution; ConvAlgorithm::Auto by default.
+    void setAlgorithm(ConvAlgorithm algorithm)
+    {
+        m_Algorithm = algorithm;
+    }
+
+    ConvAlgorithm algorithm() const
+    {
+        return m_Algorithm;
+    }
+
+    void inspect(std::ostream& os, size_t& weightN) const override
+    {
+        os << "Neurons: " << size() << " convolution of " << filtersCount() << " filters";
+        inspectShapes(os);
+        os << " padding " << m_Padding << " activation: "
+            << ActivationFunctionFactory::build(m_AFunc)->name() << "\n";
+
+        for (size_t f = 0; f < filtersCount(); f++)
+        {
+            os << " Filter " << (f + 1) << "\n";
+
+            for (size_t w = 0; w < filterWeightsCount(); w++)
+            {
+                os << "  w" << weightN << ": " << m_Weights[f * filterWeightsCount() + w] << "\n";
+                ++weightN;
+            }
+
+            os << "  Bias: " << m_Biases[f] << "\n";
+        }
+    }
+
+    //! @returns Number of values copied by im2col; 0 for the direct algorithm.
+    size_t scratchSize() const override
+    {
+        return useIm2col() ? filterWeightsCount() * positionsCount() : 0;
+    }
+
+    void calcOutputs(const double* inputs, double* outputs, double* scratch) const override
+    {
+        convolve(inputs, outputs, scratch);
+    }
+
+    std::shared_ptr<const ImageLayer> clone() const override
+    {
+        return std::make_shared<Conv2DLayer>(*this);
+    }
+
+    //! Applies the accumulated gradients to the weights and biases with momentum, like
+    //! Neuron::updateWeights(). The weights of all the filters are contiguous and few so
+    //! they are updated in one loop, on the calling thread.
+    void updateWeights(size_t threadsN) override
+    {
+        if (m_Passes == 0)
+        {
+            return;
+        }
+
+        const double passes = static_cast<double>(m_Passes);
+        const double learningRate = m_Optimizer->learningRate();
+        const double momentum = m_Optimizer->momentum();
+
+        applyChanges(m_Weights.data(), m_WeightsPrevChange.data(), m_Gradients.data(),
+            m_Weights.size(), learningRate, momentum, passes);
+        applyChanges(m_Biases.data(), m_BiasesPrevChange.data(), m_BiasGradients.data(),
+            m_Biases.size(), learningRate, momentum, passes);
+
+        m_Passes = 0;
+    }
+
+    size_t parametersCount() const override
+    {
+        return m_Weights.size() + m_Biases.size();
+    }
+
+    LayerCost cost(TrainingPhase phase, size_t summedN) const override
+    {
+        const double outputsN = static_cast<double>(size());
+        const double inputsN = static_cast<double>(m_InputShape.size());
+        const double paramsN = static_cast<double>(parametersCount());
+        // Multiply-adds of the weights and bias of a filter at each position
+        const double macsN = outputsN * (filterWeightsCount() + 1);
+        LayerCost cost;
+
+        switch (phase)
+        {
+        case TrainingPhase::Forward:
+            // Weighted sums, activations; weights and inputs read, outputs written
+            cost.flops = 2.0 * macsN + outputsN;
+            cost.bytes = sizeof(double) * (paramsN + inputsN + outputsN);
+            break;
+        case TrainingPhase::Backward:
+            // Sums of the deltas of the next layer, deltas, gradients accumulated and
+            // deltas of the inputs
+            cost.flops = 2.0 * outputsN * summedN + 2.0 * outputsN + 4.0 * macsN;
+            cost.bytes = sizeof(double) * (2.0 * outputsN * summedN + 2.0 * paramsN + 2.0 * inputsN + outputsN);
+            break;
+        case TrainingPhase::Update:
+            // Change with momentum applied; weights, changes and gradients read and written
+            cost.flops = 5.0 * paramsN;
+            cost.bytes = sizeof(double) * 6.0 * paramsN;
+            break;
+        default:
+            break;
+        }
+
+        return cost;
+    }
+
+    LayerMemory memory() const override
+    {
+        const size_t paramsN = parametersCount();
+        const size_t inputsN = m_InputShape.size();
+        LayerMemory memory;
+        memory.parameterBytes = sizeof(double) * paramsN;
+        // Previous change and gradient of each parameter, deltas of the inputs, columns
+        memory.trainingBytes = sizeof(double) * (2 * paramsN + inputsN + (m_KeepInputs ? inputsN : 0)
+            + (useIm2col() ? filterWeightsCount() * positionsCount() : 0));
+        // Output and delta of each position of each filter
+        memory.activationBytes = sizeof(double) * 2 * size();
+
+        return memory;
+    }
+
+    void copyParameters(std::vector<double>& params) const override
+    {
+        const size_t weightsN = filterWeightsCount();
+
+        for (size_t f = 0; f < filtersCount(); f++)
+        {
+            params.insert(params.end(), m_Weights.cbegin() + f * weightsN, m_Weights.cbegin() + (f + 1) * weightsN);
+            params.push_back(m_Biases[f]);
+        }
+    }
+
+    //! Sets parameter @p n in the order of copyParameters(), e.g. while decoding them,
+    //! without an intermediate copy.
+    void setParameter(size_t n, double value)
+    {
+        const size_t weightsN = filterWeightsCount();
+        const size_t f = n / (weightsN + 1), w = n % (weightsN + 1);
+        (w == weightsN ? m_Biases[f] : m_Weights[f * weightsN + w]) = value;
+    }
+
+    size_t restoreParameters(const std::vector<double>& params, size_t offset) override
+    {
+        const size_t weightsN = filterWeightsCount();
+
+        for (size_t f = 0; f < filtersCount(); f++)
+        {
+            std::copy(params.cbegin() + offset, params.cbegin() + offset + weightsN,
+                m_Weights.begin() + f * weightsN);
+            offset += weightsN;
+            m_Biases[f] = params[offset++];
+        }
+
+        return offset;
+    }
+
+    void copyOptimizerState(std::vector<double>& state) const override
+    {
+        const size_t weightsN = filterWeightsCount();
+
+        for (size_t f = 0; f < filtersCount(); f++)
+        {
+            state.insert(state.end(), m_WeightsPrevChange.cbegin() + f * weightsN,
+                m_WeightsPrevChange.cbegin() + (f + 1) * weightsN);
+            state.push_back(m_BiasesPrevChange[f]);
+        }
+    }
+
+    size_t restoreOptimizerState(const std::vector<double>& state, size_t offset) override
+    {
+        const size_t weightsN = filterWeightsCount();
+
+        for (size_t f = 0; f < filtersCount(); f++)
+        {
+            std::copy(state.cbegin() + offset, state.cbegin() + offset + weightsN,
+                m_WeightsPrevChange.begin() + f * weightsN);
+            offset += weightsN;
+            m_BiasesPrevChange[f] = state[offset++];
+        }
+
+        return offset;
+    }
+
+    //! Saves the parameters, previous changes and gradients, filter by filter, so that
+    //! a loaded network trains on like the saved one.
+    void saveToFile(std::ofstream& output) const override
+    {
+        output << "LayerType: " << static_cast<int>(LayerType::Conv2D) << "\n"
+            << "[LayerBegin] \n"
+            << "ActivationFunction: " << static_cast<int>(m_AFunc) << "\n";
+
+        saveShapes(output);
+
+        output << "Filters: " << filtersCount() << "\n"
+            << "Padding: " << m_Padding << "\n"
+            << "Parameters: ";
+
+        std::vector<double> values;
+        copyParameters(values);
+        saveValues(output, values);
+
+        output << "PrevChanges: ";
+        values.clear();
+        copyOptimizerState(values);
+        saveValues(output, values);
+
+        output << "Gradients: ";
+        values.clear();
+
+        for (size_t f = 0; f < filtersCount(); f++)
+        {
+            values.insert(values.end(), m_Gradients.cbegin() + f * filterWeightsCount(),
+                m_Gradients.cbegin() + (f + 1) * filterWeightsCount());
+            values.push_back(m_BiasGradients[f]);
+        }
+
+        saveValues(output, values);
+
+        output << "Passes: " << m_Passes << "\n"
+            << "[LayerEnd] \n\n";
+    }
+
+    static Conv2DLayer readFromFile(std::ifstream& file, const std::shared_ptr<const SGDOptimizer>& optimizer)
+    {
+        std::string tag;
+
+        Utils::checkTag(file, tag, "[LayerBegin]");
+
+        int afunc = 0;
+        ImageShape inputShape;
+        size_t kernelSize = 0;
+        size_t stride = 0;
+        size_t filtersN = 0;
+        size_t padding = 0;
+        file >> tag >> afunc;
+        readShapes(file, inputShape, kernelSize, stride);
+        file >> tag >> filtersN;
+        file >> tag >> padding;
+
+        Conv2DLayer layer(inputShape, filtersN, kernelSize, stride, padding,
+            static_cast<ActivationFunctions>(afunc), optimizer);
+        std::vector<double> values(layer.parametersCount());
+
+        Utils::checkTag(file, tag, "Parameters:");
+        readValues(file, values);
+        layer.restoreParameters(values, 0);
+
+        Utils::checkTag(file, tag, "PrevChanges:");
+        readValues(file, values);
+        layer.restoreOptimizerState(values, 0);
+
+        Utils::checkTag(file, tag, "Gradients:");
+        readValues(file, values);
+
+        for (size_t f = 0, offset = 0; f < filtersN; f++)
+        {
+            for (size_t w = 0; w < layer.filterWeightsCount(); w++)
+            {
+                layer.m_Gradients[f * layer.filterWeightsCount() + w] = values[offset++];
+            }
+
+            layer.m_BiasGradients[f] = values[offset++];
+        }
+
+        file >> tag >> layer.m_Passes;
+
+        Utils::checkTag(file, tag, "[LayerEnd]");
+
+        return layer;
+    }
+
+protected:
+    void calcTrainingOutputs(const double* inputs, double* outputs) override
+    {
+        m_Columns.resize(scratchSize());
+        convolve(inputs, outputs, m_Columns.data());
+    }
+
+    //! dE/dw = Sum over the positions of delta * i, and dE/db = Sum of the deltas.
+    void calcGradients() override
+    {
+        const size_t weightsN = filterWeightsCount();
+        const size_t positionsN = positionsCount();
+        const double* inputs = m_Inputs.data();
+        m_Passes += 1;
+
+        for (size_t f = 0; f < filtersCount(); f++)
+        {
+            const double* deltas = m_Deltas.data() + f * positionsN;
+            double gradient = 0.0;
+
+            for (size_t p = 0; p < positionsN; p++)
+            {
+                gradient += deltas[p];
+            }
+
+            m_BiasGradients[f] += gradient;
+        }
+
+        if (useIm2col())
+        {
+            // Product of the deltas by the transposed columns
+            m_Columns.resize(scratchSize());
+            toColumns(inputs, m_Columns.data());
+
+            for (size_t f = 0; f < filtersCount(); f++)
+            {
+                const double* deltas = m_Deltas.data() + f * positionsN;
+
+                for (size_t w = 0; w < weightsN; w++)
+                {
+                    m_Gradients[f * weightsN + w] += dot(deltas, m_Columns.data() + w * positionsN, positionsN);
+                }
+            }
+
+            return;
+        }
+
+        for (size_t f = 0; f < filtersCount(); f++)
+        {
+            const double* deltas = m_Deltas.data() + f * positionsN;
+
+            forEachKernelRow(
+                [&](size_t w, size_t oy, size_t first, size_t last, const double* row)
+                {
+                    double gradient = 0.0;
+
+                    for (size_t ox = first; ox < last; ox++)
+                    {
+                        gradient += deltas[oy * m_OutputShape.width + ox] * row[(ox - first) * m_Stride];
+                    }
+
+                    m_Gradients[f * weightsN + w] += gradient;
+                }, inputs);
+        }
+    }
+
+    //! dE/di = Sum over the filters and positions reading i of delta * w, scattered
+    //! directly from each delta to the inputs of its window.
+    void calcInputDeltas(double* inputDeltas) const override
+    {
+        const size_t weightsN = filterWeightsCount();
+        const size_t positionsN = positionsCount();
+
+        for (size_t f = 0; f < filtersCount(); f++)
+        {
+            const double* deltas = m_Deltas.data() + f * positionsN;
+
+            forEachKernelRow(
+                [&](size_t w, size_t oy, size_t first, size_t last, double* row)
+                {
+                    const double weight = m_Weights[f * weightsN + w];
+
+                    for (size_t ox = first; ox < last; ox++)
+                    {
+                        row[(ox - first) * m_Stride] += weight * deltas[oy * m_OutputShape.width + ox];
+                    }
+                }, inputDeltas);
+        }
+    }
+
+private:
+    const ActivationFunctions m_AFunc;
+    const std::shared_ptr<const SGDOptimizer> m_Optimizer;
+    const size_t m_Padding = 0;
+    ConvAlgorithm m_Algorithm = ConvAlgorithm::Auto;
+
+    //! Filter by filter, channel by channel, row by row.
+    std::vector<double> m_Weights;
+    std::vector<double> m_WeightsPrevChange;
+    std::vector<double> m_Gradients;
+    std::vector<double> m_Biases;
+    std::vector<double> m_BiasesPrevChange;
+    std::vector<double> m_BiasGradients;
+    size_t m_Passes = 0;
+
+    //! Inputs copied by im2col: one row per weight of a filter, one column per position.
+    std::vector<double> m_Columns;
+
+    size_t filterWeightsCount() const
+    {
+        return m_InputShape.channels * m_KernelSize * m_KernelSize;
+    }
+
+    size_t positionsCount() const
+    {
+        return m_OutputShape.height * m_OutputShape.width;
+    }
+
+    bool useIm2col() const
+    {
+        return m_Algorithm == ConvAlgorithm::Im2col
+            || (m_Algorithm == ConvAlgorithm::Auto && filterWeightsCount() > kDirectMaxWeights);
+    }
+
+    //! Range [first, last) of the outputs along a dimension of @p inputsN inputs whose
+    //! input at offset @p k of the kernel is not padding.
+    void validRange(size_t k, size_t inputsN, size_t outputsN, size_t& first, size_t& last) const
+    {
+        first = k >= m_Padding ? 0 : (m_Padding - k + m_Stride - 1) / m_Stride;
+        last = inputsN + m_Padding > k ? std::min(outputsN, (inputsN + m_Padding - k + m_Stride - 1) / m_Stride) : 0;
+        first = std::min(first, last);
+    }
+
+    //! Calls @p func for each weight w of a filter and each output row oy, with the
+    //! range [first, last) of the outputs of the row reading an input which is not
+    //! padding, and a pointer row such that row[(ox - first) * m_Stride] is the value of
+    //! @p values at the input read by weight w for output (oy, ox).
+    template<typename Func, typename T>
+    void forEachKernelRow(Func func, T* values) const
+    {
+        const size_t height = m_InputShape.height, width = m_InputShape.width;
+
+        for (size_t c = 0, w = 0; c < m_InputShape.channels; c++)
+        {
+            for (size_t ky = 0; ky < m_KernelSize; ky++)
+            {
+                size_t firstY = 0, lastY = 0;
+                validRange(ky, height, m_OutputShape.height, firstY, lastY);
+
+                for (size_t kx = 0; kx < m_KernelSize; kx++, w++)
+                {
+                    size_t firstX = 0, lastX = 0;
+                    validRange(kx, width, m_OutputShape.width, firstX, lastX);
+
+                    if (firstX == lastX)
+                    {
+                        continue;
+                    }
+
+                    for (size_t oy = firstY; oy < lastY; oy++)
+                    {
+                        // Input (c, oy * stride + ky - padding, first * stride + kx - padding)
+                        func(w, oy, firstX, lastX,
+                            values + (c * height + oy * m_Stride + ky - m_Padding) * width + firstX * m_Stride + kx - m_Padding);
+                    }
+                }
+            }
+        }
+    }
+
+    //! Calculates the outputs with the algorithm of the layer, @p columns being the
+    //! buffer of im2col, of scratchSize() values.
+    void convolve(const double* inputs, double* outputs, double* columns) const
+    {
+        const size_t weightsN = filterWeightsCount();
+        const size_t positionsN = positionsCount();
+        std::fill(outputs, outputs + size(), 0.0);
+
+        if (useIm2col())
+        {
+            toColumns(inputs, columns);
+
+            for (size_t f = 0; f < filtersCount(); f++)
+            {
+                multiplyColumns(m_Weights.data() + f * weightsN, columns, outputs + f * positionsN,
+                    weightsN, positionsN);
+            }
+        }
+        else
+        {
+            for (size_t f = 0; f < filtersCount(); f++)
+            {
+                double* filterOutputs = outputs + f * positionsN;
+
+                forEachKernelRow(
+                    [&](size_t w, size_t oy, size_t first, size_t last, const double* row)
+                    {
+                        addScaled(m_Weights[f * weightsN + w], row, m_Stride,
+                            filterOutputs + oy * m_OutputShape.width + first, last - first);
+                    }, inputs);
+            }
+        }
+
+        for (size_t f = 0; f < filtersCount(); f++)
+        {
+            double* filterOutputs = outputs + f * positionsN;
+
+            for (size_t p = 0; p < positionsN; p++)
+            {
+                const double total = filterOutputs[p] + m_Biases[f];
+                filterOutputs[p] = m_Func ? m_Func->calc(total) : total;
+            }
+        }
+    }
+
+    //! im2col: copies the input read by weight w of a filter at position p to
+    //! columns[w * positions + p]; zero for the padding.
+    void toColumns(const double* inputs, double* columns) const
+    {
+        const size_t positionsN = positionsCount();
+        std::fill(columns, columns + filterWeightsCount() * positionsN, 0.0);
+
+        forEachKernelRow(
+            [&](size_t w, size_t oy, size_t first, size_t last, const double* row)
+            {
+                double* column = columns + w * positionsN + oy * m_OutputShape.width;
+
+                for (size_t ox = first; ox < last; ox++)
+                {
+                    column[ox] = row[(ox - first) * m_Stride];
+                }
+            }, inputs);
+    }
+
+    //! Adds the product of the weights of one filter by the columns to @p outputs: the
+    //! weights are taken one after another, so each output is accumulated in the order
+    //! of the weights, and the loop over the positions is vectorized.
+    static void multiplyColumns(const double* YANNL_RESTRICT weights, const double* YANNL_RESTRICT columns,
+        double* YANNL_RESTRICT outputs, size_t weightsN, size_t positionsN)
+    {
+        for (size_t w = 0; w < weightsN; w++)
+        {
+            const double weight = weights[w];
+            const double* YANNL_RESTRICT column = columns + w * positionsN;
+
+            for (size_t p = 0; p < positionsN; p++)
+            {
+                outputs[p] += weight * column[p];
+            }
+        }
+    }
+
+    //! outputs[n] += weight * inputs[n * stride]; vectorized for a stride of 1.
+    static void addScaled(double weight, const double* YANNL_RESTRICT inputs, size_t stride,
+        double* YANNL_RESTRICT outputs, size_t valuesN)
+    {
+        if (stride == 1)
+        {
+            for (size_t n = 0; n < valuesN; n++)
+            {
+                outputs[n] += weight * inputs[n];
+            }
+
+            return;
+        }
+
+        for (size_t n = 0; n < valuesN; n++)
+        {
+            outputs[n] += weight * inputs[n * stride];
+        }
+    }
+
+    static double dot(const double* YANNL_RESTRICT values1, const double* YANNL_RESTRICT values2, size_t valuesN)
+    {
+        double total = 0.0;
+
+        for (size_t n = 0; n < valuesN; n++)
+        {
+            total += values1[n] * values2[n];
+        }
+
+        return total;
+    }
+
+    //! Momentum update kernel of Neuron::updateWeights(), which also resets the gradients.
+    static void applyChanges(double* YANNL_RESTRICT weights, double* YANNL_RESTRICT prevChanges,
+        double* YANNL_RESTRICT gradients, size_t weightsN, double learningRate, double momentum,
+        double passes)
+    {
+        for (size_t n = 0; n < weightsN; n++)
+        {
+            const double change = learningRate * gradients[n] / passes + momentum * prevChanges[n];
+            weights[n] -= change;
+            prevChanges[n] = change;
+            gradients[n] = 0.0;
+        }
+    }
+
+    static void saveValues(std::ofstream& output, const std::vector<double>& values)
+    {
+        for (const auto& value : values)
+        {
+            output << value << " ";
+        }
+
+        output << "\n";
+    }
+
+    static void readValues(std::ifstream& file, std::vector<double>& values)
+    {
+        for (double& value : values)
+        {
+            file >> value;
+        }
+    }
+};
+
+//! @brief Max or average pooling layer: each output is the maximum or the average of a
+//! window of pool x pool inputs of its channel, the windows moving by the stride. It has
+//! no parameters; it divides the size of the images by the stride.
+class PoolLayer : public ImageLayer // public inheritance to be able to use std::make_shared
+{
+public:
+    //! @param type LayerType::MaxPool or LayerType::AvgPool.
+    //! @param poolSize Height and width of the windows.
+    //! @param stride Distance between two windows; the pool size if 0, so that the
+    //!   windows do not overlap.
+    //! @throws std::domain_error If the pool does not fit the inputs, if @p poolSize is
+    //!   0 or if @p type is not a pooling type.
+    explicit PoolLayer(LayerType type, const ImageShape& inputShape, size_t poolSize, size_t stride = 0) :
+        ImageLayer(inputShape, ImageShape(inputShape.channels,
+            outputsCount(inputShape.height, poolSize, stride == 0 ? poolSize : stride, 0),
+            outputsCount(inputShape.width, poolSize, stride == 0 ? poolSize : stride, 0)),
+            poolSize, stride == 0 ? poolSize : stride, ActivationFunctions::Identity),
+        m_Type(type)
+    {
+        if (type != LayerType::MaxPool && type != LayerType::AvgPool)
+        {
+            throw std::domain_error("[Pooling layer] Type must be MaxPool or AvgPool.");
+        }
+    }
+
+    // No need to apply the rule of five as the class contains no raw pointers
+
+    LayerType type() const override
+    {
+        return m_Type;
+    }
+
+    void inspect(std::ostream& os, size_t& weightN) const override
+    {
+        os << "Neurons: " << size() << (m_Type == LayerType::MaxPool ? " max" : " average") << " pooling";
+        inspectShapes(os);
+        os << "\n";
+    }
+
+    void calcOutputs(const double* inputs, double* outputs, double* /*scratch*/) const override
+    {
+        pool(inputs, outputs, nullptr);
+    }
+
+    std::shared_ptr<const ImageLayer> clone() const override
+    {
+        return std::make_shared<PoolLayer>(*this);
+    }
+
+    void updateWeights(size_t threadsN) override
+    {
+
+    }
+
+    size_t parametersCount() const override
+    {
+        return 0;
+    }
+
+    LayerCost cost(TrainingPhase phase, size_t summedN) const override
+    {
+        const double outputsN = static_cast<double>(size());
+        const double inputsN = static_cast<double>(m_InputShape.size());
+        const double windowN = static_cast<double>(m_KernelSize * m_KernelSize);
+        LayerCost cost;
+
+        if (phase == TrainingPhase::Forward)
+        {
+            // A comparison or an addition per input of each window
+            cost.flops = outputsN * windowN;
+            cost.bytes = sizeof(double) * (outputsN * windowN + outputsN);
+        }
+        else if (phase == TrainingPhase::Backward)
+        {
+            // Sums of the deltas of the next layer, deltas routed to the inputs
+            cost.flops = 2.0 * outputsN * summedN + outputsN * (m_Type == LayerType::MaxPool ? 1.0 : windowN);
+            cost.bytes = sizeof(double) * (2.0 * outputsN * summedN + outputsN + inputsN);
+        }
+
+        return cost;
+    }
+
+    LayerMemory memory() const override
+    {
+        const size_t inputsN = m_InputShape.size();
+        LayerMemory memory;
+        // Index of the maximum of each window, deltas of the inputs
+        memory.trainingBytes = (m_Type == LayerType::MaxPool ? sizeof(size_t) * size() : 0)
+            + sizeof(double) * (inputsN + (m_KeepInputs ? inputsN : 0));
+        memory.activationBytes = sizeof(double) * 2 * size();
+
+        return memory;
+    }
+
+    void copyParameters(std::vector<double>& params) const override
+    {
+
+    }
+
+    size_t restoreParameters(const std::vector<double>& params, size_t offset) override
+    {
+        return offset;
+    }
+
+    void copyOptimizerState(std::vector<double>& state) const override
+    {
+
+    }
+
+    size_t restoreOptimizerState(const std::vector<double>& state, size_t offset) override
+    {
+        return offset;
+    }
+
+    void saveToFile(std::ofstream& output) const override
+    {
+        output << "LayerType: " << static_cast<int>(m_Type) << "\n"
+            << "[LayerBegin] \n";
+
+        saveShapes(output);
+
+        output << "[LayerEnd] \n\n";
+    }
+
+    static PoolLayer readFromFile(std::ifstream& file, LayerType type)
+    {
+        std::string tag;
+
+        Utils::checkTag(file, tag, "[LayerBegin]");
+
+        ImageShape inputShape;
+        size_t poolSize = 0;
+        size_t stride = 0;
+        readShapes(file, inputShape, poolSize, stride);
+
+        Utils::checkTag(file, tag, "[LayerEnd]");
+
+        return PoolLayer(type, inputShape, poolSize, stride);
+    }
+
+protected:
+    void calcTrainingOutputs(const double* inputs, double* outputs) override
+    {
+        m_Maxima.resize(size());
+        pool(inputs, outputs, m_Type == LayerType::MaxPool ? m_Maxima.data() : nullptr);
+    }
+
+    void calcGradients() override
+    {
+        // No parameters
+    }
+
+    //! The delta of a max goes to the input which was the maximum; the delta of an
+    //! average is shared by the inputs of the window.
+    void calcInputDeltas(double* inputDeltas) const override
+    {
+        if (m_Type == LayerType::MaxPool)
+        {
+            for (size_t n = 0; n < m_Deltas.size(); n++)
+            {
+                inputDeltas[m_Maxima[n]] += m_Deltas[n];
+            }
+
+            return;
+        }
+
+        const double windowN = static_cast<double>(m_KernelSize * m_KernelSize);
+
+        forEachWindow(
+            [&](size_t n, size_t first)
+            {
+                const double delta = m_Deltas[n] / windowN;
+
+                for (size_t ky = 0; ky < m_KernelSize; ky++)
+                {
+                    for (size_t kx = 0; kx < m_KernelSize; kx++)
+                    {
+                        inputDeltas[first + ky * m_InputShape.width + kx] += delta;
+                    }
+                }
+            });
+    }
+
+private:
+    const LayerType m_Type;
+    //! Index of the input which was the maximum of each window, for max pooling.
+    std::vector<size_t> m_Maxima;
+
+    //! Calls @p func with the index of each output and the index of the first input of
+    //! its window.
+    template<typename Func>
+    void forEachWindow(Func func) const
+    {
+        const size_t height = m_InputShape.height, width = m_InputShape.width;
+
+        for (size_t c = 0, n = 0; c < m_OutputShape.channels; c++)
+        {
+            for (size_t oy = 0; oy < m_OutputShape.height; oy++)
+            {
+                for (size_t ox = 0; ox < m_OutputShape.width; ox++, n++)
+                {
+                    func(n, (c * height + oy * m_Stride) * width + ox * m_Stride);
+                }
+            }
+        }
+    }
+
+    //! @param maxima Receives the index of the maximum of each window; nullptr if not needed.
+    void pool(const double* inputs, double* outputs, size_t* maxima) const
+    {
+        const size_t width = m_InputShape.width;
+        const double windowN = static_cast<double>(m_KernelSize * m_KernelSize);
+
+        forEachWindow(
+            [&](size_t n, size_t first)
+            {
+                if (m_Type == LayerType::AvgPool)
+                {
+                    double total = 0.0;
+
+                    for (size_t ky = 0; ky < m_KernelSize; ky++)
+                    {
+                        for (size_t kx = 0; kx < m_KernelSize; kx++)
+                        {
+                            total += inputs[first + ky * width + kx];
+                        }
+                    }
+
+                    outputs[n] = total / windowN;
+                    return;
+                }
+
+                size_t best = first;
+
+                for (size_t ky = 0; ky < m_KernelSize; ky++)
+                {
+                    for (size_t kx = 0; kx < m_KernelSize; kx++)
+                    {
+                        const size_t i = first + ky * width + kx;
+
+                        if (inputs[i] > inputs[best])
+                        {
+                            best = i;
+                        }
+                    }
+                }
+
+                outputs[n] = inputs[best];
+
+                if (maxima != nullptr)
+                {
+                    maxima[n] = best;
+                }
+            });
+    }
+};
+
+}
+
+#endif // YANNL_IMAGE_LAYERS_H
@@ -0,0 +1,447 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_INFERENCE_PLAN_H
+#define YANNL_INFERENCE_PLAN_H
+
+#include "ImageLayers.h"
+#include <memory>   // std::shared_ptr
+#include <utility>  // std::pair
+
+namespace YANNL
+{
+
+//! @brief Execution plan of a trained network for inference only, built with
+//! NeuralNetwork::compile(). Compared to NeuralNetwork::propagateForward(inputs, true):
+//! - dropout layers are removed as they are the identity during inference,
+//! - the weights of each layer are interleaved by panels of 32 neurons so that the
+//!   weighted sums of 32 neurons are calculated together, in vector registers,
+//! - bias and activation are applied when each output is calculated, and identity
+//!   activations are skipped,
+//! - outputs go through two buffers instead of a new vector per layer; an
+//!   InferenceSession preallocates them to predict without any allocation,
+//! - @ref probableClass(const std::vector<double>&) const skips the softmax and keeps
+//!   the best output while calculating the last layer,
+//! - convolutional and pooling layers are copied and calculated by
+//!   ImageLayer::calcOutputs(), which only uses the two buffers of the plan and a
+//!   scratch buffer, e.g. for im2col, allocated with them.
+//! The outputs are exactly those of the network, provided a * b + c is not contracted
+//! into a fused multiply-add: the yannl CMake target adds -ffp-contract=off. The plan is a copy: it is not updated
+//! if the network is trained afterwards.
+class InferencePlan
+{
+public:
+    //! @param inputSize Number of inputs of the network.
+    //! @param layers Layers of the network; the last one must be an output layer.
+    explicit InferencePlan(size_t inputSize, const std::vector<std::shared_ptr<NeuronLayer>>& layers) :
+        m_InputSize(inputSize), m_MaxWidth(inputSize)
+    {
+        for (const std::shared_ptr<NeuronLayer>& layer : layers)
+        {
+            if (layer->dropoutLayer())
+            {
+                continue;
+            }
+            else if (isImageLayer(layer->type()))
+            {
+                Step step;
+                step.image = static_cast<const ImageLayer&>(*layer).clone();
+                step.inputsN = step.image->inputShape().size();
+                step.outputsN = step.image->size();
+                m_MaxWidth = std::max(m_MaxWidth, step.outputsN);
+                m_ScratchSize = std::max(m_ScratchSize, step.image->scratchSize());
+                m_Steps.push_back(std::move(step));
+                continue;
+            }
+
+            const DenseLayer& dense = static_cast<const DenseLayer&>(*layer);
+            Step step;
+            step.outputsN = dense.size();
+            step.inputsN = step.outputsN > 0 ? dense.parametersCount() / step.outputsN - 1 : 0;
+            step.softmax = dense.type() == LayerType::OutputClassification;
+
+            if (dense.activationFunction() != ActivationFunctions::Identity)
+            {
+                step.func = ActivationFunctionFactory::build(dense.activationFunction());
+            }
+
+            // Parameters are copied neuron by neuron: weights then bias. The last
+            // panel is padded with neurons of null weights.
+            std::vector<double> params;
+            dense.copyParameters(params);
+            const size_t panelsN = (step.outputsN + kPanel - 1) / kPanel;
+            step.weights.assign(panelsN * kPanel * step.inputsN, 0.0);
+
+            for (size_t n = 0; n < step.outputsN; n++)
+            {
+                const double* neuron = params.data() + n * (step.inputsN + 1);
+                double* panel = step.weights.data() + (n / kPanel) * kPanel * step.inputsN;
+
+                for (size_t i = 0; i < step.inputsN; i++)
+                {
+                    panel[i * kPanel + n % kPanel] = neuron[i];
+                }
+
+                step.biases.push_back(neuron[step.inputsN]);
+            }
+
+            m_MaxWidth = std::max(m_MaxWidth, panelsN * kPanel);
+            m_Steps.push_back(std::move(step));
+        }
+    }
+
+    // No need to apply the rule of five as the class contains no raw pointers
+
+    size_t inputSize() const
+    {
+        return m_InputSize;
+    }
+
+    size_t outputSize() const
+    {
+        return m_Steps.empty() ? m_InputSize : m_Steps.back().outputsN;
+    }
+
+    //! @returns Number of layers executed; dropout layers are not counted.
+    size_t stepsCount() const
+    {
+        return m_Steps.size();
+    }
+
+    //! @returns Same outputs as NeuralNetwork::propagateForward(inputs, true).
+    //! @throws std::domain_error If the size of @p inputs is not the input size.
+    std::vector<double> predict(const std::vector<double>& inputs) const
+    {
+        checkInputs(inputs, "[Inference plan/Predict]");
+
+        std::vector<double> current(m_MaxWidth), next(m_MaxWidth), scratch(m_ScratchSize);
+        const double* outputs = calcSteps(inputs.data(), current.data(), next.data(), scratch.data(), m_Steps.size());
+
+        return std::vector<double>(outputs, outputs + outputSize());
+    }
+
+    //! Predicts several samples with one pass over the weights: each panel of weights
+    //! is used for all the samples while it is in cache.
+    //! @returns Same outputs as @ref predict(const std::vector<double>&) const for each sample.
+    //! @throws std::domain_error If the size of a sample is not the input size.
+    std::vector<std::vector<double>> predictBatch(const std::vector<std::vector<double>>& batch) const
+    {
+        std::vector<const double*> inputs;
+        inputs.reserve(batch.size());
+
+        for (const std::vector<double>& sample : batch)
+        {
+            checkInputs(sample, "[Inference plan/Predict batch]");
+            inputs.push_back(sample.data());
+        }
+
+        std::vector<double> current(batch.size() * m_MaxWidth), next(batch.size() * m_MaxWidth), scratch(m_ScratchSize);
+        const double* outputs = calcStepsBatch(inputs.data(), inputs.size(), current.data(), next.data(), scratch.data());
+
+        std::vector<std::vector<double>> results;
+        results.reserve(batch.size());
+
+        for (size_t b = 0; b < batch.size(); b++)
+        {
+            const double* sampleOutputs = m_Steps.empty() ? inputs[b] : outputs + b * m_MaxWidth;
+            results.emplace_back(sampleOutputs, sampleOutputs + outputSize());
+        }
+
+        return results;
+    }
+
+    //! Same as @ref predictBatch(const std::vector<std::vector<double>>&) const on samples
+    //! read through pointers to inputSize() values each, e.g. rows of a matrix, without
+    //! copying them.
+    //! @param outputs Resized to the outputs of all the samples: those of sample b are
+    //!   at b * outputSize().
+    void predictBatch(const std::vector<const double*>& batch, std::vector<double>& outputs) const
+    {
+        std::vector<double> current(batch.size() * m_MaxWidth), next(batch.size() * m_MaxWidth), scratch(m_ScratchSize);
+        const double* lastOutputs = calcStepsBatch(batch.data(), batch.size(), current.data(), next.data(),
+            scratch.data());
+        outputs.resize(batch.size() * outputSize());
+
+        for (size_t b = 0; b < batch.size(); b++)
+        {
+            const double* sampleOutputs = m_Steps.empty() ? batch[b] : lastOutputs + b * m_MaxWidth;
+            std::copy(sampleOutputs, sampleOutputs + outputSize(), outputs.begin() + b * outputSize());
+        }
+    }
+
+    //! @returns Same class as NeuralNetwork::probableClass() after propagating @p inputs
+    //!   forward, i.e. index of the highest output of the last layer before the softmax,
+    //!   as the softmax does not change the order of the outputs.
+    //! @throws std::domain_error If the size of @p inputs is not the input size.
+    size_t probableClass(const std::vector<double>& inputs) const
+    {
+        checkInputs(inputs, "[Inference plan/Probable class]");
+
+        std::vector<double> current(m_MaxWidth), next(m_MaxWidth), scratch(m_ScratchSize);
+        return calcProbableClass(inputs.data(), current.data(), next.data(), scratch.data());
+    }
+
+    //! Returns the @p k most probable classes with their probabilities, from the most
+    //! to the least probable. The softmax denominator needs the exponential of every
+    //! output but the divisions are only done for the @p k classes returned.
+    //! Probabilities are the same as those of @ref predict(const std::vector<double>&) const.
+    //! @param k Number of classes; all the classes if larger than the output size.
+    //! @throws std::domain_error If the size of @p inputs is not the input size or if
+    //!   the last layer is not a classification layer.
+    std::vector<std::pair<size_t, double>> topClasses(const std::vector<double>& inputs, size_t k) const
+    {
+        checkInputs(inputs, "[Inference plan/Top classes]");
+
+        if (m_Steps.empty() || !m_Steps.back().softmax)
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Inference plan/Top classes] Last layer is not a classification layer.").str()
+            );
+        }
+
+        std::vector<double> current(m_MaxWidth), next(m_MaxWidth), scratch(m_ScratchSize);
+        const double* hidden = calcSteps(inputs.data(), current.data(), next.data(), scratch.data(), m_Steps.size() - 1);
+        double* logits = hidden == current.data() ? next.data() : current.data();
+
+        const Step& last = m_Steps.back();
+        calcOutputs(last, hidden, logits, scratch.data());
+
+        std::vector<size_t> classes(last.outputsN);
+        std::iota(classes.begin(), classes.end(), 0);
+        k = std::min(k, classes.size());
+
+        // Softmax preserves the order of the outputs: sort the logits
+        std::partial_sort(classes.begin(), classes.begin() + k, classes.end(),
+            [&](size_t c1, size_t c2)
+            {
+                return logits[c1] > logits[c2] || (logits[c1] == logits[c2] && c1 < c2);
+            });
+
+        double sumExp = 0.0;
+
+        for (size_t n = 0; n < last.outputsN; n++)
+        {
+            sumExp += std::exp(logits[n]);
+        }
+
+        std::vector<std::pair<size_t, double>> top;
+        top.reserve(k);
+
+        for (size_t n = 0; n < k; n++)
+        {
+            top.emplace_back(classes[n], std::exp(logits[classes[n]]) / sumExp);
+        }
+
+        return top;
+    }
+
+private:
+    friend class InferenceServer;
+    friend class InferenceSession;
+
+    //! Number of neurons whose weighted sums are calculated together.
+    static constexpr size_t kPanel = 32;
+
+    //! Dense layer with its weights interleaved by panels of neurons: weight i of
+    //! neuron n is at (n / kPanel) * kPanel * inputsN + i * kPanel + n % kPanel;
+    //! or image layer.
+    struct Step
+    {
+        size_t inputsN = 0;
+        size_t outputsN = 0;
+        std::vector<double> weights;
+        std::vector<double> biases;
+        //! nullptr for the identity, which is folded into the bias addition.
+        std::shared_ptr<ActivationFunction> func;
+        bool softmax = false;
+        //! Copy of an image layer; nullptr for a dense layer.
+        std::shared_ptr<const ImageLayer> image;
+    };
+
+    size_t m_InputSize = 0;
+    size_t m_MaxWidth = 0;
+    //! Largest scratch buffer of the image layers.
+    size_t m_ScratchSize = 0;
+    std::vector<Step> m_Steps;
+
+    void checkInputs(const std::vector<double>& inputs, const std::string& context) const
+    {
+        if (inputs.size() != m_InputSize)
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << context << " Input size is inconsistent: expected "
+                << m_InputSize << " provided " << inputs.size() << ".").str()
+            );
+        }
+    }
+
+    //! Calculates the outputs of the panel of neurons starting at @p first: weighted
+    //! sums, bias and activation. Each sum is accumulated in the same order as in
+    //! Neuron::propagateForward() to get the same values; the panel only interleaves
+    //! independent sums. Padding neurons of the last panel are not written to @p outputs.
+    static void calcPanel(const Step& step, size_t first, const double* YANNL_RESTRICT inputs,
+        double* YANNL_RESTRICT outputs)
+    {
+        const double* YANNL_RESTRICT panel = step.weights.data() + first * step.inputsN;
+        double totals[kPanel] = {};
+
+        for (size_t i = 0; i < step.inputsN; i++)
+        {
+            const double input = inputs[i];
+
+            for (size_t k = 0; k < kPanel; k++)
+            {
+                totals[k] += input * panel[i * kPanel + k];
+            }
+        }
+
+        const size_t neuronsN = step.outputsN - first < kPanel ? step.outputsN - first : kPanel;
+
+        for (size_t k = 0; k < neuronsN; k++)
+        {
+            const double total = totals[k] + step.biases[first + k];
+            outputs[k] = step.func ? step.func->calc(total) : total;
+        }
+    }
+
+    //! Calculates the first @p stepsN steps from @p inputs, which is only read. The
+    //! outputs of each step are written alternately to @p current and @p next, both
+    //! of m_MaxWidth values; @p scratch has m_ScratchSize values.
+    //! @returns Outputs of the last step calculated; @p inputs if @p stepsN is 0.
+    const double* calcSteps(const double* inputs, double* current, double* next, double* scratch,
+        size_t stepsN) const
+    {
+        const double* values = inputs;
+
+        for (size_t s = 0; s < stepsN; s++)
+        {
+            double* outputs = values == current ? next : current;
+            calcOutputs(m_Steps[s], values, outputs, scratch);
+
+            if (m_Steps[s].softmax)
+            {
+                applySoftmax(outputs, m_Steps[s].outputsN);
+            }
+
+            values = outputs;
+        }
+
+        return values;
+    }
+
+    //! Same as @ref calcSteps() for all the steps of @p samplesN samples. The outputs of
+    //! sample b are at b * m_MaxWidth in @p current and @p next, both of
+    //! samplesN * m_MaxWidth values.
+    //! @returns Outputs of the last step; nullptr if there is no step.
+    const double* calcStepsBatch(const double* const* inputs, size_t samplesN, double* current,
+        double* next, double* scratch) const
+    {
+        const double* values = nullptr;
+
+        for (const Step& step : m_Steps)
+        {
+            double* outputs = values == current ? next : current;
+
+            if (step.image)
+            {
+                // Sample by sample: the weights of an image layer are few
+                for (size_t b = 0; b < samplesN; b++)
+                {
+                    calcOutputs(step, values ? values + b * m_MaxWidth : inputs[b], outputs + b * m_MaxWidth, scratch);
+                }
+            }
+            else
+            {
+                for (size_t first = 0; first < step.outputsN; first += kPanel)
+                {
+                    for (size_t b = 0; b < samplesN; b++)
+                    {
+                        const double* sampleInputs = values ? values + b * m_MaxWidth : inputs[b];
+                        calcPanel(step, first, sampleInputs, outputs + b * m_MaxWidth + first);
+                    }
+                }
+            }
+
+            if (step.softmax)
+            {
+                for (size_t b = 0; b < samplesN; b++)
+                {
+                    applySoftmax(outputs + b * m_MaxWidth, step.outputsN);
+                }
+            }
+
+            values = outputs;
+        }
+
+        return values;
+    }
+
+    //! See @ref probableClass(const std::vector<double>&) const.
+    size_t calcProbableClass(const double* inputs, double* current, double* next, double* scratch) const
+    {
+        if (m_Steps.empty())
+        {
+            return 0;
+        }
+
+        const double* hidden = calcSteps(inputs, current, next, scratch, m_Steps.size() - 1);
+
+        // The best output of the last layer is searched panel by panel, while
+        // the outputs are still in cache, and the softmax is skipped.
+        const Step& last = m_Steps.back();
+        double outputs[kPanel];
+        size_t best = 0;
+        double bestOutput = 0.0;
+
+        for (size_t first = 0; first < last.outputsN; first += kPanel)
+        {
+            calcPanel(last, first, hidden, outputs);
+
+            for (size_t n = first; n < std::min(first + kPanel, last.outputsN); n++)
+            {
+                if (n == 0 || bestOutput < outputs[n - first])
+                {
+                    best = n;
+                    bestOutput = outputs[n - first];
+                }
+            }
+        }
+
+        return best;
+    }
+
+    static void calcOutputs(const Step& step, const double* inputs, double* outputs, double* scratch)
+    {
+        if (step.image)
+        {
+            step.image->calcOutputs(inputs, outputs, scratch);
+            return;
+        }
+
+        for (size_t first = 0; first < step.outputsN; first += kPanel)
+        {
+            calcPanel(step, first, inputs, outputs + first);
+        }
+    }
+
+    //! Same calculation as OutputClassificationLayer::propagateForward().
+    static void applySoftmax(double* outputs, size_t outputsN)
+    {
+        double sumExp = 0.0;
+
+        for (size_t n = 0; n < outputsN; n++)
+        {
+            sumExp += std::exp(outputs[n]);
+        }
+
+        for (size_t n = 0; n < outputsN; n++)
+        {
+            outputs[n] = std::exp(outputs[n]) / sumExp;
+        }
+    }
+};
+
+}
+
+#endif // YANNL_INFERENCE_PLAN_H
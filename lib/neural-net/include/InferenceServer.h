@@ -0,0 +1,226 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_INFERENCE_SERVER_H
+#define YANNL_INFERENCE_SERVER_H
+
+#include "NeuralNetwork.h"
+#include <atomic>               // std::atomic
+#include <chrono>               // std::chrono
+#include <condition_variable>   // std::condition_variable
+#include <deque>                // std::deque
+#include <future>               // std::future & std::promise
+#include <mutex>                // std::mutex
+#include <thread>               // std::thread
+
+namespace YANNL
+{
+
+//! @brief In-process serving of a compiled network. Any thread can submit a sample with
+//! @ref predict(); the requests are coalesced into micro-batches by a worker thread,
+//! which calculates each batch with one pass over the weights and completes the future
+//! of each request. A batch is calculated as soon as it has @p maxBatchSize requests, or
+//! when its oldest request has waited @p maxDelay: the delay bounds the latency added
+//! to wait for other requests when the load is low.
+class InferenceServer
+{
+public:
+    //! Starts the worker thread.
+    //! @param plan Plan of the network served.
+    //! @param maxBatchSize Maximum number of requests per batch. 32 by default.
+    //! @param maxDelay Maximum time a request waits for the batch to fill up. 200 us by default.
+    //! @throws std::domain_error If @p plan is null or @p maxBatchSize is 0.
+    explicit InferenceServer(std::shared_ptr<const InferencePlan> plan, size_t maxBatchSize = 32,
+        std::chrono::microseconds maxDelay = std::chrono::microseconds(200)) :
+        m_Plan(std::move(plan)), m_MaxBatchSize(maxBatchSize), m_MaxDelay(maxDelay)
+    {
+        if (!m_Plan || m_MaxBatchSize == 0)
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Inference server] Plan cannot be null and the batch size must be positive.").str()
+            );
+        }
+
+        m_Thread = std::thread(&InferenceServer::run, this);
+    }
+
+    //! Serves the network saved in @p filepath with NeuralNetwork::saveToFile().
+    //! @throws std::ifstream::failure If the file cannot be read.
+    explicit InferenceServer(const std::string& filepath, size_t maxBatchSize = 32,
+        std::chrono::microseconds maxDelay = std::chrono::microseconds(200)) :
+        InferenceServer(std::make_shared<InferencePlan>(NeuralNetwork::loadFromFile(filepath).compile()),
+            maxBatchSize, maxDelay)
+    {
+
+    }
+
+    //! Calculates the pending requests and stops the worker thread.
+    ~InferenceServer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stop = true;
+        }
+
+        m_Cv.notify_one();
+        m_Thread.join();
+    }
+
+    // Owns a thread: neither copyable nor movable
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    //! Submits a sample. Thread-safe.
+    //! @returns Future of the same outputs as InferencePlan::predict(). For a classifier,
+    //!   the most probable class is the index of the highest output.
+    //! @throws std::domain_error If the size of @p inputs is not the input size.
+    std::future<std::vector<double>> predict(std::vector<double> inputs)
+    {
+        if (inputs.size() != m_Plan->inputSize())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Inference server/Predict] Input size is inconsistent: expected "
+                << m_Plan->inputSize() << " provided " << inputs.size() << ".").str()
+            );
+        }
+
+        Request request;
+        request.inputs = std::move(inputs);
+        request.arrival = std::chrono::steady_clock::now();
+        std::future<std::vector<double>> outputs = request.outputs.get_future();
+        size_t pendingN = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Queue.push_back(std::move(request));
+            pendingN = m_Queue.size();
+        }
+
+        // The worker only needs to wake up for the first request of a batch and when
+        // the batch is full.
+        if (pendingN == 1 || pendingN == m_MaxBatchSize)
+        {
+            m_Cv.notify_one();
+        }
+
+        return outputs;
+    }
+
+    const InferencePlan& plan() const
+    {
+        return *m_Plan;
+    }
+
+    //! @returns Number of batches calculated so far.
+    size_t batchesCount() const
+    {
+        return m_BatchesN.load(std::memory_order_relaxed);
+    }
+
+    //! @returns Number of requests completed so far.
+    size_t requestsCount() const
+    {
+        return m_RequestsN.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Request
+    {
+        std::vector<double> inputs;
+        std::promise<std::vector<double>> outputs;
+        std::chrono::steady_clock::time_point arrival;
+    };
+
+    const std::shared_ptr<const InferencePlan> m_Plan;
+    const size_t m_MaxBatchSize;
+    const std::chrono::microseconds m_MaxDelay;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Cv;
+    std::deque<Request> m_Queue;
+    bool m_Stop = false;
+    std::thread m_Thread;
+
+    std::atomic<size_t> m_BatchesN{ 0 };
+    std::atomic<size_t> m_RequestsN{ 0 };
+
+    void run()
+    {
+        // Buffers of the largest batch, allocated once
+        std::vector<Request> batch;
+        std::vector<const double*> inputs;
+        std::vector<double> current(m_MaxBatchSize * m_Plan->m_MaxWidth), next(m_MaxBatchSize * m_Plan->m_MaxWidth);
+        std::vector<double> scratch(m_Plan->m_ScratchSize);
+        batch.reserve(m_MaxBatchSize);
+        inputs.reserve(m_MaxBatchSize);
+
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        while (true)
+        {
+            m_Cv.wait(lock, [this]() { return m_Stop || !m_Queue.empty(); });
+
+            if (m_Queue.empty())
+            {
+                return;
+            }
+
+            m_Cv.wait_until(lock, m_Queue.front().arrival + m_MaxDelay,
+                [this]() { return m_Stop || m_Queue.size() >= m_MaxBatchSize; });
+
+            while (!m_Queue.empty() && batch.size() < m_MaxBatchSize)
+            {
+                batch.push_back(std::move(m_Queue.front()));
+                m_Queue.pop_front();
+            }
+
+            lock.unlock();
+            calcBatch(batch, inputs, current.data(), next.data(), scratch.data());
+            batch.clear();
+            lock.lock();
+        }
+    }
+
+    void calcBatch(std::vector<Request>& batch, std::vector<const double*>& inputs, double* current,
+        double* next, double* scratch)
+    {
+        inputs.clear();
+
+        for (const Request& request : batch)
+        {
+            inputs.push_back(request.inputs.data());
+        }
+
+        // Counted before the futures are ready so that the clients see the counts
+        m_BatchesN.fetch_add(1, std::memory_order_relaxed);
+        m_RequestsN.fetch_add(batch.size(), std::memory_order_relaxed);
+
+        try
+        {
+            const double* outputs = m_Plan->calcStepsBatch(inputs.data(), inputs.size(), current, next, scratch);
+            const size_t outputsN = m_Plan->outputSize();
+
+            for (size_t b = 0; b < batch.size(); b++)
+            {
+                const double* sampleOutputs = outputs ? outputs + b * m_Plan->m_MaxWidth : inputs[b];
+                batch[b].outputs.set_value(std::vector<double>(sampleOutputs, sampleOutputs + outputsN));
+            }
+        }
+        catch (...)
+        {
+            for (Request& request : batch)
+            {
+                try
+                {
+                    request.outputs.set_exception(std::current_exception());
+                }
+                catch (std::future_error&) {} // Value already set
+            }
+        }
+    }
+};
+
+}
+
+#endif // YANNL_INFERENCE_SERVER_H
@@ -0,0 +1,82 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_INFERENCE_SESSION_H
+#define YANNL_INFERENCE_SESSION_H
+
+#include "InferencePlan.h"
+#include <memory>   // std::shared_ptr
+#include <vector>   // std::vector
+
+namespace YANNL
+{
+
+//! @brief Single-sample inference with buffers allocated once, when the session is
+//! created, and sized from the topology of the plan. A call only reads the inputs
+//! through a pointer and writes into the buffers of the session: no allocation, no
+//! copy of the inputs and no size check. Outputs are the same as those of the plan.
+//! A session is not thread-safe; threads share the plan and use one session each.
+class InferenceSession
+{
+public:
+    //! @throws std::domain_error If @p plan is null.
+    explicit InferenceSession(std::shared_ptr<const InferencePlan> plan) :
+        m_Plan(checkPlan(std::move(plan))), m_Current(m_Plan->m_MaxWidth), m_Next(m_Plan->m_MaxWidth),
+        m_Scratch(m_Plan->m_ScratchSize)
+    {
+
+    }
+
+    // No need to apply the rule of five as the class contains no raw pointers
+
+    const InferencePlan& plan() const
+    {
+        return *m_Plan;
+    }
+
+    size_t inputSize() const
+    {
+        return m_Plan->inputSize();
+    }
+
+    size_t outputSize() const
+    {
+        return m_Plan->outputSize();
+    }
+
+    //! @param inputs inputSize() values.
+    //! @returns outputSize() values, same as InferencePlan::predict(). They are stored in
+    //!   the session and overwritten by the next call; @p inputs if the plan has no step.
+    const double* predict(const double* inputs)
+    {
+        return m_Plan->calcSteps(inputs, m_Current.data(), m_Next.data(), m_Scratch.data(), m_Plan->m_Steps.size());
+    }
+
+    //! @param inputs inputSize() values.
+    //! @returns Same class as InferencePlan::probableClass().
+    size_t probableClass(const double* inputs)
+    {
+        return m_Plan->calcProbableClass(inputs, m_Current.data(), m_Next.data(), m_Scratch.data());
+    }
+
+private:
+    std::shared_ptr<const InferencePlan> m_Plan;
+    std::vector<double> m_Current;
+    std::vector<double> m_Next;
+    std::vector<double> m_Scratch;
+
+    static std::shared_ptr<const InferencePlan> checkPlan(std::shared_ptr<const InferencePlan> plan)
+    {
+        if (!plan)
+        {
+            throw std::domain_error("[Inference session] Plan is null.");
+        }
+
+        return plan;
+    }
+};
+
+}
+
+#endif // YANNL_INFERENCE_SESSION_H
@@ -0,0 +1,177 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_LAYER_PROFILER_H
+#define YANNL_LAYER_PROFILER_H
+
+#include "NeuronLayer.h"
+#include <chrono>   // std::chrono
+#include <iomanip>  // std::setw
+#include <iostream> // std::ostream
+#include <vector>   // std::vector
+
+// Define YANNL_NO_LAYER_PROFILING to compile the per-layer hooks of NeuralNetwork out
+// entirely: a LayerProfiler can still be attached but records nothing.
+
+namespace YANNL
+{
+
+//! Time and estimated work of one layer, for the forward, backward and update phases.
+//! The arrays are indexed by TrainingPhase; the data phase is not used.
+struct LayerProfile
+{
+    size_t layerN = 0;
+    LayerType type = LayerType::Hidden;
+    size_t size = 0;
+    size_t calls[4] = { 0, 0, 0, 0 };
+    double seconds[4] = { 0.0, 0.0, 0.0, 0.0 };
+    double flops[4] = { 0.0, 0.0, 0.0, 0.0 };
+    double bytes[4] = { 0.0, 0.0, 0.0, 0.0 };
+
+    double totalSeconds() const
+    {
+        return seconds[1] + seconds[2] + seconds[3];
+    }
+};
+
+//! @brief Accumulates the time, operations and bytes of each layer of a network, to find
+//! the layer worth optimizing. Attach it with @ref NeuralNetwork::setLayerProfiler or
+//! @ref MLP::setLayerProfiler; nothing is measured when no profiler is attached.
+//! Operations and bytes are estimates, see NeuronLayer::cost().
+class LayerProfiler
+{
+public:
+    void record(size_t layerN, const NeuronLayer& layer, TrainingPhase phase, double seconds,
+        const LayerCost& cost)
+    {
+        if (layerN >= m_Layers.size())
+        {
+            m_Layers.resize(layerN + 1);
+        }
+
+        LayerProfile& profile = m_Layers[layerN];
+        const size_t phaseN = static_cast<size_t>(phase);
+        profile.layerN = layerN;
+        profile.type = layer.type();
+        profile.size = layer.size();
+        profile.calls[phaseN] += 1;
+        profile.seconds[phaseN] += seconds;
+        profile.flops[phaseN] += cost.flops;
+        profile.bytes[phaseN] += cost.bytes;
+    }
+
+    //! @returns Profile of each layer, by index of layer.
+    const std::vector<LayerProfile>& layers() const
+    {
+        return m_Layers;
+    }
+
+    void reset()
+    {
+        m_Layers.clear();
+    }
+
+    //! Prints for each layer and phase the number of calls, the time, its share of the
+    //! total time and the rates of operations and bytes.
+    void inspect(std::ostream& os) const
+    {
+        static const char* const phases[4] = { "Data", "Forward", "Backward", "Update" };
+        double total = 0.0;
+
+        for (const LayerProfile& profile : m_Layers)
+        {
+            total += profile.totalSeconds();
+        }
+
+        os << "------" << "\n";
+
+        for (const LayerProfile& profile : m_Layers)
+        {
+            os << "* Layer " << (profile.layerN + 1) << " " << layerTypeName(profile.type)
+                << " of " << profile.size << " neurons: "
+                << percent(profile.totalSeconds(), total) << "% of the time\n";
+
+            for (size_t phaseN = 1; phaseN < 4; phaseN++)
+            {
+                const double seconds = profile.seconds[phaseN];
+
+                os << "  " << std::left << std::setw(9) << phases[phaseN] << std::right
+                    << " calls: " << profile.calls[phaseN]
+                    << " seconds: " << seconds
+                    << " share: " << percent(seconds, total) << "%"
+                    << " GFLOP/s: " << (seconds > 0.0 ? profile.flops[phaseN] / seconds / 1e9 : 0.0)
+                    << " GB/s: " << (seconds > 0.0 ? profile.bytes[phaseN] / seconds / 1e9 : 0.0) << "\n";
+            }
+
+            os << "------" << "\n";
+        }
+    }
+
+private:
+    std::vector<LayerProfile> m_Layers;
+
+    static double percent(double part, double total)
+    {
+        return total > 0.0 ? 100.0 * part / total : 0.0;
+    }
+};
+
+#ifndef YANNL_NO_LAYER_PROFILING
+
+//! Measures one phase of one layer and records it to the profiler. Does not read the
+//! clock nor estimate the cost if the profiler is null.
+class LayerTimer
+{
+public:
+    LayerTimer(LayerProfiler* profiler, size_t layerN, const NeuronLayer& layer, TrainingPhase phase,
+        size_t summedN = 0) :
+        m_Profiler(profiler), m_LayerN(layerN), m_Layer(layer), m_Phase(phase), m_SummedN(summedN)
+    {
+        if (m_Profiler != nullptr)
+        {
+            m_Start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~LayerTimer()
+    {
+        if (m_Profiler != nullptr)
+        {
+            m_Profiler->record(m_LayerN, m_Layer, m_Phase, std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - m_Start).count(), m_Layer.cost(m_Phase, m_SummedN));
+        }
+    }
+
+    LayerTimer(const LayerTimer&) = delete;
+    LayerTimer& operator=(const LayerTimer&) = delete;
+
+private:
+    LayerProfiler* const m_Profiler;
+    const size_t m_LayerN;
+    const NeuronLayer& m_Layer;
+    const TrainingPhase m_Phase;
+    const size_t m_SummedN;
+    std::chrono::steady_clock::time_point m_Start;
+};
+
+#else
+
+//! Compiled out with YANNL_NO_LAYER_PROFILING.
+class LayerTimer
+{
+public:
+    LayerTimer(LayerProfiler*, size_t, const NeuronLayer&, TrainingPhase, size_t = 0)
+    {
+
+    }
+
+    LayerTimer(const LayerTimer&) = delete;
+    LayerTimer& operator=(const LayerTimer&) = delete;
+};
+
+#endif // YANNL_NO_LAYER_PROFILING
+
+}
+
+#endif // YANNL_LAYER_PROFILER_H
@@ -0,0 +1,412 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_LEARNING_RATE_SCHEDULER_H
+#define YANNL_LEARNING_RATE_SCHEDULER_H
+
+#include <algorithm> // std::min & std::max
+#include <string>    // std::string
+#include <cmath>     // std::pow & std::cos
+#include <memory>    // std::shared_ptr
+#include <deque>     // std::deque
+#include <vector>    // std::vector
+#include <sstream>   // std::ostringstream
+#include <stdexcept> // std::domain_error
+
+namespace YANNL
+{
+
+enum class LearningRate
+{
+    Constant = 0,
+    InvScaling,
+    Adaptive
+};
+
+//! @brief Computes the learning rate during the training. The trainer calls
+//! @ref start() once, then @ref batchEnd() after each weight update if
+//! @ref perBatch() is true, and @ref epochEnd() after each epoch. Each call
+//! returns the learning rate to use from then on.
+class LearningRateScheduler
+{
+public:
+    virtual ~LearningRateScheduler() = default;
+
+    //! Prepares the schedule for a new training.
+    //! @param initLearningRate Initial learning rate (learning_rate_init).
+    //! @param epochsN Maximum number of epochs.
+    //! @param batchesN Number of batches (weight updates) per epoch.
+    //! @returns Learning rate of the first batch.
+    virtual double start(double initLearningRate, size_t epochsN, size_t batchesN)
+    {
+        m_InitLearningRate = initLearningRate;
+        m_EpochsN = epochsN;
+        m_BatchesN = batchesN;
+
+        return initLearningRate;
+    }
+
+    //! @returns Whether the learning rate changes after each batch and not only
+    //!   after each epoch.
+    virtual bool perBatch() const
+    {
+        return false;
+    }
+
+    //! @param step Index of the batch which just ended, counted from 0 since start.
+    //! @param learningRate Current learning rate.
+    //! @returns Learning rate of the next batch.
+    virtual double batchEnd(size_t step, double learningRate)
+    {
+        return learningRate;
+    }
+
+    //! @param epoch Index of the epoch which just ended, counted from 0.
+    //! @param loss Training loss of the epoch.
+    //! @param learningRate Current learning rate.
+    //! @returns Learning rate of the next epoch.
+    virtual double epochEnd(size_t epoch, double loss, double learningRate)
+    {
+        return learningRate;
+    }
+
+    virtual std::string name() const = 0;
+
+    //! Appends the values changed by @ref start() and by the training to @p state, e.g.
+    //! for a checkpoint. See TrainingState::schedulerState.
+    virtual void copyState(std::vector<double>& state) const
+    {
+        state.push_back(m_InitLearningRate);
+        state.push_back(static_cast<double>(m_EpochsN));
+        state.push_back(static_cast<double>(m_BatchesN));
+    }
+
+    //! Restores the values appended by @ref copyState() on a scheduler of the same type.
+    //! @returns Offset of the values following those of the scheduler in @p state.
+    //! @throws std::domain_error If @p state is too short.
+    virtual size_t restoreState(const std::vector<double>& state, size_t offset)
+    {
+        checkState(state, offset, 3);
+        m_InitLearningRate = state[offset];
+        m_EpochsN = static_cast<size_t>(state[offset + 1]);
+        m_BatchesN = static_cast<size_t>(state[offset + 2]);
+
+        return offset + 3;
+    }
+
+protected:
+    double m_InitLearningRate = 0.0;
+    size_t m_EpochsN = 0;
+    size_t m_BatchesN = 0;
+
+    static void checkState(const std::vector<double>& state, size_t offset, size_t valuesN)
+    {
+        if (offset + valuesN > state.size())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Learning rate scheduler] State is too short: expected at least "
+                << offset + valuesN << " values provided " << state.size() << ".").str()
+            );
+        }
+    }
+};
+
+class ConstantScheduler : public LearningRateScheduler
+{
+public:
+    std::string name() const override { return "Constant"; }
+};
+
+//! Gradually decreases the learning rate after each epoch t:
+//! learning_rate_init / pow(t + 1, power_t).
+class InvScalingScheduler : public LearningRateScheduler
+{
+public:
+    explicit InvScalingScheduler(double powerT) :
+        m_PowerT(powerT)
+    {
+
+    }
+
+    double epochEnd(size_t epoch, double loss, double learningRate) override
+    {
+        return m_InitLearningRate / std::pow(epoch + 1, m_PowerT);
+    }
+
+    std::string name() const override { return "InvScaling"; }
+
+private:
+    const double m_PowerT;
+};
+
+//! Each time two consecutive epochs fail to decrease the training loss by at
+//! least tol, the current learning rate is divided by 5.
+class AdaptiveScheduler : public LearningRateScheduler
+{
+public:
+    explicit AdaptiveScheduler(double tol) :
+        m_Tolerance(tol)
+    {
+
+    }
+
+    double start(double initLearningRate, size_t epochsN, size_t batchesN) override
+    {
+        m_Losses.clear();
+        return LearningRateScheduler::start(initLearningRate, epochsN, batchesN);
+    }
+
+    double epochEnd(size_t epoch, double loss, double learningRate) override
+    {
+        // Current + 2 previous losses are enough to take the decision.
+        if (m_Losses.size() == 3)
+        {
+            m_Losses.pop_front();
+        }
+
+        m_Losses.push_back(loss);
+
+        if (m_Losses.size() == 3
+            && std::fabs(m_Losses[1] - m_Losses[2]) < m_Tolerance
+            && std::fabs(m_Losses[0] - m_Losses[1]) < m_Tolerance)
+        {
+            return learningRate / 5;
+        }
+
+        return learningRate;
+    }
+
+    std::string name() const override { return "Adaptive"; }
+
+    //! Appends the number of losses kept then the losses.
+    void copyState(std::vector<double>& state) const override
+    {
+        LearningRateScheduler::copyState(state);
+        state.push_back(static_cast<double>(m_Losses.size()));
+        state.insert(state.end(), m_Losses.cbegin(), m_Losses.cend());
+    }
+
+    size_t restoreState(const std::vector<double>& state, size_t offset) override
+    {
+        offset = LearningRateScheduler::restoreState(state, offset);
+        checkState(state, offset, 1);
+        const size_t lossesN = static_cast<size_t>(state[offset++]);
+        checkState(state, offset, lossesN);
+        m_Losses.assign(state.cbegin() + offset, state.cbegin() + offset + lossesN);
+
+        return offset + lossesN;
+    }
+
+private:
+    const double m_Tolerance;
+    std::deque<double> m_Losses;
+};
+
+//! Multiplies the learning rate by gamma every stepEpochs epochs.
+class StepDecayScheduler : public LearningRateScheduler
+{
+public:
+    explicit StepDecayScheduler(size_t stepEpochs, double gamma = 0.1) :
+        m_StepEpochs(stepEpochs > 0 ? stepEpochs : 1), m_Gamma(gamma)
+    {
+
+    }
+
+    double epochEnd(size_t epoch, double loss, double learningRate) override
+    {
+        return m_InitLearningRate * std::pow(m_Gamma, static_cast<double>((epoch + 1) / m_StepEpochs));
+    }
+
+    std::string name() const override { return "StepDecay"; }
+
+private:
+    const size_t m_StepEpochs;
+    const double m_Gamma;
+};
+
+//! Anneals the learning rate from learning_rate_init to minLearningRate along a
+//! half cosine over all the batches of the training.
+class CosineAnnealingScheduler : public LearningRateScheduler
+{
+public:
+    explicit CosineAnnealingScheduler(double minLearningRate = 0.0) :
+        m_MinLearningRate(minLearningRate)
+    {
+
+    }
+
+    bool perBatch() const override
+    {
+        return true;
+    }
+
+    double batchEnd(size_t step, double learningRate) override
+    {
+        const double totalSteps = static_cast<double>(m_EpochsN * m_BatchesN);
+        const double progress = totalSteps > 0 ? std::min(1.0, (step + 1) / totalSteps) : 1.0;
+
+        return m_MinLearningRate + (m_InitLearningRate - m_MinLearningRate)
+            * (1.0 + std::cos(kPi * progress)) / 2.0;
+    }
+
+    std::string name() const override { return "CosineAnnealing"; }
+
+private:
+    static constexpr double kPi = 3.14159265358979323846;
+    const double m_MinLearningRate;
+};
+
+//! Increases the learning rate linearly from 0 to learning_rate_init over the
+//! first warmupSteps batches, then follows the schedule @p after.
+class WarmupScheduler : public LearningRateScheduler
+{
+public:
+    explicit WarmupScheduler(size_t warmupSteps,
+        const std::shared_ptr<LearningRateScheduler>& after = std::make_shared<ConstantScheduler>()) :
+        m_WarmupSteps(warmupSteps), m_After(after)
+    {
+
+    }
+
+    double start(double initLearningRate, size_t epochsN, size_t batchesN) override
+    {
+        LearningRateScheduler::start(initLearningRate, epochsN, batchesN);
+        const double afterLearningRate = m_After->start(initLearningRate, epochsN, batchesN);
+
+        return m_WarmupSteps > 0 ? initLearningRate / m_WarmupSteps : afterLearningRate;
+    }
+
+    bool perBatch() const override
+    {
+        return true;
+    }
+
+    double batchEnd(size_t step, double learningRate) override
+    {
+        if (step + 1 < m_WarmupSteps)
+        {
+            return m_InitLearningRate * (step + 2) / m_WarmupSteps;
+        }
+        else if (step + 1 == m_WarmupSteps)
+        {
+            return m_InitLearningRate;
+        }
+
+        return m_After->perBatch() ? m_After->batchEnd(step - m_WarmupSteps, learningRate) : learningRate;
+    }
+
+    double epochEnd(size_t epoch, double loss, double learningRate) override
+    {
+        if ((epoch + 1) * m_BatchesN <= m_WarmupSteps)
+        {
+            return learningRate;
+        }
+
+        return m_After->epochEnd(epoch, loss, learningRate);
+    }
+
+    std::string name() const override { return "Warmup+" + m_After->name(); }
+
+    //! Appends the state of the warmup then that of the schedule followed after it.
+    void copyState(std::vector<double>& state) const override
+    {
+        LearningRateScheduler::copyState(state);
+        m_After->copyState(state);
+    }
+
+    size_t restoreState(const std::vector<double>& state, size_t offset) override
+    {
+        return m_After->restoreState(state, LearningRateScheduler::restoreState(state, offset));
+    }
+
+private:
+    const size_t m_WarmupSteps;
+    const std::shared_ptr<LearningRateScheduler> m_After;
+};
+
+//! One-cycle policy: the learning rate rises from maxLearningRate / divFactor to
+//! maxLearningRate over the first pctStart of the batches, then decreases to
+//! maxLearningRate / (divFactor * finalDivFactor), both along a half cosine.
+//! learning_rate_init is ignored.
+class OneCycleScheduler : public LearningRateScheduler
+{
+public:
+    explicit OneCycleScheduler(double maxLearningRate, double pctStart = 0.3,
+        double divFactor = 25.0, double finalDivFactor = 1.0E4) :
+        m_MaxLearningRate(maxLearningRate), m_PctStart(pctStart),
+        m_DivFactor(divFactor), m_FinalDivFactor(finalDivFactor)
+    {
+
+    }
+
+    double start(double initLearningRate, size_t epochsN, size_t batchesN) override
+    {
+        LearningRateScheduler::start(initLearningRate, epochsN, batchesN);
+        return m_MaxLearningRate / m_DivFactor;
+    }
+
+    bool perBatch() const override
+    {
+        return true;
+    }
+
+    double batchEnd(size_t step, double learningRate) override
+    {
+        const double totalSteps = static_cast<double>(m_EpochsN * m_BatchesN);
+        const double upSteps = std::max(1.0, m_PctStart * totalSteps);
+        const double downSteps = std::max(1.0, totalSteps - upSteps);
+        const double initLearningRate = m_MaxLearningRate / m_DivFactor;
+        const double minLearningRate = initLearningRate / m_FinalDivFactor;
+        const double nextStep = static_cast<double>(step + 1);
+
+        if (nextStep < upSteps)
+        {
+            return anneal(initLearningRate, m_MaxLearningRate, nextStep / upSteps);
+        }
+
+        return anneal(m_MaxLearningRate, minLearningRate, std::min(1.0, (nextStep - upSteps) / downSteps));
+    }
+
+    std::string name() const override { return "OneCycle"; }
+
+private:
+    static constexpr double kPi = 3.14159265358979323846;
+    const double m_MaxLearningRate;
+    const double m_PctStart;
+    const double m_DivFactor;
+    const double m_FinalDivFactor;
+
+    static double anneal(double from, double to, double progress)
+    {
+        return to + (from - to) * (1.0 + std::cos(kPi * progress)) / 2.0;
+    }
+};
+
+class LearningRateSchedulerFactory
+{
+public:
+    //! Builds the scheduler of the scikit-learn like learning_rate parameter.
+    static std::shared_ptr<LearningRateScheduler> build(LearningRate learningRate,
+        double powerT, double tol)
+    {
+        switch (learningRate)
+        {
+        case LearningRate::InvScaling:
+            return std::make_shared<InvScalingScheduler>(powerT);
+            break;
+
+        case LearningRate::Adaptive:
+            return std::make_shared<AdaptiveScheduler>(tol);
+            break;
+
+        default:
+            return std::make_shared<ConstantScheduler>();
+            break;
+        }
+    }
+};
+
+}
+
+#endif // YANNL_LEARNING_RATE_SCHEDULER_H
@@ -6,7 +6,14 @@
 #define YANNL_MLP_H
 
 #include "NeuralNetwork.h"
+#include "Autotuner.h"
+#include "Checkpoint.h"
+#include "LearningRateScheduler.h"
+#include "SampleStream.h"
 #include <chrono>   // std::chrono
+#include <deque>    // std::deque
+#include <numeric>  // std::iota
+#include <limits>   // std::numeric_limits
 
 namespace YANNL
 {
@@ -16,13 +23,6 @@ enum class Solvers
     SGD = 0
 };
 
-enum class LearningRate
-{
-    Constant = 0,
-    InvScaling,
-    Adaptive
-};
-
 enum class MLPType
 {
     Regressor = 0,
@@ -42,211 +42,156 @@ public:
 
         if (!inputs.empty())
         {
-            log("Checks that output size is consistent with input size.");
+            fitRows(rowsOf(inputs, expectedOuputs), inputs[0].size(), expectedOuputs);
+        }
+        else
+        {
+            log("Input is empty. No training possible.");
+        }
+    }
+
+    //! Same as @ref fit(const std::vector<std::vector<double>>&, const std::vector<T>&) with
+    //! the inputs stored row by row in one contiguous matrix, e.g. CsvDataset::features.
+    //! @param inputs Matrix of expectedOuputs.size() rows of @p inputSize values.
+    //! @throws std::domain_error If the size of @p inputs is not expectedOuputs.size() * @p inputSize.
+    void fit(const std::vector<double>& inputs, size_t inputSize, const std::vector<T>& expectedOuputs)
+    {
+        log("Checks whether input is empty.");
 
-            // Check that output size is consistent with input size
-            if (inputs.size() != expectedOuputs.size())
+        if (!expectedOuputs.empty())
+        {
+            if (inputSize == 0 || inputs.size() != expectedOuputs.size() * inputSize)
             {
                 throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
                     << "Input and output size are not consistent: input "
-                    << inputs.size() << " output " << expectedOuputs.size() << ".").str()
+                    << inputs.size() << " values of rows of " << inputSize << " output "
+                    << expectedOuputs.size() << ".").str()
                 );
             }
 
-            log("Checks that all inputs are of same size.");
-
-            // Check that all inputs are of the same
-
-            size_t inputSize = inputs[0].size();
-
-            for (size_t i = 1; i < inputs.size(); i++)
-            {
-                if (inputs[i].size() != inputSize)
-                {
-                    throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
-                        << "All inputs do not have the same size: first "
-                        << inputSize << " " << i << "th " << inputs[i].size() << ".").str()
-                    );
-                }
-            }
-
-            log("Output and input are of same size. All inputs are of same size.");
-
-            log("Builds the neural network of input size " + std::to_string(inputSize) + ".");
-
-            // Build neural network
-
-            m_Net = std::make_unique<NeuralNetwork>(inputSize, m_LearningRate, m_Momentum, m_UseSeed, m_Seed);
-
-            std::for_each(m_HiddenLayerSizes.cbegin(), m_HiddenLayerSizes.cend(),
-                [&](size_t layerSize)
-                {
-                    log("Adds hidden layer of size " + std::to_string(layerSize) + ".");
-                    m_Net->addHiddenLayer(layerSize, m_AFunc);
-                });
-
-            t_Labels max = 0; // max label if MLPClassifier
-            t_Labels min = 0; // min label if MLPClassifier
-
-            if (type() == MLPType::Classifier)
-            {
-                max = (t_Labels) *std::max_element(expectedOuputs.begin(), expectedOuputs.end());
-                min = (t_Labels) *std::min_element(expectedOuputs.begin(), expectedOuputs.end());
-                t_Labels size = max - min + 1; // min included to max included = max - min + 1
-
-                log("Adds output classification layer of size " + std::to_string(size)
-                    + " for range " + std::to_string(min) + "-" + std::to_string(max) + ".");
-                m_Net->addOutputClassificationLayer(size);
-            }
-            else
-            {
-                log("Adds output regression layer of size 1.");
-                m_Net->addOutputRegressionLayer(1, m_AFunc);
-            }
-
-            log("Trains the network with max " + std::to_string(m_MaxIterations) + " epochs.");
-
-            // Train neural network
-
-            auto t0 = std::chrono::high_resolution_clock::now();
-            std::vector<double> errors;
-            double error = 0.0;
-            size_t nbBatches = 1, batchSize = m_BatchSize;
+            std::vector<const double*> rows;
+            rows.reserve(expectedOuputs.size());
 
-            // If the MLP should not use the batch size it means it is an on-line stochastic
-            // gradient descent with batches of size 1.
-            if (!m_UseBatchSize)
+            for (size_t r = 0; r < expectedOuputs.size(); r++)
             {
-                batchSize = 1;
-                nbBatches = inputs.size();
+                rows.push_back(inputs.data() + r * inputSize);
             }
-            else
-            {
-                nbBatches = inputs.size() / batchSize + (inputs.size() % batchSize == 0 ? 0 : 1);
-            }
-
-            for (size_t epoch = 0; epoch < m_MaxIterations; epoch++)
-            {
-                error = 0.0;
-
-                for (size_t batch = 0; batch < nbBatches; batch++)
-                {
-                    for (size_t i = batch * batchSize; i < (batch + 1) * batchSize && i < inputs.size(); i++)
-                    {
-                        m_Net->propagateForward(inputs[i]);
 
-                        if (type() == MLPType::Classifier)
-                        {
-                            std::vector<double> expectedOutput = Utils::convertLabelToVect((t_Labels)expectedOuputs[i], min, max);
-                            error += m_Net->calcError(expectedOutput);
-                            m_Net->propagateBackward(expectedOutput);
-                        }
-                        else
-                        {
-                            error += m_Net->calcError(expectedOuputs[i]);
-                            m_Net->propagateBackward(expectedOuputs[i]);
-                        }
-                    }
-
-                    m_Net->updateWeights();
-                }
+            fitRows(rows, inputSize, expectedOuputs);
+        }
+        else
+        {
+            log("Input is empty. No training possible.");
+        }
+    }
 
-                error /= inputs.size();
+    void inspect(std::ostream& os) const
+    {
+        if (m_Net.get() != nullptr)
+        {
+            m_Net->inspect(os);
+        }
+    }
 
-                if (m_EarlyStopping || m_LearningRateType == LearningRate::Adaptive)
-                {
-                    // In case of early stopping or adaptive learning rate
-                    // we need to keep track of the last errors.
+    //! @returns Memory and operations of the network built by fit. See NeuralNetwork::footprint().
+    //! @throws std::domain_error If fit was not called.
+    NetworkFootprint footprint() const
+    {
+        if (m_Net.get() == nullptr)
+        {
+            throw std::domain_error("Use fit before footprint.");
+        }
 
-                    if (errors.size() < m_IterNoChangeN + 1)
-                    {
-                        // +1 because the (N+1)th element is used as a reference
-                        // and compared to the Nth other elements.
-                        // No decision while the list is not complete, i.e there are
-                        // not enough items to conclude that the training can stop.
-                        errors.push_back(error);
-                    }
-                    else
-                    {
-                        errors.erase(errors.begin());
-                        errors.push_back(error);
+        return m_Net->footprint();
+    }
 
-                        // Only in the case of early stopping and not in the case
-                        // of adaptive learning rate, determine whether to stop.
-                        if (m_LearningRateType != LearningRate::Adaptive)
-                        {
-                            bool earlyStop = true;
-
-                            for (size_t i = errors.size() - 1; i > 0; i--)
-                            {
-                                if (errors[i - 1] - errors[i] > m_OptimizationTolerance)
-                                {
-                                    earlyStop = false;
-                                }
-                            }
-
-                            if (earlyStop)
-                            {
-                                log("Optimization tolerance of " + std::to_string(m_OptimizationTolerance)
-                                    + " reached after " + std::to_string(epoch) + " epochs. Stopping.");
-                                break;
-                            }
-                        }
-                    }
+    virtual MLPType type() const = 0;
 
-                    // In case of adaptive learning rate and with sufficient
-                    // error history (current + 2 = 3)
-                    if (m_LearningRateType == LearningRate::Adaptive
-                        && errors.size() >= 3)
-                    {
-                        size_t i = errors.size() - 1;
+    //! Replaces the schedule of the learning rate built from the learning_rate
+    //! parameter, e.g. by a @ref WarmupScheduler or a @ref OneCycleScheduler.
+    //! Takes effect at the next call to fit.
+    void setLearningRateScheduler(const std::shared_ptr<LearningRateScheduler>& scheduler)
+    {
+        if (scheduler.get() == nullptr)
+        {
+            throw std::domain_error("Learning rate scheduler cannot be null.");
+        }
 
-                        // Each time two consecutive epochs fail to
-                        // decrease training loss by at least tol,
-                        // the current learning rate is divided by 5.
-                        if (std::fabs(errors[i - 1] - errors[i]) < m_OptimizationTolerance
-                            && std::fabs(errors[i - 2] - errors[i - 1]) < m_OptimizationTolerance)
-                        {
-                            m_EffectiveLearningRate /= 5;
-                            m_Net->updateLearningRate(m_EffectiveLearningRate);
-                        }
-                    }
-                }
+        m_Scheduler = scheduler;
+    }
 
-                if (m_LearningRateType == LearningRate::InvScaling)
-                {
-                    m_EffectiveLearningRate = m_LearningRate / std::pow(epoch + 1, m_PowerT);
-                    m_Net->updateLearningRate(m_EffectiveLearningRate);
-                }
-            }
+    //! Attaches an observer notified by fit of the time spent in each phase and of the
+    //! metrics of each epoch. Pass nullptr to detach it; nothing is measured then.
+    void setTrainingObserver(const std::shared_ptr<TrainingObserver>& observer)
+    {
+        m_Observer = observer;
+    }
 
-            log("Final error is " + std::to_string(error) + ".");
+    //! Attaches a profiler to the network built by fit, recording the time and estimated
+    //! work of each layer. Pass nullptr to detach it. See NeuralNetwork::setLayerProfiler.
+    void setLayerProfiler(const std::shared_ptr<LayerProfiler>& profiler)
+    {
+        m_Profiler = profiler;
 
-            if (m_LearningRateType == LearningRate::Adaptive)
-            {
-                log("Final effective learning rate is " + std::to_string(m_EffectiveLearningRate) + ".");
-            }
+        if (m_Net.get() != nullptr)
+        {
+            m_Net->setLayerProfiler(profiler);
+        }
+    }
 
-            auto t1 = std::chrono::high_resolution_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+    //! Sets the number of threads updating the weights of wide layers, for the next calls
+    //! to fit and partial_fit. See NeuralNetwork::setThreadCount.
+    void setThreadCount(size_t threadsN)
+    {
+        m_ThreadsN = std::max<size_t>(1, threadsN);
 
-            log("Training completed in " + std::to_string(elapsed) + " ms.");
-        }
-        else
+        if (m_Net.get() != nullptr)
         {
-            log("Input is empty. No training possible.");
+            m_Net->setThreadCount(m_ThreadsN);
         }
     }
 
-    void inspect(std::ostream& os) const
+    //! Trains by batches of @p batchSize samples from the next call to fit or partial_fit,
+    //! as if use_batch_size was true. 0 is considered as 1.
+    void setBatchSize(size_t batchSize)
     {
-        if (m_Net.get() != nullptr)
+        m_UseBatchSize = true;
+        m_BatchSize = std::max<size_t>(1, batchSize);
+    }
+
+    //! Tunes the batch size and the thread count for the network built by fit and applies
+    //! them to the next calls to fit and partial_fit. See Autotuner.
+    //! @returns Configuration applied, with the batch size recommended for predictions.
+    //! @throws std::domain_error If fit was not called.
+    TunedConfig autotune(Autotuner& tuner)
+    {
+        if (m_Net.get() == nullptr)
         {
-            m_Net->inspect(os);
+            throw std::domain_error("Use fit before autotune.");
         }
+
+        const TunedConfig config = tuner.tune(*m_Net);
+        setThreadCount(config.threadsN);
+        setBatchSize(config.batchSize);
+
+        return config;
     }
 
-    virtual MLPType type() const = 0;
+    //! Attaches a writer saving a checkpoint of the network, the counters and the learning
+    //! rate schedule after each epoch of fit and after each call to partial_fit, in the
+    //! background. Pass nullptr to detach it. The training is resumed with
+    //! restoreCheckpoint() then partial_fit.
+    void setCheckpointWriter(const std::shared_ptr<CheckpointWriter>& writer)
+    {
+        m_Checkpoints = writer;
+    }
+
+    //! @returns Number of epochs run by the last call to fit, plus one per call to
+    //!   partial_fit since.
+    size_t iterations() const
+    {
+        return m_IterationsN;
+    }
 
 protected:
     explicit MLP(
@@ -265,7 +210,8 @@ protected:
         bool verbose,
         double momentum,
         bool early_stopping,
-        size_t n_iter_no_change) :
+        size_t n_iter_no_change,
+        double validation_fraction) :
         m_HiddenLayerSizes(hidden_layer_sizes),
         m_AFunc(activation),
         m_Solver(solver),
@@ -282,12 +228,21 @@ protected:
         m_Momentum(momentum),
         m_EarlyStopping(early_stopping),
         m_IterNoChangeN(n_iter_no_change),
-        m_EffectiveLearningRate(learning_rate_init)
+        m_ValidationFraction(validation_fraction),
+        m_Scheduler(LearningRateSchedulerFactory::build(learning_rate, power_t, tol))
     {
-
+        if (validation_fraction < 0.0 || validation_fraction >= 1.0)
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "Validation fraction must be in [0, 1): provided " << validation_fraction << ".").str()
+            );
+        }
     }
 
     std::unique_ptr<NeuralNetwork> m_Net;
+    //! Inference plan of @ref m_Net compiled at the end of the training; none while
+    //! a new network is trained.
+    std::unique_ptr<InferencePlan> m_Plan;
 
     void log(const std::string& msg) const
     {
@@ -297,12 +252,310 @@ protected:
         }
     }
 
+    //! Builds and trains the network on the samples of @p samples, read block by block
+    //! with a DoubleBufferedReader so that only two blocks are in memory. Samples are used
+    //! in the order of the stream. There is no validation set: early stopping is based on
+    //! the training error.
+    void fitStream(SampleStream& samples, t_Labels min, t_Labels max)
+    {
+        const size_t trainN = samples.size();
+
+        if (trainN == 0)
+        {
+            log("Input is empty. No training possible.");
+            return;
+        }
+
+        buildNetwork(samples.inputSize(), min, max);
+
+        if (m_EarlyStopping && m_ValidationFraction > 0.0)
+        {
+            log("No validation set for a stream: early stopping is based on the training error.");
+        }
+
+        log("Trains the network with max " + std::to_string(m_MaxIterations) + " epochs.");
+
+        auto t0 = std::chrono::high_resolution_clock::now();
+        std::deque<double> errors;
+        double error = 0.0;
+
+        // Same batches as fit(): the last batch of an epoch can be smaller. Blocks are
+        // read independently of the batches.
+        const size_t batchSize = m_UseBatchSize ? std::max<size_t>(1, m_BatchSize) : 1;
+        const size_t nbBatches = trainN / batchSize + (trainN % batchSize == 0 ? 0 : 1);
+        const size_t blockSize = batchSize > kStreamBlockSize ? batchSize : kStreamBlockSize;
+
+        m_Net->updateLearningRate(m_Scheduler->start(m_LearningRate, m_MaxIterations, nbBatches));
+        const bool scheduleBatches = m_Scheduler->perBatch();
+        m_StepsN = 0;
+
+        std::unique_ptr<PhaseAccumulator> phases;
+
+        if (m_Observer.get() != nullptr)
+        {
+            phases = std::make_unique<PhaseAccumulator>(m_Observer);
+        }
+
+        TrainingObserver* timed = phases.get();
+        std::chrono::steady_clock::time_point epochStart;
+
+        m_IterationsN = 0;
+
+        for (size_t epoch = 0; epoch < m_MaxIterations; epoch++)
+        {
+            error = 0.0;
+            ++m_IterationsN;
+
+            if (timed != nullptr)
+            {
+                phases->reset();
+                epochStart = std::chrono::steady_clock::now();
+            }
+
+            samples.rewind();
+            DoubleBufferedReader reader(samples, blockSize);
+            size_t samplesN = 0, inBatchN = 0;
+
+            while (true)
+            {
+                const SampleBatch* block = nullptr;
+
+                {
+                    PhaseTimer timer(timed, TrainingPhase::Data);
+                    block = &reader.next();
+                }
+
+                if (block->samplesN == 0)
+                {
+                    break;
+                }
+
+                for (size_t n = 0; n < block->samplesN; n++)
+                {
+                    {
+                        PhaseTimer timer(timed, TrainingPhase::Forward);
+                        m_Net->propagateForward(block->inputs.data() + n * samples.inputSize());
+                    }
+
+                    if (type() == MLPType::Classifier)
+                    {
+                        std::vector<double> expectedOutput;
+
+                        {
+                            PhaseTimer timer(timed, TrainingPhase::Data);
+                            expectedOutput = Utils::convertLabelToVect((t_Labels)block->targets[n], min, max);
+                        }
+
+                        PhaseTimer timer(timed, TrainingPhase::Backward);
+                        error += m_Net->calcError(expectedOutput);
+                        m_Net->propagateBackward(expectedOutput);
+                    }
+                    else
+                    {
+                        PhaseTimer timer(timed, TrainingPhase::Backward);
+                        error += m_Net->calcError(block->targets[n]);
+                        m_Net->propagateBackward(block->targets[n]);
+                    }
+
+                    ++samplesN;
+
+                    if (++inBatchN == batchSize || samplesN == trainN)
+                    {
+                        inBatchN = 0;
+
+                        {
+                            PhaseTimer timer(timed, TrainingPhase::Update);
+                            m_Net->updateWeights();
+                        }
+
+                        if (scheduleBatches)
+                        {
+                            m_Net->updateLearningRate(m_Scheduler->batchEnd(m_StepsN, m_Net->learningRate()));
+                        }
+
+                        ++m_StepsN;
+                    }
+                }
+            }
+
+            if (samplesN != trainN)
+            {
+                throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                    << "Stream size is inconsistent: expected " << trainN
+                    << " samples read " << samplesN << ".").str()
+                );
+            }
+
+            error /= trainN;
+
+            if (timed != nullptr)
+            {
+                EpochMetrics metrics;
+                metrics.epoch = epoch;
+                metrics.samplesN = trainN;
+                metrics.batchesN = nbBatches;
+                metrics.loss = error;
+                metrics.learningRate = m_Net->learningRate();
+                metrics.dataSeconds = phases->seconds(TrainingPhase::Data);
+                metrics.forwardSeconds = phases->seconds(TrainingPhase::Forward);
+                metrics.backwardSeconds = phases->seconds(TrainingPhase::Backward);
+                metrics.updateSeconds = phases->seconds(TrainingPhase::Update);
+                metrics.totalSeconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - epochStart).count();
+                m_Observer->onEpochEnd(metrics);
+            }
+
+            if (trainingErrorStalled(errors, error, epoch))
+            {
+                break;
+            }
+
+            m_Net->updateLearningRate(m_Scheduler->epochEnd(epoch, error, m_Net->learningRate()));
+            saveCheckpoint();
+        }
+
+        endTraining(error, t0);
+    }
+
+    //! Trains the network for one epoch on the new samples only, like partial_fit of
+    //! scikit-learn, e.g. to keep learning from new events. The weights, the momentum and
+    //! the learning rate schedule carry on from the previous calls to fit or partial_fit:
+    //! the network is only built by the first call if fit has not been called, with an
+    //! output classification layer for the labels from @p min to @p max. There is no
+    //! validation set and no early stopping.
+    //! @throws std::domain_error If the sizes are inconsistent, if the input size differs
+    //!   from that of the network or if a label is not a class of the network.
+    void partialFit(const std::vector<std::vector<double>>& inputs,
+        const std::vector<T>& expectedOuputs, t_Labels min, t_Labels max)
+    {
+        if (inputs.empty())
+        {
+            log("Input is empty. No training possible.");
+            return;
+        }
+
+        const std::vector<const double*> rows = rowsOf(inputs, expectedOuputs);
+        const size_t batchSize = m_UseBatchSize ? std::max<size_t>(1, m_BatchSize) : 1;
+
+        if (m_Net.get() == nullptr)
+        {
+            buildNetwork(inputs[0].size(), min, max);
+
+            // The schedule is started once for all the calls, with the batches of the first one
+            const size_t nbBatches = rows.size() / batchSize + (rows.size() % batchSize == 0 ? 0 : 1);
+            m_Net->updateLearningRate(m_Scheduler->start(m_LearningRate, m_MaxIterations, nbBatches));
+            m_IterationsN = 0;
+            m_StepsN = 0;
+        }
+        else if (inputs[0].size() != m_Net->inputSize())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "Input size is inconsistent with the network: expected "
+                << m_Net->inputSize() << " provided " << inputs[0].size() << ".").str()
+            );
+        }
+
+        if (type() == MLPType::Classifier)
+        {
+            for (const T& label : expectedOuputs)
+            {
+                if ((t_Labels)label < m_MinLabel || (t_Labels)label > m_MaxLabel)
+                {
+                    throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                        << "Label " << (size_t)label << " is not a class of the network: "
+                        << (size_t)m_MinLabel << "-" << (size_t)m_MaxLabel << ".").str()
+                    );
+                }
+            }
+        }
+
+        log("Trains the network for one epoch on " + std::to_string(rows.size()) + " new samples.");
+
+        auto t0 = std::chrono::high_resolution_clock::now();
+
+        std::unique_ptr<PhaseAccumulator> phases;
+
+        if (m_Observer.get() != nullptr)
+        {
+            phases = std::make_unique<PhaseAccumulator>(m_Observer);
+        }
+
+        std::vector<size_t> trainIndices(rows.size());
+        std::iota(trainIndices.begin(), trainIndices.end(), 0);
+
+        const size_t epoch = m_IterationsN++;
+        const double error = trainEpoch(rows, expectedOuputs, trainIndices, batchSize, phases.get()) / rows.size();
+
+        if (phases.get() != nullptr)
+        {
+            EpochMetrics metrics;
+            metrics.epoch = epoch;
+            metrics.samplesN = rows.size();
+            metrics.batchesN = rows.size() / batchSize + (rows.size() % batchSize == 0 ? 0 : 1);
+            metrics.loss = error;
+            metrics.learningRate = m_Net->learningRate();
+            metrics.dataSeconds = phases->seconds(TrainingPhase::Data);
+            metrics.forwardSeconds = phases->seconds(TrainingPhase::Forward);
+            metrics.backwardSeconds = phases->seconds(TrainingPhase::Backward);
+            metrics.updateSeconds = phases->seconds(TrainingPhase::Update);
+            metrics.totalSeconds = std::chrono::duration<double>(
+                std::chrono::high_resolution_clock::now() - t0).count();
+            m_Observer->onEpochEnd(metrics);
+        }
+
+        m_Net->updateLearningRate(m_Scheduler->epochEnd(epoch, error, m_Net->learningRate()));
+        saveCheckpoint();
+
+        endTraining(error, t0);
+    }
+
+    //! Builds the network, with an output classification layer for the labels from @p min
+    //! to @p max, and restores the most recent checkpoint listed by the index of @p prefix:
+    //! weights, momentum, generators, learning rate schedule and counters. Each call to
+    //! partial_fit then trains exactly as the next one would have without the interruption,
+    //! which is also the next epoch of fit without early stopping.
+    //! @returns false, and no network, if there is no checkpoint.
+    //! @throws std::domain_error If the checkpoint is not valid or is not of the topology
+    //!   of the network or of the type of the learning rate scheduler.
+    bool restoreCheckpoint(const std::string& prefix, size_t inputSize, t_Labels min, t_Labels max)
+    {
+        TrainingState state;
+        buildNetwork(inputSize, min, max);
+
+        try
+        {
+            if (CheckpointWriter::restoreLatest(prefix, *m_Net, state))
+            {
+                m_Scheduler->restoreState(state.schedulerState, 0);
+                m_IterationsN = state.epoch;
+                m_StepsN = state.step;
+                m_Plan = std::make_unique<InferencePlan>(m_Net->compile());
+                log("Restored the checkpoint of epoch " + std::to_string(state.epoch) + ".");
+
+                return true;
+            }
+        }
+        catch (std::domain_error&)
+        {
+            m_Net.reset();
+            throw;
+        }
+
+        m_Net.reset();
+
+        return false;
+    }
+
 private:
+    //! Number of samples read at once by fitStream() when the batches are smaller.
+    static constexpr size_t kStreamBlockSize = 1024;
+
     const std::vector<size_t> m_HiddenLayerSizes;
     const ActivationFunctions m_AFunc;
     const Solvers m_Solver;
-    const bool m_UseBatchSize;
-    const size_t m_BatchSize;
+    bool m_UseBatchSize;
+    size_t m_BatchSize;
+    size_t m_ThreadsN = 1;
     const LearningRate m_LearningRateType;
     const double m_LearningRate;
     const double m_PowerT;
@@ -314,8 +567,464 @@ private:
     const double m_Momentum;
     const bool m_EarlyStopping;
     const size_t m_IterNoChangeN;
+    const double m_ValidationFraction;
+
+    std::shared_ptr<LearningRateScheduler> m_Scheduler;
+    std::shared_ptr<TrainingObserver> m_Observer;
+    std::shared_ptr<CheckpointWriter> m_Checkpoints;
+    std::shared_ptr<LayerProfiler> m_Profiler;
+    size_t m_IterationsN = 0;
+    //! Number of weight updates since the network was built, for the scheduler.
+    size_t m_StepsN = 0;
+    //! Range of the labels of the output classification layer.
+    t_Labels m_MinLabel = 0;
+    t_Labels m_MaxLabel = 0;
+
+    //! Moves a random validation_fraction of the training indices to the returned
+    //! validation indices. Uses the random state so that the split is reproducible.
+    //! @param trainIndices Indices of all the samples, reduced to the training ones.
+    //! @returns Indices of the validation samples.
+    //! @throws std::domain_error If there are not enough samples to keep at least one
+    //!   sample for training and one for validation.
+    std::vector<size_t> splitValidationSet(std::vector<size_t>& trainIndices) const
+    {
+        const size_t validationN = static_cast<size_t>(std::ceil(m_ValidationFraction * trainIndices.size()));
+
+        if (validationN == 0 || validationN >= trainIndices.size())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "Not enough samples to hold out a validation fraction of " << m_ValidationFraction
+                << ": " << trainIndices.size() << " samples.").str()
+            );
+        }
+
+        SeedGenerator seedGen(m_UseSeed, m_Seed);
+        std::mt19937 generator(seedGen.seed());
+        std::shuffle(trainIndices.begin(), trainIndices.end(), generator);
+
+        std::vector<size_t> validationIndices(trainIndices.begin(), trainIndices.begin() + validationN);
+        trainIndices.erase(trainIndices.begin(), trainIndices.begin() + validationN);
+
+        // Keep the original order of the training samples; only the split is random.
+        std::sort(trainIndices.begin(), trainIndices.end());
+
+        log("Holds out " + std::to_string(validationN) + " samples for validation.");
+
+        return validationIndices;
+    }
+
+    //! Checks that there is one output per input and that all the inputs have the same size.
+    //! @returns Pointers to the values of each input.
+    std::vector<const double*> rowsOf(const std::vector<std::vector<double>>& inputs,
+        const std::vector<T>& expectedOuputs) const
+    {
+        log("Checks that output size is consistent with input size.");
+
+        // Check that output size is consistent with input size
+        if (inputs.size() != expectedOuputs.size())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "Input and output size are not consistent: input "
+                << inputs.size() << " output " << expectedOuputs.size() << ".").str()
+            );
+        }
+
+        log("Checks that all inputs are of same size.");
+
+        // Check that all inputs are of the same
+
+        size_t inputSize = inputs[0].size();
+
+        for (size_t i = 1; i < inputs.size(); i++)
+        {
+            if (inputs[i].size() != inputSize)
+            {
+                throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                    << "All inputs do not have the same size: first "
+                    << inputSize << " " << i << "th " << inputs[i].size() << ".").str()
+                );
+            }
+        }
+
+        log("Output and input are of same size. All inputs are of same size.");
+
+        std::vector<const double*> rows;
+        rows.reserve(inputs.size());
+
+        for (const std::vector<double>& input : inputs)
+        {
+            rows.push_back(input.data());
+        }
+
+        return rows;
+    }
+
+    //! Builds the network: hidden layers then an output classification layer for the
+    //! labels from @p min to @p max, or an output regression layer of size 1.
+    void buildNetwork(size_t inputSize, t_Labels min, t_Labels max)
+    {
+        log("Builds the neural network of input size " + std::to_string(inputSize) + ".");
+
+        // The plan of the previous network must not be used if the training throws
+        m_Plan.reset();
+        m_Net = std::make_unique<NeuralNetwork>(inputSize, m_LearningRate, m_Momentum, m_UseSeed, m_Seed);
+        m_Net->setLayerProfiler(m_Profiler);
+        m_Net->setThreadCount(m_ThreadsN);
+        m_MinLabel = min;
+        m_MaxLabel = max;
+
+        std::for_each(m_HiddenLayerSizes.cbegin(), m_HiddenLayerSizes.cend(),
+            [&](size_t layerSize)
+            {
+                log("Adds hidden layer of size " + std::to_string(layerSize) + ".");
+                m_Net->addHiddenLayer(layerSize, m_AFunc);
+            });
+
+        if (type() == MLPType::Classifier)
+        {
+            t_Labels size = max - min + 1; // min included to max included = max - min + 1
+
+            log("Adds output classification layer of size " + std::to_string(size)
+                + " for range " + std::to_string(min) + "-" + std::to_string(max) + ".");
+            m_Net->addOutputClassificationLayer(size);
+        }
+        else
+        {
+            log("Adds output regression layer of size 1.");
+            m_Net->addOutputRegressionLayer(1, m_AFunc);
+        }
+    }
+
+    //! Builds and trains the network on @p rows, each of @p inputSize values.
+    void fitRows(const std::vector<const double*>& rows, size_t inputSize, const std::vector<T>& expectedOuputs)
+    {
+        t_Labels max = 0; // max label if MLPClassifier
+        t_Labels min = 0; // min label if MLPClassifier
+
+        if (type() == MLPType::Classifier)
+        {
+            max = (t_Labels) *std::max_element(expectedOuputs.begin(), expectedOuputs.end());
+            min = (t_Labels) *std::min_element(expectedOuputs.begin(), expectedOuputs.end());
+        }
+
+        buildNetwork(inputSize, min, max);
+
+        // Hold out the validation set used for early stopping if requested. Otherwise
+        // train on all the samples, in the order provided.
+
+        std::vector<size_t> trainIndices(rows.size());
+        std::iota(trainIndices.begin(), trainIndices.end(), 0);
+        std::vector<size_t> validationIndices;
+
+        if (m_EarlyStopping && m_ValidationFraction > 0.0)
+        {
+            validationIndices = splitValidationSet(trainIndices);
+        }
+
+        log("Trains the network with max " + std::to_string(m_MaxIterations) + " epochs.");
+
+        // Train neural network
+
+        auto t0 = std::chrono::high_resolution_clock::now();
+        std::deque<double> errors;
+        double error = 0.0;
+        size_t nbBatches = 1, batchSize = m_BatchSize;
+        const size_t trainN = trainIndices.size();
+        m_StepsN = 0;
+
+        double bestValidationError = std::numeric_limits<double>::max();
+        size_t epochsNoImprovement = 0;
+        std::vector<double> bestParameters;
+
+        // If the MLP should not use the batch size it means it is an on-line stochastic
+        // gradient descent with batches of size 1.
+        if (!m_UseBatchSize)
+        {
+            batchSize = 1;
+            nbBatches = trainN;
+        }
+        else
+        {
+            nbBatches = trainN / batchSize + (trainN % batchSize == 0 ? 0 : 1);
+        }
+
+        m_Net->updateLearningRate(m_Scheduler->start(m_LearningRate, m_MaxIterations, nbBatches));
+
+        // Phases are only timed when an observer is attached. The accumulator
+        // sums them per epoch and forwards them to the observer.
+        std::unique_ptr<PhaseAccumulator> phases;
+
+        if (m_Observer.get() != nullptr)
+        {
+            phases = std::make_unique<PhaseAccumulator>(m_Observer);
+        }
+
+        TrainingObserver* timed = phases.get();
+        std::chrono::steady_clock::time_point epochStart;
+
+        m_IterationsN = 0;
+
+        for (size_t epoch = 0; epoch < m_MaxIterations; epoch++)
+        {
+            error = 0.0;
+            ++m_IterationsN;
+
+            if (timed != nullptr)
+            {
+                phases->reset();
+                epochStart = std::chrono::steady_clock::now();
+            }
+
+            error = trainEpoch(rows, expectedOuputs, trainIndices, batchSize, timed) / trainN;
+
+            double validationError = std::numeric_limits<double>::quiet_NaN();
+
+            if (!validationIndices.empty())
+            {
+                validationError = calcValidationError(rows, expectedOuputs, validationIndices);
+            }
+
+            if (timed != nullptr)
+            {
+                EpochMetrics metrics;
+                metrics.epoch = epoch;
+                metrics.samplesN = trainN;
+                metrics.batchesN = nbBatches;
+                metrics.loss = error;
+                metrics.validationLoss = validationError;
+                metrics.learningRate = m_Net->learningRate();
+                metrics.dataSeconds = phases->seconds(TrainingPhase::Data);
+                metrics.forwardSeconds = phases->seconds(TrainingPhase::Forward);
+                metrics.backwardSeconds = phases->seconds(TrainingPhase::Backward);
+                metrics.updateSeconds = phases->seconds(TrainingPhase::Update);
+                metrics.totalSeconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - epochStart).count();
+                m_Observer->onEpochEnd(metrics);
+            }
+
+            if (!validationIndices.empty())
+            {
+                // Early stopping on the held-out validation set: keep a snapshot of
+                // the best weights and stop once the validation error has not
+                // improved by at least tol for n_iter_no_change epochs.
+                if (validationError < bestValidationError - m_OptimizationTolerance)
+                {
+                    epochsNoImprovement = 0;
+                }
+                else
+                {
+                    ++epochsNoImprovement;
+                }
+
+                if (validationError < bestValidationError)
+                {
+                    bestValidationError = validationError;
+                    m_Net->copyParameters(bestParameters);
+                }
+
+                if (epochsNoImprovement > m_IterNoChangeN)
+                {
+                    log("Validation error did not improve more than tol=" + std::to_string(m_OptimizationTolerance)
+                        + " for " + std::to_string(m_IterNoChangeN) + " consecutive epochs after "
+                        + std::to_string(epoch) + " epochs. Stopping.");
+                    break;
+                }
+            }
+            else if (trainingErrorStalled(errors, error, epoch))
+            {
+                break;
+            }
+
+            m_Net->updateLearningRate(m_Scheduler->epochEnd(epoch, error, m_Net->learningRate()));
+            saveCheckpoint();
+        }
+
+        if (!bestParameters.empty())
+        {
+            log("Restores the weights of the best validation error " + std::to_string(bestValidationError) + ".");
+            m_Net->restoreParameters(bestParameters);
+        }
+
+        endTraining(error, t0);
+    }
 
-    double m_EffectiveLearningRate;
+    //! Trains one epoch on the samples @p trainIndices of @p rows, in this order, with
+    //! batches of @p batchSize samples: the last batch can be smaller.
+    //! @returns Sum of the errors of the samples, each calculated before its batch update.
+    double trainEpoch(const std::vector<const double*>& rows, const std::vector<T>& expectedOuputs,
+        const std::vector<size_t>& trainIndices, size_t batchSize, TrainingObserver* timed)
+    {
+        const size_t trainN = trainIndices.size();
+        const size_t nbBatches = trainN / batchSize + (trainN % batchSize == 0 ? 0 : 1);
+        const bool scheduleBatches = m_Scheduler->perBatch();
+        double error = 0.0;
+
+        for (size_t batch = 0; batch < nbBatches; batch++)
+        {
+            for (size_t b = batch * batchSize; b < (batch + 1) * batchSize && b < trainN; b++)
+            {
+                const size_t i = trainIndices[b];
+
+                {
+                    PhaseTimer timer(timed, TrainingPhase::Forward);
+                    m_Net->propagateForward(rows[i]);
+                }
+
+                if (type() == MLPType::Classifier)
+                {
+                    std::vector<double> expectedOutput;
+
+                    {
+                        PhaseTimer timer(timed, TrainingPhase::Data);
+                        expectedOutput = Utils::convertLabelToVect((t_Labels)expectedOuputs[i], m_MinLabel, m_MaxLabel);
+                    }
+
+                    PhaseTimer timer(timed, TrainingPhase::Backward);
+                    error += m_Net->calcError(expectedOutput);
+                    m_Net->propagateBackward(expectedOutput);
+                }
+                else
+                {
+                    PhaseTimer timer(timed, TrainingPhase::Backward);
+                    error += m_Net->calcError(expectedOuputs[i]);
+                    m_Net->propagateBackward(expectedOuputs[i]);
+                }
+            }
+
+            {
+                PhaseTimer timer(timed, TrainingPhase::Update);
+                m_Net->updateWeights();
+            }
+
+            if (scheduleBatches)
+            {
+                m_Net->updateLearningRate(m_Scheduler->batchEnd(m_StepsN, m_Net->learningRate()));
+            }
+
+            ++m_StepsN;
+        }
+
+        return error;
+    }
+
+    //! Saves a checkpoint named after the number of epochs run, if a writer is attached.
+    void saveCheckpoint()
+    {
+        if (m_Checkpoints.get() != nullptr)
+        {
+            std::vector<double> schedulerState;
+            m_Scheduler->copyState(schedulerState);
+            m_Checkpoints->save(*m_Net, m_IterationsN, m_StepsN, schedulerState);
+        }
+    }
+
+    //! Early stopping on the training error, when there is no validation set.
+    //! @param errors Last errors, updated with @p error.
+    //! @returns true if the error has not decreased by more than tol for n_iter_no_change epochs.
+    bool trainingErrorStalled(std::deque<double>& errors, double error, size_t epoch) const
+    {
+        if (!m_EarlyStopping || m_LearningRateType == LearningRate::Adaptive)
+        {
+            return false;
+        }
+
+        // In case of early stopping we need to keep track of the last errors.
+        // Early stopping is disabled with the adaptive learning rate which
+        // decreases the learning rate instead.
+
+        if (errors.size() < m_IterNoChangeN + 1)
+        {
+            // +1 because the (N+1)th element is used as a reference
+            // and compared to the Nth other elements.
+            // No decision while the list is not complete, i.e there are
+            // not enough items to conclude that the training can stop.
+            errors.push_back(error);
+            return false;
+        }
+
+        errors.pop_front();
+        errors.push_back(error);
+
+        for (size_t i = errors.size() - 1; i > 0; i--)
+        {
+            if (errors[i - 1] - errors[i] > m_OptimizationTolerance)
+            {
+                return false;
+            }
+        }
+
+        log("Optimization tolerance of " + std::to_string(m_OptimizationTolerance)
+            + " reached after " + std::to_string(epoch) + " epochs. Stopping.");
+        return true;
+    }
+
+    //! Logs the final state, compiles the inference plan and notifies the observer.
+    void endTraining(double error, std::chrono::high_resolution_clock::time_point t0)
+    {
+        log("Final error is " + std::to_string(error) + ".");
+
+        if (m_LearningRateType != LearningRate::Constant)
+        {
+            log("Final effective learning rate is " + std::to_string(m_Net->learningRate()) + ".");
+        }
+
+        auto t1 = std::chrono::high_resolution_clock::now();
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+
+        log("Training completed in " + std::to_string(elapsed) + " ms.");
+
+        // Predictions go through a plan of the trained network
+        m_Plan = std::make_unique<InferencePlan>(m_Net->compile());
+
+        if (m_Observer.get() != nullptr)
+        {
+            m_Observer->onTrainingEnd(m_IterationsN, std::chrono::duration<double>(t1 - t0).count());
+        }
+    }
+
+    //! Mean error of the validation samples, predicted by batches with a plan compiled
+    //! from the current weights: each panel of weights is read once per batch.
+    double calcValidationError(const std::vector<const double*>& rows,
+        const std::vector<T>& expectedOuputs, const std::vector<size_t>& validationIndices)
+    {
+        constexpr size_t kBatchSize = 64;
+        const InferencePlan plan = m_Net->compile();
+        const size_t outputsN = plan.outputSize();
+        std::vector<const double*> batch;
+        std::vector<double> outputs;
+        double error = 0.0;
+
+        for (size_t first = 0; first < validationIndices.size(); first += kBatchSize)
+        {
+            const size_t last = std::min(first + kBatchSize, validationIndices.size());
+            batch.clear();
+
+            for (size_t v = first; v < last; v++)
+            {
+                batch.push_back(rows[validationIndices[v]]);
+            }
+
+            plan.predictBatch(batch, outputs);
+
+            for (size_t v = first; v < last; v++)
+            {
+                const double* sampleOutputs = outputs.data() + (v - first) * outputsN;
+                const double expected = expectedOuputs[validationIndices[v]];
+
+                // Same errors as NeuralNetwork::calcError(), the label being the index of its output
+                if (type() == MLPType::Classifier)
+                {
+                    error += OutputClassificationLayer::crossEntropyError(sampleOutputs, (size_t)(t_Labels)expected);
+                }
+                else
+                {
+                    error += OutputRegressionLayer::squaredError(sampleOutputs, &expected, 1);
+                }
+            }
+        }
+
+        return error / validationIndices.size();
+    }
 };
 
 class MLPRegressor : public MLP<double>
@@ -337,7 +1046,8 @@ public:
         bool verbose = false,
         double momentum = 0.9,
         bool early_stopping = false,
-        size_t n_iter_no_change = 10) :
+        size_t n_iter_no_change = 10,
+        double validation_fraction = 0.0) :
         MLP(hidden_layer_sizes,
             activation,
             solver,
@@ -353,19 +1063,43 @@ public:
             verbose,
             momentum,
             early_stopping,
-            n_iter_no_change)
+            n_iter_no_change,
+            validation_fraction)
     {
 
     }
 
+    using MLP::fit;
+
+    //! Trains on a stream of samples, e.g. a file larger than the memory: see
+    //! SampleStream. Only two blocks of samples are in memory at a time.
+    void fit(SampleStream& samples)
+    {
+        fitStream(samples, 0, 0);
+    }
+
+    //! Trains for one epoch on new samples, continuing from the previous calls to fit
+    //! or partial_fit. See MLP::partialFit.
+    void partial_fit(const std::vector<std::vector<double>>& inputs, const std::vector<double>& expectedOuputs)
+    {
+        partialFit(inputs, expectedOuputs, 0, 0);
+    }
+
+    //! Restores the latest checkpoint of @p prefix to resume the training with
+    //! partial_fit. See MLP::restoreCheckpoint.
+    bool restoreCheckpoint(const std::string& prefix, size_t inputSize)
+    {
+        return MLP::restoreCheckpoint(prefix, inputSize, 0, 0);
+    }
+
     double predict(const std::vector<double>& input) const
     {
-        if (m_Net.get() == nullptr)
+        if (m_Plan.get() == nullptr)
         {
             throw std::domain_error("Use fit before predict.");
         }
 
-        return m_Net->propagateForward(input)[0];
+        return m_Plan->predict(input)[0];
     }
 
     std::vector<double> predict(const std::vector<std::vector<double>>& inputs) const
@@ -400,7 +1134,8 @@ public:
         bool verbose = false,
         double momentum = 0.9,
         bool early_stopping = false,
-        size_t n_iter_no_change = 10) :
+        size_t n_iter_no_change = 10,
+        double validation_fraction = 0.0) :
         MLP(hidden_layer_sizes,
             activation,
             solver,
@@ -416,20 +1151,82 @@ public:
             verbose,
             momentum,
             early_stopping,
-            n_iter_no_change)
+            n_iter_no_change,
+            validation_fraction)
+    {
+
+    }
+
+    using MLP::fit;
+
+    //! Trains on a stream of samples, e.g. a file larger than the memory: see
+    //! SampleStream. Only two blocks of samples are in memory at a time.
+    //! @param classesN Number of classes: the targets are labels from 0 to @p classesN - 1.
+    //! @throws std::domain_error If @p classesN is 0.
+    void fit(SampleStream& samples, t_Labels classesN)
     {
+        if (classesN == 0)
+        {
+            throw std::domain_error("Number of classes must be positive.");
+        }
+
+        fitStream(samples, 0, static_cast<t_Labels>(classesN - 1));
+    }
+
+    //! Trains for one epoch on new samples, continuing from the previous calls to fit
+    //! or partial_fit. See MLP::partialFit. The classes cannot change once the network
+    //! is built.
+    //! @param classesN Number of classes, labels from 0 to @p classesN - 1, required by
+    //!   the call which builds the network. Ignored afterwards.
+    //! @throws std::domain_error If the network is not built and @p classesN is 0, or if
+    //!   a label is not a class of the network.
+    void partial_fit(const std::vector<std::vector<double>>& inputs,
+        const std::vector<t_Labels>& expectedOuputs, t_Labels classesN)
+    {
+        if (m_Net.get() == nullptr && classesN == 0 && !inputs.empty())
+        {
+            throw std::domain_error("Number of classes must be provided to the first call to partial_fit.");
+        }
 
+        partialFit(inputs, expectedOuputs, 0, static_cast<t_Labels>(classesN - 1));
     }
 
+    //! Restores the latest checkpoint of @p prefix to resume the training with
+    //! partial_fit. See MLP::restoreCheckpoint.
+    //! @param classesN Number of classes, labels from 0 to @p classesN - 1.
+    //! @throws std::domain_error If @p classesN is 0.
+    bool restoreCheckpoint(const std::string& prefix, size_t inputSize, t_Labels classesN)
+    {
+        if (classesN == 0)
+        {
+            throw std::domain_error("Number of classes must be provided to restore a checkpoint.");
+        }
+
+        return MLP::restoreCheckpoint(prefix, inputSize, 0, static_cast<t_Labels>(classesN - 1));
+    }
+
+    //! @returns Most probable class. Only the logits are calculated, as the softmax
+    //!   does not change which output is the highest.
     size_t predict(const std::vector<double>& input) const
     {
-        if (m_Net.get() == nullptr)
+        if (m_Plan.get() == nullptr)
+        {
+            throw std::domain_error("Use fit before predict.");
+        }
+
+        return m_Plan->probableClass(input);
+    }
+
+    //! @returns The @p k most probable classes and their probabilities, from the most
+    //!   to the least probable. See @ref InferencePlan::topClasses.
+    std::vector<std::pair<size_t, double>> predict_top_k(const std::vector<double>& input, size_t k) const
+    {
+        if (m_Plan.get() == nullptr)
         {
             throw std::domain_error("Use fit before predict.");
         }
 
-        m_Net->propagateForward(input);
-        return m_Net->probableClass();
+        return m_Plan->topClasses(input, k);
     }
 
     MLPType type() const override
@@ -0,0 +1,129 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_NETWORK_FOOTPRINT_H
+#define YANNL_NETWORK_FOOTPRINT_H
+
+#include "NeuronLayer.h"
+#include <algorithm> // std::max
+#include <iostream>  // std::ostream
+#include <vector>    // std::vector
+
+namespace YANNL
+{
+
+//! Memory and operations of one layer, see NetworkFootprint.
+struct LayerFootprint
+{
+    LayerType type = LayerType::Hidden;
+    size_t size = 0;
+    size_t parametersN = 0;
+    LayerMemory memory;
+    //! Per sample.
+    LayerCost forward;
+    //! Per sample.
+    LayerCost backward;
+    //! Per weights update, i.e. per batch.
+    LayerCost update;
+};
+
+//! @brief Memory and floating-point operations of a network estimated from its layers,
+//! without running it: see NeuralNetwork::footprint() and MLP::footprint().
+//! Samples are propagated one after another, the gradients of a batch being accumulated,
+//! so the memory used for training does not depend on the batch size; batch inference
+//! with InferencePlan::predictBatch() holds the activations of all the samples.
+struct NetworkFootprint
+{
+    size_t inputSize = 0;
+    //! Size of the input or of the widest layer.
+    size_t widestLayer = 0;
+    size_t parametersN = 0;
+    //! Weights and biases.
+    size_t parameterBytes = 0;
+    //! Buffers used only for training, see LayerMemory::trainingBytes.
+    size_t trainingBytes = 0;
+    //! Outputs and deltas of the layers for one sample.
+    size_t activationBytes = 0;
+    double forwardFlops = 0.0;
+    double backwardFlops = 0.0;
+    double updateFlops = 0.0;
+    std::vector<LayerFootprint> layers;
+
+    //! Adds a layer after the previous ones.
+    //! @param summedN See NeuronLayer::cost().
+    void add(const NeuronLayer& layer, size_t summedN)
+    {
+        LayerFootprint footprint;
+        footprint.type = layer.type();
+        footprint.size = layer.size();
+        footprint.parametersN = layer.parametersCount();
+        footprint.memory = layer.memory();
+        footprint.forward = layer.cost(TrainingPhase::Forward, summedN);
+        footprint.backward = layer.cost(TrainingPhase::Backward, summedN);
+        footprint.update = layer.cost(TrainingPhase::Update, summedN);
+
+        widestLayer = std::max(widestLayer, footprint.size);
+        parametersN += footprint.parametersN;
+        parameterBytes += footprint.memory.parameterBytes;
+        trainingBytes += footprint.memory.trainingBytes;
+        activationBytes += footprint.memory.activationBytes;
+        forwardFlops += footprint.forward.flops;
+        backwardFlops += footprint.backward.flops;
+        updateFlops += footprint.update.flops;
+        layers.push_back(footprint);
+    }
+
+    //! @returns Bytes held while training: parameters, training buffers and the
+    //!   activations of one sample.
+    size_t trainingTotalBytes() const
+    {
+        return parameterBytes + trainingBytes + activationBytes;
+    }
+
+    //! @returns Bytes of the two buffers of activations of InferencePlan::predictBatch()
+    //!   for @p batchSize samples, the padding of the last panel of neurons aside.
+    size_t batchActivationBytes(size_t batchSize) const
+    {
+        return 2 * batchSize * widestLayer * sizeof(double);
+    }
+
+    //! @returns Operations to train on @p samplesN samples by batches of @p batchSize.
+    double trainingFlops(size_t samplesN, size_t batchSize) const
+    {
+        const size_t batchesN = batchSize == 0 ? samplesN : (samplesN + batchSize - 1) / batchSize;
+        return samplesN * (forwardFlops + backwardFlops) + batchesN * updateFlops;
+    }
+
+    //! Prints the totals then the figures of each layer.
+    void inspect(std::ostream& os) const
+    {
+
+        os << "------" << "\n"
+            << "* Inputs: " << inputSize << "\n"
+            << "* Parameters: " << parametersN << " (" << parameterBytes << " bytes)\n"
+            << "* Training buffers: " << trainingBytes << " bytes\n"
+            << "* Activations per sample: " << activationBytes << " bytes\n"
+            << "* FLOPs per sample: forward " << forwardFlops << " backward " << backwardFlops
+            << "; per update " << updateFlops << "\n"
+            << "------" << "\n";
+
+        for (size_t n = 0; n < layers.size(); n++)
+        {
+            const LayerFootprint& layer = layers[n];
+
+            os << "* Layer " << (n + 1) << " " << layerTypeName(layer.type)
+                << " of " << layer.size << " neurons\n"
+                << "  Parameters: " << layer.parametersN << " (" << layer.memory.parameterBytes << " bytes)"
+                << " training buffers: " << layer.memory.trainingBytes << " bytes"
+                << " activations: " << layer.memory.activationBytes << " bytes\n"
+                << "  FLOPs: forward " << layer.forward.flops << " backward " << layer.backward.flops
+                << " update " << layer.update.flops << "\n"
+                << "------" << "\n";
+        }
+    }
+};
+
+}
+
+#endif // YANNL_NETWORK_FOOTPRINT_H
@@ -5,11 +5,37 @@
 #ifndef YANNL_NEURAL_NETWORK_H
 #define YANNL_NEURAL_NETWORK_H
 
+#include "ImageLayers.h"
+#include "InferencePlan.h"
+#include "InferenceSession.h"
+#include "LayerProfiler.h"
+#include "NetworkFootprint.h"
 #include "NeuronLayer.h"
+#include "TrainingObserver.h"
 
 namespace YANNL
 {
 
+//! @brief Everything which changes while training a network, to resume the training
+//! exactly where it was: see NeuralNetwork::copyTrainingState() and CheckpointWriter.
+struct TrainingState
+{
+    //! Epoch and step (weight update) counters of the training loop, set by the caller.
+    size_t epoch = 0;
+    size_t step = 0;
+    double learningRate = 0.0;
+    //! Input size, then the type and size of each layer, to check the network restored.
+    std::vector<size_t> topology;
+    std::vector<double> parameters;
+    //! Last change of each weight and bias, used by the momentum.
+    std::vector<double> optimizerState;
+    //! State of the random generator of each layer; empty for layers without one.
+    std::vector<std::string> generators;
+    //! State of the learning rate scheduler of the training loop, set by the caller like
+    //! the counters, see LearningRateScheduler::copyState(); empty if there is none.
+    std::vector<double> schedulerState;
+};
+
 class NeuralNetwork
 {
 public:
@@ -21,10 +47,14 @@ public:
     //! @param useSeed Tells whether to use the provided seed (true) or random seed (false).
     //! @param seed The seed to initialize the random function for determining weights, and
     //!   dropout in dropout layers.
+    //! @param engine Engine drawing the weights and the dropout masks. Mersenne Twister by
+    //!   default; @ref RandomEngine::Philox draws them in bulk and in parallel.
     explicit NeuralNetwork(size_t inputSize, double learningRate, double momentum = 0.0,
-        bool useSeed = false, unsigned int seed = 0) :
-        m_InputSize(inputSize), m_LearningRate(learningRate), m_Momentum(momentum),
-        m_SeedGenerator(std::make_shared<SeedGenerator>(useSeed, seed))
+        bool useSeed = false, unsigned int seed = 0,
+        RandomEngine engine = RandomEngine::MersenneTwister) :
+        m_InputSize(inputSize), m_InputShape(inputSize, 1, 1),
+        m_Optimizer(std::make_shared<SGDOptimizer>(learningRate, momentum)),
+        m_SeedGenerator(std::make_shared<SeedGenerator>(useSeed, seed, engine))
     {
         // inputSize is useful to verify the consistency of the network when
         // adding a first hidden layer or when providing inputs.
@@ -170,6 +200,71 @@ public:
             m_Layers.push_back(std::make_shared<DropoutLayer>(dropoutRate,
                 m_Layers.back()->size(), m_SeedGenerator));
         }
+
+        applyActivationCheckpoints();
+    }
+
+    //! Tells that the inputs are images, e.g. 1 x 28 x 28 for grayscale images of 28 x 28
+    //! pixels, before adding convolutional or pooling layers. By default the inputs are
+    //! input size channels of 1 x 1.
+    //! @throws std::domain_error If the size of @p shape is not the input size or if
+    //!   layers have been added already.
+    void setInputShape(const ImageShape& shape)
+    {
+        if (shape.size() != m_InputSize || !m_Layers.empty())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Set input shape] Shape " << shape << " must be set before adding layers and be of "
+                << m_InputSize << " inputs.").str()
+            );
+        }
+
+        m_InputShape = shape;
+    }
+
+    const ImageShape& inputShape() const
+    {
+        return m_InputShape;
+    }
+
+    //! Adds a convolutional layer reading the outputs of the last layer as images, see
+    //! @ref Conv2DLayer and @ref setInputShape(const ImageShape&).
+    //! @param filtersN Number of filters, i.e. of output channels.
+    //! @param kernelSize Height and width of the filters.
+    //! @param afunc Activation function for the layer.
+    //! @param stride Distance between two positions of the filters. 1 by default.
+    //! @param padding Zeros added around each input channel. 0 by default.
+    //! @throws std::domain_error If this layer is added after an output layer or if the
+    //!   filters do not fit the images.
+    void addConv2DLayer(size_t filtersN, size_t kernelSize, ActivationFunctions afunc,
+        size_t stride = 1, size_t padding = 0)
+    {
+        if (isLastLayerAnOutput())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Add convolutional layer] Cannot add a convolutional layer after an output layer.").str()
+            );
+        }
+
+        m_Layers.push_back(std::make_shared<Conv2DLayer>(lastImageShape(), filtersN, kernelSize, stride,
+            padding, afunc, m_Optimizer, m_SeedGenerator));
+        applyActivationCheckpoints();
+    }
+
+    //! Adds a max pooling layer, see @ref PoolLayer.
+    //! @param poolSize Height and width of the windows.
+    //! @param stride Distance between two windows. The pool size by default.
+    //! @throws std::domain_error If this layer is added after an output layer or if the
+    //!   windows do not fit the images.
+    void addMaxPoolLayer(size_t poolSize, size_t stride = 0)
+    {
+        addPoolLayer(LayerType::MaxPool, poolSize, stride);
+    }
+
+    //! Adds an average pooling layer, see @ref addMaxPoolLayer(size_t, size_t).
+    void addAvgPoolLayer(size_t poolSize, size_t stride = 0)
+    {
+        addPoolLayer(LayerType::AvgPool, poolSize, stride);
     }
 
     //! Prints information on the neural network to the provided output stream.
@@ -188,15 +283,23 @@ public:
         }
     }
 
+    //! Changes the learning rate of all the layers. The learning rate is held once by
+    //! the optimizer shared by the layers so this costs O(1) and can be called after
+    //! each batch, e.g. by a learning rate scheduler.
+    //! @param learningRate New learning rate.
     void updateLearningRate(double learningRate)
     {
-        m_LearningRate = learningRate;
+        m_Optimizer->setLearningRate(learningRate);
+    }
 
-        std::for_each(m_Layers.begin(), m_Layers.end(),
-            [&](const std::shared_ptr<NeuronLayer>& layer)
-            {
-                layer->updateLearningRate(learningRate);
-            });
+    double learningRate() const
+    {
+        return m_Optimizer->learningRate();
+    }
+
+    size_t inputSize() const
+    {
+        return m_InputSize;
     }
 
     //! Propagates the provided input forward through all the neural network and calculates
@@ -226,17 +329,58 @@ public:
             );
         }
 
-        std::vector<double> outputs(inputs);
+        return propagateForward(inputs.data(), ignoreDropout);
+    }
+
+    //! Same as @ref propagateForward(const std::vector<double>&, bool) with the inputs read
+    //! from a row of a contiguous matrix, e.g. a dataset loaded with CsvReader.
+    //! @param inputs As many values as input neurons; the size is not checked.
+    //! @throws std::domain_error If there are no output layers.
+    std::vector<double> propagateForward(const double* inputs, bool ignoreDropout = false)
+    {
+        if (!isLastLayerAnOutput())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Propagate forward] Neural network has no output layers.").str()
+            );
+        }
+
+        PhaseTimer timer(m_Observer.get(), TrainingPhase::Forward);
+        std::vector<double> outputs(inputs, inputs + m_InputSize);
 
         for (size_t n = 0; n < m_Layers.size(); n++)
         {
-            // std::move is optional as RVO will do the same
-            outputs = std::move(m_Layers[n]->propagateForward(outputs, ignoreDropout));
+            LayerTimer layerTimer(m_Profiler.get(), n, *m_Layers[n], TrainingPhase::Forward);
+
+            if (m_Layers[n]->dropoutLayer())
+            {
+                // Dropout is applied in place on the outputs of the previous layer
+                static_cast<DropoutLayer&>(*m_Layers[n]).propagateForwardInPlace(outputs, ignoreDropout);
+            }
+            else
+            {
+                // std::move is optional as RVO will do the same
+                outputs = std::move(m_Layers[n]->propagateForward(outputs, ignoreDropout));
+            }
         }
 
         return outputs;
     }
 
+    //! Builds an execution plan for inference from the current weights. See @ref InferencePlan.
+    //! @throws std::domain_error If the neural network has no output layers.
+    InferencePlan compile() const
+    {
+        if (!isLastLayerAnOutput())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Compile] Neural network has no output layers.").str()
+            );
+        }
+
+        return InferencePlan(m_InputSize, m_Layers);
+    }
+
     //! @returns Most probable class when using several neurons on the output layer
     //!   for classification problems, i.e. regressors.
     //! @throws std::domain_error If no output layers have been added.
@@ -322,14 +466,23 @@ public:
             );
         }
 
+        PhaseTimer timer(m_Observer.get(), TrainingPhase::Backward);
+
         // Propagate backward on the output layer
-        m_Layers.back()->propagateBackwardOuputLayer(expectedOutputs);
+        {
+            LayerTimer layerTimer(m_Profiler.get(), m_Layers.size() - 1, *m_Layers.back(), TrainingPhase::Backward);
+            replayActivations(m_Layers.size() - 1);
+            m_Layers.back()->propagateBackwardOuputLayer(expectedOutputs);
+            m_Layers.back()->releaseInputs();
+        }
 
         // Propagate backward for each hidden layer if there are hidden layers
-        for (auto layer = m_Layers.rbegin() + 1; layer != m_Layers.rend(); layer++)
+        for (size_t n = m_Layers.size() - 1; n-- > 0;)
         {
-            std::shared_ptr<const NeuronLayer> nextLayer = *(layer - 1);
-            (*layer)->propagateBackwardHiddenLayer(*nextLayer);
+            LayerTimer layerTimer(m_Profiler.get(), n, *m_Layers[n], TrainingPhase::Backward, summedNeurons(n));
+            replayActivations(n);
+            m_Layers[n]->propagateBackwardHiddenLayer(*m_Layers[n + 1]);
+            m_Layers[n]->releaseInputs();
         }
     }
 
@@ -339,9 +492,110 @@ public:
     //! Propagate forward and backward several times in case of (mini-)batches.
     void updateWeights()
     {
+        PhaseTimer timer(m_Observer.get(), TrainingPhase::Update);
+
         for (size_t n = 0; n < m_Layers.size(); n++)
         {
-            m_Layers[n]->updateWeights();
+            LayerTimer layerTimer(m_Profiler.get(), n, *m_Layers[n], TrainingPhase::Update);
+            m_Layers[n]->updateWeights(m_ThreadsN);
+        }
+    }
+
+    //! Sets the number of threads used when updating the weights of wide layers.
+    //! The threads are started and joined at each update (see Utils::parallelFor), so
+    //! only layers with many weights are split, see DenseLayer::kParallelUpdateMinWeights.
+    //! The updated weights are the same whatever the number of threads. Also used to draw
+    //! the weights of the wide layers added afterwards with a Philox generator.
+    //! @param threadsN Number of threads. 1 by default; 0 is considered as 1.
+    void setThreadCount(size_t threadsN)
+    {
+        m_ThreadsN = std::max<size_t>(1, threadsN);
+    }
+
+    size_t threadCount() const
+    {
+        return m_ThreadsN;
+    }
+
+    //! Trades computation for memory on deep networks. By default every layer keeps
+    //! the inputs of the last forward propagation to calculate the gradients when
+    //! propagating backward. With checkpoints, only one layer out of @p every keeps
+    //! them; the inputs of the layers in between are recomputed from the previous
+    //! checkpoint when propagating backward, once per segment. The dropout masks
+    //! are replayed so that the gradients are exactly the same as without checkpoints.
+    //! @param every Distance between two checkpoints. 0 by default to keep all the inputs.
+    void setActivationCheckpoints(size_t every)
+    {
+        m_CheckpointEvery = every;
+        applyActivationCheckpoints();
+    }
+
+    size_t activationCheckpoints() const
+    {
+        return m_CheckpointEvery;
+    }
+
+    //! @returns Number of input values currently stored by the layers to propagate backward.
+    size_t storedActivationsCount() const
+    {
+        size_t count = 0;
+
+        for (size_t n = 0; n < m_Layers.size(); n++)
+        {
+            count += m_Layers[n]->storedInputs().size();
+        }
+
+        return count;
+    }
+
+    //! Attaches an observer notified of the duration of each forward propagation,
+    //! backward propagation and weights update. Pass nullptr to detach it.
+    void setObserver(const std::shared_ptr<TrainingObserver>& observer)
+    {
+        m_Observer = observer;
+    }
+
+    std::shared_ptr<TrainingObserver> observer() const
+    {
+        return m_Observer;
+    }
+
+    //! Attaches a profiler recording the time and estimated work of each layer in each
+    //! phase. Pass nullptr to detach it. Define YANNL_NO_LAYER_PROFILING to remove the
+    //! hooks at compile time.
+    void setLayerProfiler(const std::shared_ptr<LayerProfiler>& profiler)
+    {
+        m_Profiler = profiler;
+    }
+
+    std::shared_ptr<LayerProfiler> layerProfiler() const
+    {
+        return m_Profiler;
+    }
+
+    //! Estimates the memory and the operations of the network from its layers, e.g. to
+    //! size the batches and the threads before training. See @ref NetworkFootprint.
+    NetworkFootprint footprint() const
+    {
+        NetworkFootprint footprint;
+        footprint.inputSize = m_InputSize;
+        footprint.widestLayer = m_InputSize;
+
+        for (size_t n = 0; n < m_Layers.size(); n++)
+        {
+            footprint.add(*m_Layers[n], summedNeurons(n));
+        }
+
+        return footprint;
+    }
+
+    //! Prints the profile of each layer recorded by the attached profiler, like
+    //! @ref inspect(std::ostream&) const prints the layers. Nothing if none is attached.
+    void inspectProfile(std::ostream& os) const
+    {
+        if (m_Profiler.get() != nullptr)
+        {
+            m_Profiler->inspect(os);
         }
     }
 
@@ -378,6 +632,115 @@ public:
         updateWeights();
     }
 
+    //! @returns Number of weights and biases of the whole network.
+    size_t parametersCount() const
+    {
+        size_t count = 0;
+
+        for (size_t n = 0; n < m_Layers.size(); n++)
+        {
+            count += m_Layers[n]->parametersCount();
+        }
+
+        return count;
+    }
+
+    //! Takes an in-memory snapshot of the weights and biases of all the layers, e.g.
+    //! to keep the best model found during training. The buffer is reused so that
+    //! taking several snapshots does not reallocate.
+    //! @param params Buffer receiving the parameters, layer by layer and neuron by neuron.
+    void copyParameters(std::vector<double>& params) const
+    {
+        params.clear();
+        params.reserve(parametersCount());
+
+        for (size_t n = 0; n < m_Layers.size(); n++)
+        {
+            m_Layers[n]->copyParameters(params);
+        }
+    }
+
+    //! Restores the weights and biases from a snapshot taken with
+    //! @ref copyParameters(std::vector<double>&) const on a network of same topology.
+    //! @throws std::domain_error If the snapshot size does not match the network.
+    void restoreParameters(const std::vector<double>& params)
+    {
+        if (params.size() != parametersCount())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Restore parameters] Snapshot size is inconsistent: expected "
+                << parametersCount() << " provided " << params.size() << ".").str()
+            );
+        }
+
+        size_t offset = 0;
+
+        for (size_t n = 0; n < m_Layers.size(); n++)
+        {
+            offset = m_Layers[n]->restoreParameters(params, offset);
+        }
+    }
+
+    //! Takes a snapshot of the training state: parameters, momentum, learning rate and
+    //! generators of the dropout layers. Take it between two batches, when no gradient
+    //! is pending. The buffers of @p state are reused. The counters are not modified.
+    void copyTrainingState(TrainingState& state) const
+    {
+        state.learningRate = learningRate();
+        state.topology.clear();
+        state.topology.push_back(m_InputSize);
+        state.optimizerState.clear();
+        state.optimizerState.reserve(parametersCount());
+        state.generators.resize(m_Layers.size());
+
+        for (size_t n = 0; n < m_Layers.size(); n++)
+        {
+            state.topology.push_back(static_cast<size_t>(m_Layers[n]->type()));
+            state.topology.push_back(m_Layers[n]->size());
+            m_Layers[n]->copyOptimizerState(state.optimizerState);
+            state.generators[n] = m_Layers[n]->generatorState();
+        }
+
+        copyParameters(state.parameters);
+    }
+
+    //! Restores a training state taken with copyTrainingState() on a network of same
+    //! topology, e.g. built by the same code in another process. Training then goes on
+    //! exactly as it would have from the snapshot.
+    //! @throws std::domain_error If the topology of @p state is not the one of the network.
+    void restoreTrainingState(const TrainingState& state)
+    {
+        std::vector<size_t> topology(1, m_InputSize);
+
+        for (size_t n = 0; n < m_Layers.size(); n++)
+        {
+            topology.push_back(static_cast<size_t>(m_Layers[n]->type()));
+            topology.push_back(m_Layers[n]->size());
+        }
+
+        if (state.topology != topology || state.optimizerState.size() != parametersCount()
+            || state.generators.size() != m_Layers.size())
+        {
+            throw std::domain_error("[Restore training state] Topology of the state is not the one of the network.");
+        }
+
+        restoreParameters(state.parameters);
+
+        size_t offset = 0;
+
+        for (size_t n = 0; n < m_Layers.size(); n++)
+        {
+            offset = m_Layers[n]->restoreOptimizerState(state.optimizerState, offset);
+
+            if (!state.generators[n].empty())
+            {
+                m_Layers[n]->restoreGeneratorState(state.generators[n]);
+            }
+        }
+
+        updateLearningRate(state.learningRate);
+    }
+
     bool saveToFile(const std::string& filepath) const
     {
         std::ofstream output(filepath);
@@ -391,8 +754,8 @@ public:
 
         output << "[NetworkBegin] \n"
             << "LayerNumber: " << m_Layers.size() << "\n"
-            << "Momentum: " << m_Momentum << "\n"
-            << "LearningRate: " << m_LearningRate << "\n"
+            << "Momentum: " << m_Optimizer->momentum() << "\n"
+            << "LearningRate: " << m_Optimizer->learningRate() << "\n"
             << "InputSize: " << m_InputSize << "\n"
             << "SeedGenerator: " << *m_SeedGenerator << "\n\n";
 
@@ -462,7 +825,7 @@ public:
             {
                 net.m_Layers.push_back(
                     std::make_shared<HiddenLayer>(
-                        HiddenLayer::readFromFile(file)));
+                        HiddenLayer::readFromFile(file, net.m_Optimizer)));
             }
             else if (static_cast<LayerType>(layerType) == LayerType::Dropout)
             {
@@ -474,36 +837,154 @@ public:
             {
                 net.m_Layers.push_back(
                     std::make_shared<OutputClassificationLayer>(
-                        OutputClassificationLayer::readFromFile(file)));
+                        OutputClassificationLayer::readFromFile(file, net.m_Optimizer)));
+            }
+            else if (static_cast<LayerType>(layerType) == LayerType::Conv2D)
+            {
+                net.m_Layers.push_back(
+                    std::make_shared<Conv2DLayer>(
+                        Conv2DLayer::readFromFile(file, net.m_Optimizer)));
+            }
+            else if (isImageLayer(static_cast<LayerType>(layerType)))
+            {
+                net.m_Layers.push_back(
+                    std::make_shared<PoolLayer>(
+                        PoolLayer::readFromFile(file, static_cast<LayerType>(layerType))));
             }
             else // OutputRegressionLayer
             {
                 net.m_Layers.push_back(
                     std::make_shared<OutputRegressionLayer>(
-                        OutputRegressionLayer::readFromFile(file)));
+                        OutputRegressionLayer::readFromFile(file, net.m_Optimizer)));
             }
         }
 
         file.close();
+        net.restoreInputShape();
 
         return net;
     }
 
 private:
+    friend class NetworkXML;
+
     const size_t m_InputSize = 0;
-    double m_LearningRate = 0.0;
-    const double m_Momentum = 0.0;
+    ImageShape m_InputShape;
+    const std::shared_ptr<SGDOptimizer> m_Optimizer;
     const std::shared_ptr<SeedGenerator> m_SeedGenerator;
     std::vector<std::shared_ptr<NeuronLayer>> m_Layers;
+    size_t m_ThreadsN = 1;
+    std::shared_ptr<TrainingObserver> m_Observer;
+    std::shared_ptr<LayerProfiler> m_Profiler;
+    size_t m_CheckpointEvery = 0;
 
     explicit NeuralNetwork(size_t inputSize, double learningRate, double momentum,
         const SeedGenerator& generator) :
-        m_InputSize(inputSize), m_LearningRate(learningRate), m_Momentum(momentum),
+        m_InputSize(inputSize), m_InputShape(inputSize, 1, 1),
+        m_Optimizer(std::make_shared<SGDOptimizer>(learningRate, momentum)),
         m_SeedGenerator(std::make_shared<SeedGenerator>(generator))
     {
 
     }
 
+    //! @returns Number of neurons whose weighted deltas layer @p layerN sums when
+    //!   propagating backward. See NeuronLayer::cost(). An image layer calculates the
+    //!   deltas of its inputs itself.
+    size_t summedNeurons(size_t layerN) const
+    {
+        return layerN + 1 < m_Layers.size() && !m_Layers[layerN + 1]->dropoutLayer()
+            && !isImageLayer(m_Layers[layerN + 1]->type()) ? m_Layers[layerN + 1]->size() : 0;
+    }
+
+    //! @returns Shape of the outputs of the last layer other than a dropout layer: the
+    //!   images of an image layer, 1 x 1 channels for a dense layer or the input shape
+    //!   if there are none.
+    ImageShape lastImageShape() const
+    {
+        for (size_t n = m_Layers.size(); n-- > 0;)
+        {
+            if (isImageLayer(m_Layers[n]->type()))
+            {
+                return static_cast<const ImageLayer&>(*m_Layers[n]).outputShape();
+            }
+            else if (!m_Layers[n]->dropoutLayer())
+            {
+                return ImageShape(m_Layers[n]->size(), 1, 1);
+            }
+        }
+
+        return m_InputShape;
+    }
+
+    //! Restores the input shape of a loaded network from its first image layer, if the
+    //! inputs are not read by a dense layer first.
+    void restoreInputShape()
+    {
+        for (const std::shared_ptr<NeuronLayer>& layer : m_Layers)
+        {
+            if (isImageLayer(layer->type()))
+            {
+                m_InputShape = static_cast<const ImageLayer&>(*layer).inputShape();
+            }
+
+            if (!layer->dropoutLayer())
+            {
+                return;
+            }
+        }
+    }
+
+    void addPoolLayer(LayerType layerType, size_t poolSize, size_t stride)
+    {
+        if (isLastLayerAnOutput())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Add pooling layer] Cannot add a pooling layer after an output layer.").str()
+            );
+        }
+
+        m_Layers.push_back(std::make_shared<PoolLayer>(layerType, lastImageShape(), poolSize, stride));
+        applyActivationCheckpoints();
+    }
+
+    //! Tells each layer whether to keep its inputs after propagating forward.
+    //! Dropout layers do not need them unless they are a checkpoint.
+    void applyActivationCheckpoints()
+    {
+        for (size_t n = 0; n < m_Layers.size(); n++)
+        {
+            m_Layers[n]->keepInputs(m_CheckpointEvery == 0
+                ? !m_Layers[n]->dropoutLayer()
+                : n % m_CheckpointEvery == 0);
+        }
+    }
+
+    //! Recomputes the inputs of layer @p layerN if they were not kept, by replaying the
+    //! forward propagation from the closest previous checkpoint. The layers in between
+    //! store their inputs as well so that the segment is replayed only once.
+    void replayActivations(size_t layerN)
+    {
+        if (m_CheckpointEvery == 0 || layerN == 0 || m_Layers[layerN]->dropoutLayer()
+            || !m_Layers[layerN]->storedInputs().empty())
+        {
+            return;
+        }
+
+        size_t first = layerN;
+
+        do
+        {
+            --first;
+        } while (first > 0 && m_Layers[first]->storedInputs().empty());
+
+        std::vector<double> activations(m_Layers[first]->storedInputs());
+
+        for (size_t n = first; n <= layerN; n++)
+        {
+            activations = m_Layers[n]->replayForward(activations);
+        }
+    }
+
     //! Adds a dense layer to the neural network with random weights.
     //! @param layerType HiddenLayer, OutputClassification, OutputRegression. See @ref LayerType
     //! @param neuronsN Number of neurons.
@@ -515,21 +996,25 @@ private:
         {
         case LayerType::Hidden:
             m_Layers.push_back(std::make_shared<HiddenLayer>(
-                neuronsN, lastLayerSize(), afunc, m_LearningRate, m_Momentum, m_SeedGenerator, bias));
+                neuronsN, lastLayerSize(), afunc, m_Optimizer, m_SeedGenerator, bias, m_ThreadsN));
             break;
         case LayerType::OutputClassification:
             m_Layers.push_back(std::make_shared<OutputClassificationLayer>(
-                neuronsN, lastLayerSize(), m_LearningRate, m_Momentum, m_SeedGenerator, bias));
+                neuronsN, lastLayerSize(), m_Optimizer, m_SeedGenerator, bias, m_ThreadsN));
             break;
         case LayerType::OutputRegression:
             m_Layers.push_back(std::make_shared<OutputRegressionLayer>(
-                neuronsN, lastLayerSize(), afunc, m_LearningRate, m_Momentum, m_SeedGenerator, bias));
+                neuronsN, lastLayerSize(), afunc, m_Optimizer, m_SeedGenerator, bias, m_ThreadsN));
             break;
         case LayerType::Dropout:
+        case LayerType::Conv2D:
+        case LayerType::MaxPool:
+        case LayerType::AvgPool:
             // Nothing
             break;
         }
 
+        applyActivationCheckpoints();
     }
 
     //! Adds a dense layer to the neural network with predefined weights.
@@ -563,21 +1048,25 @@ private:
         {
         case LayerType::Hidden:
             m_Layers.push_back(std::make_shared<HiddenLayer>(
-                layerWeights, afunc, m_LearningRate, m_Momentum, m_SeedGenerator, bias));
+                layerWeights, afunc, m_Optimizer, m_SeedGenerator, bias));
             break;
         case LayerType::OutputClassification:
             m_Layers.push_back(std::make_shared<OutputClassificationLayer>(
-                layerWeights, m_LearningRate, m_Momentum, m_SeedGenerator, bias));
+                layerWeights, m_Optimizer, m_SeedGenerator, bias));
             break;
         case LayerType::OutputRegression:
             m_Layers.push_back(std::make_shared<OutputRegressionLayer>(
-                layerWeights, afunc, m_LearningRate, m_Momentum, m_SeedGenerator, bias));
+                layerWeights, afunc, m_Optimizer, m_SeedGenerator, bias));
             break;
         case LayerType::Dropout:
+        case LayerType::Conv2D:
+        case LayerType::MaxPool:
+        case LayerType::AvgPool:
             // Nothing
             break;
         }
 
+        applyActivationCheckpoints();
     }
 
     //! @returns Size of the last added layer (number of neurons) if there is a last added layer
@@ -6,6 +6,7 @@
 #define YANNL_NEURON_H
 
 #include "ActivationFunction.h"
+#include "Optimizer.h"
 #include "Utils.h"  // SeedGenerator
 #include <fstream>  // std::ofstream
 
@@ -15,12 +16,13 @@ namespace YANNL
 class Neuron
 {
 public:
-    explicit Neuron(size_t weightsN, ActivationFunctions afunc, double learningRate,
-        double momentum, const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0) :
-        m_AFunc(ActivationFunctionFactory::build(afunc)), m_AFuncID(afunc), m_LearningRate(learningRate),
-        m_Momentum(momentum), m_Bias(bias),
+    explicit Neuron(size_t weightsN, ActivationFunctions afunc,
+        const std::shared_ptr<const SGDOptimizer>& optimizer,
+        const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0) :
+        m_AFunc(ActivationFunctionFactory::build(afunc)), m_AFuncID(afunc), m_Optimizer(optimizer),
+        m_Bias(bias),
         m_WeightsPrevChange(weightsN), m_BiasPrevChange(0.0),
-        m_Inputs(weightsN), m_Gradients(weightsN)
+        m_Gradients(weightsN)
     {
         std::mt19937 weightGenerator(seedGen->seed());
         std::uniform_real_distribution<double> weightDist(-0.5, 0.5);
@@ -31,12 +33,23 @@ public:
         }
     }
 
-    explicit Neuron(const std::vector<double>& weights, ActivationFunctions afunc, double learningRate,
-        double momentum, double bias = 0.0) :
-        m_AFunc(ActivationFunctionFactory::build(afunc)), m_AFuncID(afunc), m_LearningRate(learningRate),
-        m_Momentum(momentum), m_Bias(bias), m_Weights(weights),
+    explicit Neuron(const std::vector<double>& weights, ActivationFunctions afunc,
+        const std::shared_ptr<const SGDOptimizer>& optimizer, double bias = 0.0) :
+        m_AFunc(ActivationFunctionFactory::build(afunc)), m_AFuncID(afunc), m_Optimizer(optimizer),
+        m_Bias(bias), m_Weights(weights),
         m_WeightsPrevChange(weights.size()), m_BiasPrevChange(0.0),
-        m_Inputs(weights.size()), m_Gradients(weights.size())
+        m_Gradients(weights.size())
+    {
+
+    }
+
+    //! Creates a neuron of zero weights and bias, to be read with setParameter().
+    explicit Neuron(size_t weightsN, ActivationFunctions afunc,
+        const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        m_AFunc(ActivationFunctionFactory::build(afunc)), m_AFuncID(afunc), m_Optimizer(optimizer),
+        m_Weights(weightsN),
+        m_WeightsPrevChange(weightsN), m_BiasPrevChange(0.0),
+        m_Gradients(weightsN)
     {
 
     }
@@ -54,14 +67,10 @@ public:
         os << "  Bias: " << m_Bias << "\n";
     }
 
-    void updateLearningRate(double learningRate)
-    {
-        m_LearningRate = learningRate;
-    }
-
+    //! The inputs are not copied; they are held once by the layer and provided
+    //! again when propagating backward.
     double propagateForward(const std::vector<double>& inputs)
     {
-        m_Inputs = inputs;
         double total = 0.0;
 
         for (size_t n = 0; n < inputs.size(); n++)
@@ -90,7 +99,7 @@ public:
     }
 
     
-    void propagateBackwardOutputLayer(double target)
+    void propagateBackwardOutputLayer(double target, const std::vector<double>& inputs)
     {
         // dE/dw = dE/do * do/dn * dn/dw = Gradient
         // dE/do = -(t - o)
@@ -100,20 +109,20 @@ public:
         m_Delta = -(target - m_Output) * m_AFunc->calcDerivate(m_Output);
         m_NumberOfPasses += 1;
 
-        calcGradient();
+        calcGradient(inputs);
     }
 
-    void propagateBackwardClassificationLayer(double delta)
+    void propagateBackwardClassificationLayer(double delta, const std::vector<double>& inputs)
     {
         // For a classification layer the delta is calculated at layer level
         // because several neuron values are necessary to calculate it.
         m_Delta = delta;
         m_NumberOfPasses += 1;
 
-        calcGradient();
+        calcGradient(inputs);
     }
 
-    void propagateBackwardHiddenLayer(double sumWeightedDeltaNextLayer,
+    void propagateBackwardHiddenLayer(double sumWeightedDeltaNextLayer, const std::vector<double>& inputs,
         bool nextLayerIsDropout = false, double dropoutRate = 0.0, bool droppedNeuron = false)
     {
         if (nextLayerIsDropout)
@@ -134,9 +143,13 @@ public:
         m_Delta = sumWeightedDeltaNextLayer * m_AFunc->calcDerivate(m_Output);
         m_NumberOfPasses += 1;
 
-        calcGradient();
+        calcGradient(inputs);
     }
 
+    //! Applies the accumulated gradients to the weights and bias with momentum.
+    //! The update, the storage of the change for the next momentum and the reset
+    //! of the gradients are fused in a single pass over the weights so that the
+    //! loop is vectorized and each buffer is read and written only once.
     void updateWeights()
     {
         if (m_NumberOfPasses == 0)
@@ -144,22 +157,17 @@ public:
             return;
         }
 
-        double change = 0.0;
+        const double passes = static_cast<double>(m_NumberOfPasses);
+        const double learningRate = m_Optimizer->learningRate();
+        const double momentum = m_Optimizer->momentum();
 
-        for (size_t n = 0; n < m_Inputs.size(); n++)
-        {
-            // https://machinelearningmastery.com/gradient-descent-with-momentum-from-scratch/
-            // m_PrevChange[] initialized to 0.0
-            change = m_LearningRate * m_Gradients[n] / m_NumberOfPasses + m_Momentum * m_WeightsPrevChange[n];
-            m_Weights[n] -= change;
-            m_WeightsPrevChange[n] = change;
-        }
+        applyChanges(m_Weights.data(), m_WeightsPrevChange.data(), m_Gradients.data(),
+            m_Weights.size(), learningRate, momentum, passes);
 
-        change = m_LearningRate * m_BiasGradient / m_NumberOfPasses + m_Momentum * m_BiasPrevChange;
+        const double change = learningRate * m_BiasGradient / passes + momentum * m_BiasPrevChange;
         m_Bias -= change;
         m_BiasPrevChange = change;
 
-        std::fill(m_Gradients.begin(), m_Gradients.end(), 0.0);
         m_BiasGradient = 0.0;
         m_NumberOfPasses = 0;
     }
@@ -181,12 +189,60 @@ public:
         return m_Weights.size();
     }
 
-    void saveToFile(std::ofstream& output) const
+    //! Appends the weights then the bias of the neuron to @p params.
+    void copyParameters(std::vector<double>& params) const
+    {
+        params.insert(params.end(), m_Weights.cbegin(), m_Weights.cend());
+        params.push_back(m_Bias);
+    }
+
+    //! Sets parameter @p n in the order of copyParameters(): weight @p n, or the bias
+    //! if @p n is the number of weights.
+    void setParameter(size_t n, double value)
+    {
+        (n == m_Weights.size() ? m_Bias : m_Weights[n]) = value;
+    }
+
+    //! Reads the weights then the bias of the neuron from @p params at @p offset.
+    //! @returns Offset of the first parameter after the ones of the neuron.
+    size_t restoreParameters(const std::vector<double>& params, size_t offset)
+    {
+        std::copy(params.cbegin() + offset, params.cbegin() + offset + m_Weights.size(),
+            m_Weights.begin());
+        offset += m_Weights.size();
+        m_Bias = params[offset];
+
+        return offset + 1;
+    }
+
+    //! Appends the last change of each weight then of the bias, used by the momentum,
+    //! to @p state.
+    void copyOptimizerState(std::vector<double>& state) const
+    {
+        state.insert(state.end(), m_WeightsPrevChange.cbegin(), m_WeightsPrevChange.cend());
+        state.push_back(m_BiasPrevChange);
+    }
+
+    //! Reads the last changes saved by copyOptimizerState() from @p state at @p offset.
+    //! @returns Offset of the first value after the ones of the neuron.
+    size_t restoreOptimizerState(const std::vector<double>& state, size_t offset)
+    {
+        std::copy(state.cbegin() + offset, state.cbegin() + offset + m_WeightsPrevChange.size(),
+            m_WeightsPrevChange.begin());
+        offset += m_WeightsPrevChange.size();
+        m_BiasPrevChange = state[offset];
+
+        return offset + 1;
+    }
+
+    //! @param inputs Inputs of the layer, saved with each neuron to keep the file format.
+    //!   Zeros are saved instead when they are empty, i.e. released by the layer.
+    void saveToFile(std::ofstream& output, const std::vector<double>& inputs) const
     {
         output << "[NeuronBegin] \n"
             << "  ActivationFunction: " << static_cast<int>(m_AFuncID) << "\n"
-            << "  Momentum: " << m_Momentum << "\n"
-            << "  LearningRate: " << m_LearningRate << "\n"
+            << "  Momentum: " << m_Optimizer->momentum() << "\n"
+            << "  LearningRate: " << m_Optimizer->learningRate() << "\n"
             << "  Connections: " << m_Weights.size() << "\n"
             << "  Weights: ";
 
@@ -210,9 +266,9 @@ public:
         output << "\n"
             << "  Inputs: ";
 
-        for (const auto& input : m_Inputs)
+        for (size_t i = 0; i < m_Weights.size(); i++)
         {
-            output << input << " ";
+            output << (i < inputs.size() ? inputs[i] : 0.0) << " ";
         }
 
         output << "\n"
@@ -232,7 +288,11 @@ public:
             << "[NeuronEnd] \n";
     }
 
-    static Neuron readFromFile(std::ifstream& file)
+    //! Reads a neuron saved with @ref saveToFile(std::ofstream&, const std::vector<double>&) const.
+    //! The momentum and learning rate saved with the neuron are those of @p optimizer.
+    //! @param inputs Resized and filled with the inputs saved with the neuron.
+    static Neuron readFromFile(std::ifstream& file, const std::shared_ptr<const SGDOptimizer>& optimizer,
+        std::vector<double>& inputs)
     {
         std::string tag;
 
@@ -259,8 +319,7 @@ public:
 
         file >> tag >> bias;
 
-        Neuron neuron(neuronWeights, static_cast<ActivationFunctions>(afunc),
-            learningRate, momentum, bias);
+        Neuron neuron(neuronWeights, static_cast<ActivationFunctions>(afunc), optimizer, bias);
 
         Utils::checkTag(file, tag, "WeightsPrevChange:");
 
@@ -272,10 +331,11 @@ public:
         file >> tag >> neuron.m_BiasPrevChange;
 
         Utils::checkTag(file, tag, "Inputs:");
+        inputs.resize(size);
 
         for (size_t i = 0; i < size; i++)
         {
-            file >> neuron.m_Inputs[i];
+            file >> inputs[i];
         }
 
         Utils::checkTag(file, tag, "Gradients:");
@@ -299,27 +359,42 @@ public:
 private:
     const std::shared_ptr<ActivationFunction> m_AFunc;
     const ActivationFunctions m_AFuncID;
-    double m_LearningRate = 0.0;
-    const double m_Momentum = 0.0;
+    std::shared_ptr<const SGDOptimizer> m_Optimizer;
     double m_Bias = 0.0;
     std::vector<double> m_Weights;
     std::vector<double> m_WeightsPrevChange;
     double m_BiasPrevChange = 0.0;
 
     double m_Output = 0.0;
-    std::vector<double> m_Inputs;
     double m_Delta = 0.0;
     size_t m_NumberOfPasses = 0;
     std::vector<double> m_Gradients;
     double m_BiasGradient = 0.0;
 
-    void calcGradient()
+    //! Fused momentum update kernel. Pointers are declared as non-aliasing so that
+    //! the compiler vectorizes the loop without runtime overlap checks.
+    static void applyChanges(double* YANNL_RESTRICT weights, double* YANNL_RESTRICT prevChanges,
+        double* YANNL_RESTRICT gradients, size_t weightsN, double learningRate, double momentum,
+        double passes)
     {
-        for (size_t n = 0; n < m_Inputs.size(); n++)
+        for (size_t n = 0; n < weightsN; n++)
+        {
+            // https://machinelearningmastery.com/gradient-descent-with-momentum-from-scratch/
+            // prevChanges[] initialized to 0.0
+            const double change = learningRate * gradients[n] / passes + momentum * prevChanges[n];
+            weights[n] -= change;
+            prevChanges[n] = change;
+            gradients[n] = 0.0;
+        }
+    }
+
+    void calcGradient(const std::vector<double>& inputs)
+    {
+        for (size_t n = 0; n < inputs.size(); n++)
         {
             // dn/dw = i
             // Gradient = delta * dn/dw = delta * i
-            m_Gradients[n] += m_Delta * m_Inputs[n];
+            m_Gradients[n] += m_Delta * inputs[n];
         }
 
         m_BiasGradient += m_Delta * 1.0; // Bias gradient
@@ -5,7 +5,9 @@
 #ifndef YANNL_NEURON_LAYER_H
 #define YANNL_NEURON_LAYER_H
 
+#include "DropoutMask.h"
 #include "Neuron.h"
+#include "TrainingObserver.h"
 #include <numeric>  // std::accumulate
 
 #include <algorithm> // std::for_each in Code::Blocks
@@ -17,7 +19,37 @@ enum class LayerType
     Hidden = 0,
     Dropout,
     OutputClassification,
-    OutputRegression
+    OutputRegression,
+    Conv2D,
+    MaxPool,
+    AvgPool
+};
+
+//! @returns Name of the layer type, e.g. to print or save a network.
+inline const char* layerTypeName(LayerType type)
+{
+    static const char* const names[7] = { "Hidden", "Dropout", "OutputClassification", "OutputRegression",
+        "Conv2D", "MaxPool", "AvgPool" };
+    return names[static_cast<size_t>(type)];
+}
+
+//! Floating-point operations and bytes read or written by a layer, see NeuronLayer::cost().
+struct LayerCost
+{
+    double flops = 0.0;
+    double bytes = 0.0;
+};
+
+//! Bytes held by a layer, see NeuronLayer::memory().
+struct LayerMemory
+{
+    //! Weights and biases.
+    size_t parameterBytes = 0;
+    //! Buffers used only for training: previous changes of the momentum, gradients,
+    //! inputs kept for the backward propagation, dropout mask.
+    size_t trainingBytes = 0;
+    //! Outputs and deltas of one sample.
+    size_t activationBytes = 0;
 };
 
 class NeuronLayer
@@ -26,7 +58,6 @@ public:
     virtual size_t size() const = 0;
     virtual LayerType type() const = 0;
     virtual void inspect(std::ostream& os, size_t& weightN) const = 0;
-    virtual void updateLearningRate(double learningRate) = 0;
     virtual std::vector<double> propagateForward(const std::vector<double>& inputs, bool ignoreDropout) = 0;
     virtual size_t probableClass() const = 0;
     virtual double calcError(const std::vector<double>& expectedOutputs) const = 0;
@@ -36,47 +67,103 @@ public:
     virtual bool droppedNeuron(size_t neuronN) const = 0;
     virtual bool dropoutLayer() const = 0;
     virtual double dropoutRate() const = 0;
-    virtual void updateWeights() = 0;
+    //! @returns Neurons of the previous layer kept by a dropout layer; nullptr otherwise.
+    virtual const DropoutMask* dropoutMask() const = 0;
+    virtual void updateWeights(size_t threadsN) = 0;
+    virtual size_t parametersCount() const = 0;
+    virtual void copyParameters(std::vector<double>& params) const = 0;
+    virtual size_t restoreParameters(const std::vector<double>& params, size_t offset) = 0;
     virtual void saveToFile(std::ofstream& output) const = 0;
+
+    // Training state, see NeuralNetwork::copyTrainingState()
+
+    //! Appends the state of the optimizer, in the same order as the parameters, to @p state.
+    virtual void copyOptimizerState(std::vector<double>& state) const = 0;
+    virtual size_t restoreOptimizerState(const std::vector<double>& state, size_t offset) = 0;
+    //! @returns State of the random generator of the layer; empty if it has none.
+    virtual std::string generatorState() const = 0;
+    virtual void restoreGeneratorState(const std::string& state) = 0;
+
+    // Activation checkpointing, see NeuralNetwork::setActivationCheckpoints(size_t)
+
+    //! Tells whether the layer keeps its inputs after propagating forward.
+    virtual void keepInputs(bool keep) = 0;
+    //! @returns Inputs stored by the last forward propagation or replay; empty if none.
+    virtual const std::vector<double>& storedInputs() const = 0;
+    //! Frees the inputs stored by a replay if the layer does not keep them.
+    virtual void releaseInputs() = 0;
+    //! Propagates forward again without drawing anything random so that the outputs
+    //! are those of the last forward propagation. Stores the inputs if the layer
+    //! needs them to propagate backward.
+    virtual std::vector<double> replayForward(const std::vector<double>& inputs) = 0;
+
+    //! @returns Estimated cost of one sample for the forward and backward phases, of one
+    //!   call for the update phase. A multiply-add counts as two operations and an
+    //!   activation as one. See LayerProfiler.
+    //! @param summedN Number of neurons of the next layer whose weighted deltas this layer
+    //!   sums when propagating backward: the size of the next dense layer; 0 for the
+    //!   output layer or before a dropout layer, which has summed them already.
+    virtual LayerCost cost(TrainingPhase phase, size_t summedN) const = 0;
+    //! @returns Bytes of the buffers of the layer, whatever their current size: e.g. the
+    //!   inputs are counted if the layer keeps them even before propagating forward.
+    virtual LayerMemory memory() const = 0;
 };
 
 class DenseLayer : public NeuronLayer // public inheritance to be able to use std::make_shared
 {
 public:
+    //! @param threadsN Maximum number of threads drawing the weights of wide layers with
+    //!   a Philox generator, e.g. NeuralNetwork::threadCount(); the weights do not depend on it.
     explicit DenseLayer(size_t neuronsN, size_t prevLayerNeuronsN,
-        ActivationFunctions afunc, double learningRate, double momentum,
-        const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0) :
-        m_AFunc(afunc), m_LearningRate(learningRate), m_Momentum(momentum)
+        ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer,
+        const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0, size_t threadsN = 1) :
+        m_AFunc(afunc), m_Optimizer(optimizer)
+    {
+        if (seedGen->engine() == RandomEngine::Philox)
+        {
+            addPhiloxNeurons(neuronsN, prevLayerNeuronsN, seedGen->key(), bias, threadsN);
+            return;
+        }
+
+        for (size_t i = 0; i < neuronsN; i++)
+        {
+            m_Neurons.push_back(Neuron(prevLayerNeuronsN, afunc, optimizer, seedGen, bias));
+        }
+    }
+
+    //! Creates a layer of zero weights and biases, to be read with setParameter().
+    explicit DenseLayer(size_t neuronsN, size_t prevLayerNeuronsN,
+        ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        m_AFunc(afunc), m_Optimizer(optimizer)
     {
+        m_Neurons.reserve(neuronsN);
+
         for (size_t i = 0; i < neuronsN; i++)
         {
-            m_Neurons.push_back(Neuron(prevLayerNeuronsN, afunc, learningRate,
-                momentum, seedGen, bias));
+            m_Neurons.push_back(Neuron(prevLayerNeuronsN, afunc, optimizer));
         }
     }
 
     explicit DenseLayer(const std::vector<std::vector<double>>& layerWeights,
-        ActivationFunctions afunc,  double learningRate, double momentum,
+        ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer,
         const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0) :
-        m_AFunc(afunc), m_LearningRate(learningRate), m_Momentum(momentum)
+        m_AFunc(afunc), m_Optimizer(optimizer)
     {
         std::for_each(layerWeights.cbegin(), layerWeights.cend(),
             [&](const std::vector<double>& neuronWeigths)
             {
-                m_Neurons.push_back(Neuron(neuronWeigths, afunc, learningRate,
-                    momentum, bias));
+                m_Neurons.push_back(Neuron(neuronWeigths, afunc, optimizer, bias));
             });
     }
 
     explicit DenseLayer(const std::vector<std::vector<double>>& layerWeights,
         const std::vector<double>& layerBias, ActivationFunctions afunc,
-        double learningRate, double momentum, const std::shared_ptr<SeedGenerator>& seedGen) :
-        m_AFunc(afunc), m_LearningRate(learningRate), m_Momentum(momentum)
+        const std::shared_ptr<const SGDOptimizer>& optimizer, const std::shared_ptr<SeedGenerator>& seedGen) :
+        m_AFunc(afunc), m_Optimizer(optimizer)
     {
         for (size_t n = 0; n < layerWeights.size(); n++)
         {
-            m_Neurons.push_back(Neuron(layerWeights[n], afunc, learningRate,
-                momentum, layerBias[n]));
+            m_Neurons.push_back(Neuron(layerWeights[n], afunc, optimizer, layerBias[n]));
         }
     }
 
@@ -87,6 +174,11 @@ public:
         return m_Neurons.size();
     }
 
+    ActivationFunctions activationFunction() const
+    {
+        return m_AFunc;
+    }
+
     void inspect(std::ostream& os, size_t& weightN) const override
     {
         os << "Neurons: " << m_Neurons.size() << " activation: "
@@ -99,17 +191,6 @@ public:
         }
     }
 
-    void updateLearningRate(double learningRate) override
-    {
-        m_LearningRate = learningRate;
-
-        std::for_each(m_Neurons.begin(), m_Neurons.end(),
-            [&](Neuron& neuron)
-            {
-                neuron.updateLearningRate(learningRate);
-            });
-    }
-
     //! Propagates the input forward and calculates the outputs. To be specialized
     //! for output classification layer as the outputs are dependent of all the inputs.
     //! @param inputs Vector of inputs.
@@ -117,6 +198,11 @@ public:
     //! @returns Vector of outputs.
     std::vector<double> propagateForward(const std::vector<double>& inputs, bool ignoreDropout) override
     {
+        if (m_KeepInputs)
+        {
+            m_Inputs = inputs;
+        }
+
         std::vector<double> outputs;
 
         std::for_each(m_Neurons.begin(), m_Neurons.end(),
@@ -158,21 +244,24 @@ public:
     {
         for (size_t n = 0; n < m_Neurons.size(); n++)
         {
-            m_Neurons[n].propagateBackwardOutputLayer(expectedOutputs[n]);
+            m_Neurons[n].propagateBackwardOutputLayer(expectedOutputs[n], m_Inputs);
         }
     }
 
     void propagateBackwardHiddenLayer(const NeuronLayer& nextLayer) override
     {
+        // Dropout of the next layer is fused in the loop: its mask and rate are
+        // fetched once instead of being queried for each neuron.
+        const DropoutMask* mask = nextLayer.dropoutMask();
+        const double rate = nextLayer.dropoutRate();
+
         for (size_t n = 0; n < m_Neurons.size(); n++)
         {
             // dE/do = Sum(deltaOutputNeurons * w)
             double sum = nextLayer.sumDelta(n);
 
-            m_Neurons[n].propagateBackwardHiddenLayer(sum,
-                nextLayer.dropoutLayer(),
-                nextLayer.dropoutRate(),
-                nextLayer.droppedNeuron(n));
+            m_Neurons[n].propagateBackwardHiddenLayer(sum, m_Inputs,
+                mask != nullptr, rate, mask != nullptr && !mask->kept(n));
         }
     }
 
@@ -208,12 +297,164 @@ public:
         return 0.0;
     }
 
-    void updateWeights() override
+    const DropoutMask* dropoutMask() const override
+    {
+        return nullptr;
+    }
+
+    //! Sets parameter @p n in the order of copyParameters(), e.g. while decoding them,
+    //! without an intermediate copy.
+    void setParameter(size_t n, double value)
+    {
+        const size_t paramsN = m_Neurons[0].inputSize() + 1;
+        m_Neurons[n / paramsN].setParameter(n % paramsN, value);
+    }
+
+    //! Updates the weights of all the neurons of the layer. Neurons are independent
+    //! from each other so wide layers are split across @p threadsN threads.
+    //! @param threadsN Maximum number of threads to use for the update.
+    void updateWeights(size_t threadsN) override
+    {
+        if (m_Neurons.empty() || m_Neurons.size() * m_Neurons[0].inputSize() < kParallelUpdateMinWeights)
+        {
+            threadsN = 1;
+        }
+
+        Utils::parallelFor(m_Neurons.size(), threadsN,
+            [this](size_t begin, size_t end)
+            {
+                for (size_t n = begin; n < end; n++)
+                {
+                    m_Neurons[n].updateWeights();
+                }
+            });
+    }
+
+    //! @returns Number of weights and biases of the layer.
+    size_t parametersCount() const override
+    {
+        return m_Neurons.empty() ? 0 : m_Neurons.size() * (m_Neurons[0].inputSize() + 1);
+    }
+
+    LayerCost cost(TrainingPhase phase, size_t summedN) const override
+    {
+        const double neuronsN = static_cast<double>(m_Neurons.size());
+        const double inputsN = m_Neurons.empty() ? 0.0 : static_cast<double>(m_Neurons[0].inputSize());
+        const double paramsN = static_cast<double>(parametersCount());
+        LayerCost cost;
+
+        switch (phase)
+        {
+        case TrainingPhase::Forward:
+            // Weighted sums, activations; weights and inputs read, outputs written
+            cost.flops = 2.0 * paramsN + neuronsN;
+            cost.bytes = sizeof(double) * (paramsN + inputsN + neuronsN);
+            break;
+        case TrainingPhase::Backward:
+            // Sums of the deltas of the next layer, deltas, gradients accumulated
+            cost.flops = 2.0 * neuronsN * summedN + 2.0 * neuronsN + 2.0 * paramsN;
+            cost.bytes = sizeof(double) * (2.0 * neuronsN * summedN + 2.0 * paramsN + inputsN);
+            break;
+        case TrainingPhase::Update:
+            // Change with momentum applied; weights, changes and gradients read and written
+            cost.flops = 5.0 * paramsN;
+            cost.bytes = sizeof(double) * 6.0 * paramsN;
+            break;
+        default:
+            break;
+        }
+
+        return cost;
+    }
+
+    LayerMemory memory() const override
+    {
+        const size_t paramsN = parametersCount();
+        const size_t inputsN = m_Neurons.empty() ? 0 : m_Neurons[0].inputSize();
+        LayerMemory memory;
+        memory.parameterBytes = sizeof(double) * paramsN;
+        // Previous change and gradient of each weight and bias
+        memory.trainingBytes = sizeof(double) * (2 * paramsN + (m_KeepInputs ? inputsN : 0));
+        // Output and delta of each neuron
+        memory.activationBytes = sizeof(double) * 2 * m_Neurons.size();
+
+        return memory;
+    }
+
+    void copyParameters(std::vector<double>& params) const override
+    {
+        for (const Neuron& neuron : m_Neurons)
+        {
+            neuron.copyParameters(params);
+        }
+    }
+
+    size_t restoreParameters(const std::vector<double>& params, size_t offset) override
+    {
+        for (Neuron& neuron : m_Neurons)
+        {
+            offset = neuron.restoreParameters(params, offset);
+        }
+
+        return offset;
+    }
+
+    void copyOptimizerState(std::vector<double>& state) const override
+    {
+        for (const Neuron& neuron : m_Neurons)
+        {
+            neuron.copyOptimizerState(state);
+        }
+    }
+
+    size_t restoreOptimizerState(const std::vector<double>& state, size_t offset) override
     {
         for (Neuron& neuron : m_Neurons)
         {
-            neuron.updateWeights();
+            offset = neuron.restoreOptimizerState(state, offset);
         }
+
+        return offset;
+    }
+
+    std::string generatorState() const override
+    {
+        return std::string();
+    }
+
+    void restoreGeneratorState(const std::string& state) override
+    {
+
+    }
+
+    void keepInputs(bool keep) override
+    {
+        m_KeepInputs = keep;
+        releaseInputs();
+    }
+
+    const std::vector<double>& storedInputs() const override
+    {
+        return m_Inputs;
+    }
+
+    void releaseInputs() override
+    {
+        if (!m_KeepInputs)
+        {
+            m_Inputs.clear();
+            m_Inputs.shrink_to_fit();
+        }
+    }
+
+    std::vector<double> replayForward(const std::vector<double>& inputs) override
+    {
+        const bool keep = m_KeepInputs;
+        m_KeepInputs = true;
+        std::vector<double> outputs = propagateForward(inputs, false);
+        m_KeepInputs = keep;
+
+        return outputs;
     }
 
     void saveToFile(std::ofstream& output, LayerType layerType,
@@ -222,8 +463,8 @@ public:
         output << "LayerType: " << static_cast<int>(layerType) << "\n"
             << "[LayerBegin] \n"
             << "ActivationFunction: " << static_cast<int>(m_AFunc) << "\n"
-            << "Momentum: " << m_Momentum << "\n"
-            << "LearningRate: " << m_LearningRate << "\n"
+            << "Momentum: " << m_Optimizer->momentum() << "\n"
+            << "LearningRate: " << m_Optimizer->learningRate() << "\n"
             << "InputSize: ";
 
         if (m_Neurons.size() > 0)
@@ -252,48 +493,86 @@ public:
 
         for (const Neuron& neuron : m_Neurons)
         {
-            neuron.saveToFile(output);
+            neuron.saveToFile(output, m_Inputs);
         }
 
         output << "[LayerEnd] \n\n";
     }
 
 protected:
+    //! Below this number of weights on the layer, starting threads costs more
+    //! than updating the weights on the calling thread.
+    static constexpr size_t kParallelUpdateMinWeights = 1 << 16;
+
     const ActivationFunctions m_AFunc;
-    double m_LearningRate = 0.0;
-    const double m_Momentum = 0.0;
+    const std::shared_ptr<const SGDOptimizer> m_Optimizer;
     std::vector<Neuron> m_Neurons;
 
-    explicit DenseLayer(ActivationFunctions afunc, double learningRate, double momentum) :
-        m_AFunc(afunc), m_LearningRate(learningRate), m_Momentum(momentum)
+    //! Inputs of the last forward propagation, shared by all the neurons to
+    //! calculate their gradients.
+    std::vector<double> m_Inputs;
+    bool m_KeepInputs = true;
+
+    explicit DenseLayer(ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        m_AFunc(afunc), m_Optimizer(optimizer)
     {
 
     }
+
+    //! Draws the weights of all the neurons in bulk: weight w of neuron n is value w
+    //! of stream n, so the weights are split across threads and still only depend on @p key.
+    void addPhiloxNeurons(size_t neuronsN, size_t prevLayerNeuronsN, uint64_t key, double bias, size_t threadsN)
+    {
+        const Philox4x32 philox(key);
+        std::vector<std::vector<double>> weights(neuronsN, std::vector<double>(prevLayerNeuronsN));
+
+        Utils::parallelFor(neuronsN, neuronsN * prevLayerNeuronsN < kParallelUpdateMinWeights ? 1 : threadsN,
+            [&](size_t begin, size_t end)
+            {
+                for (size_t n = begin; n < end; n++)
+                {
+                    philox.fillUniform(weights[n].data(), 0, prevLayerNeuronsN, -0.5, 0.5, n);
+                }
+            });
+
+        for (size_t n = 0; n < neuronsN; n++)
+        {
+            m_Neurons.push_back(Neuron(weights[n], m_AFunc, m_Optimizer, bias));
+        }
+    }
 };
 
 class HiddenLayer : public DenseLayer // public inheritance to be able to use std::make_shared
 {
 public:
     explicit HiddenLayer(size_t neuronsN, size_t prevLayerNeuronsN,
-        ActivationFunctions afunc,  double learningRate, double momentum,
-        const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0) :
-        DenseLayer(neuronsN, prevLayerNeuronsN, afunc, learningRate, momentum, seedGen, bias)
+        ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer,
+        const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0, size_t threadsN = 1) :
+        DenseLayer(neuronsN, prevLayerNeuronsN, afunc, optimizer, seedGen, bias, threadsN)
+    {
+
+    }
+
+    //! Creates a layer of zero weights and biases, to be read with setParameter().
+    explicit HiddenLayer(size_t neuronsN, size_t prevLayerNeuronsN,
+        ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        DenseLayer(neuronsN, prevLayerNeuronsN, afunc, optimizer)
     {
 
     }
 
     explicit HiddenLayer(const std::vector<std::vector<double>>& layerWeights,
-        ActivationFunctions afunc, double learningRate, double momentum,
+        ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer,
         const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0) :
-        DenseLayer(layerWeights, afunc, learningRate, momentum, seedGen, bias)
+        DenseLayer(layerWeights, afunc, optimizer, seedGen, bias)
     {
 
     }
 
     explicit HiddenLayer(const std::vector<std::vector<double>>& layerWeights,
         const std::vector<double>& layerBias, ActivationFunctions afunc,
-        double learningRate, double momentum, const std::shared_ptr<SeedGenerator>& seedGen) :
-        DenseLayer(layerWeights, layerBias, afunc, learningRate, momentum, seedGen)
+        const std::shared_ptr<const SGDOptimizer>& optimizer, const std::shared_ptr<SeedGenerator>& seedGen) :
+        DenseLayer(layerWeights, layerBias, afunc, optimizer, seedGen)
     {
 
     }
@@ -325,7 +604,7 @@ public:
         DenseLayer::saveToFile(output, LayerType::Hidden);
     }
 
-    static HiddenLayer readFromFile(std::ifstream& file)
+    static HiddenLayer readFromFile(std::ifstream& file, const std::shared_ptr<const SGDOptimizer>& optimizer)
     {
         std::string tag;
 
@@ -342,11 +621,11 @@ public:
         file >> tag >> inputN;
         file >> tag >> outputN;
 
-        HiddenLayer layer(static_cast<ActivationFunctions>(afunc), learningRate, momentum);
+        HiddenLayer layer(static_cast<ActivationFunctions>(afunc), optimizer);
 
         for (size_t n = 0; n < outputN; n++)
         {
-            layer.m_Neurons.push_back(Neuron::readFromFile(file));
+            layer.m_Neurons.push_back(Neuron::readFromFile(file, optimizer, layer.m_Inputs));
         }
 
         Utils::checkTag(file, tag, "[LayerEnd]");
@@ -355,8 +634,8 @@ public:
     }
 
 protected:
-    explicit HiddenLayer(ActivationFunctions afunc, double learningRate, double momentum) :
-        DenseLayer(afunc, learningRate, momentum)
+    explicit HiddenLayer(ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        DenseLayer(afunc, optimizer)
     {
 
     }
@@ -367,16 +646,17 @@ class DropoutLayer : public NeuronLayer // public inheritance to be able to use
 {
 public:
     explicit DropoutLayer(double rate, size_t size, const std::shared_ptr<SeedGenerator>& seedGen) :
-        m_Neurons(size), m_DropoutRate(rate), m_SumDeltaNextLayer(size),
-        m_Generator(seedGen->seed()), m_Dist(0.0, 1.0)
+        m_Mask(size), m_DropoutRate(rate), m_SumDeltaNextLayer(size),
+        m_Generator(seedGen->seed()), m_Dist(0.0, 1.0), m_Engine(seedGen->engine())
 
     {
 
     }
 
-    explicit DropoutLayer(double rate, size_t size, const std::mt19937& generator) :
-        m_Neurons(size), m_DropoutRate(rate), m_SumDeltaNextLayer(size),
-        m_Generator(generator), m_Dist(0.0, 1.0)
+    explicit DropoutLayer(double rate, size_t size, const std::mt19937& generator,
+        RandomEngine engine = RandomEngine::MersenneTwister) :
+        m_Mask(size), m_DropoutRate(rate), m_SumDeltaNextLayer(size),
+        m_Generator(generator), m_Dist(0.0, 1.0), m_Engine(engine)
 
     {
 
@@ -386,7 +666,7 @@ public:
 
     size_t size() const override
     {
-        return m_Neurons.size();
+        return m_Mask.size();
     }
 
     LayerType type() const override
@@ -396,36 +676,38 @@ public:
 
     void inspect(std::ostream& os, size_t& weightN) const override
     {
-        os << "Neurons: " << m_Neurons.size() << "\n"
+        os << "Neurons: " << m_Mask.size() << "\n"
             << "Dropout layer of rate " << m_DropoutRate << "\n";
     }
 
-    void updateLearningRate(double learningRate) override
+    std::vector<double> propagateForward(const std::vector<double>& inputs, bool ignoreDropout) override
     {
+        std::vector<double> outputs(inputs);
+        propagateForwardInPlace(outputs, ignoreDropout);
 
+        return outputs;
     }
 
-    std::vector<double> propagateForward(const std::vector<double>& inputs, bool ignoreDropout) override
+    //! Applies the dropout directly on the outputs of the previous layer, as an epilogue
+    //! of its forward propagation, without allocating a new vector of outputs.
+    //! @param values Outputs of the previous layer, replaced by the outputs of this layer.
+    //! @param ignoreDropout Tells to ignore dropout during testing or validation.
+    void propagateForwardInPlace(std::vector<double>& values, bool ignoreDropout)
     {
-        std::vector<double> outputs;
-
-        for (size_t n = 0; n < m_Neurons.size(); n++)
+        if (m_KeepInputs)
         {
-            if (ignoreDropout || m_Dist(m_Generator) >= m_DropoutRate)
-            {
-                // Keep neuron from previous layer and rescale output
-                m_Neurons[n] = true;
-                outputs.push_back(inputs[n] / (1 - m_DropoutRate));
-            }
-            else
-            {
-                // Deactivate neuron from previous layer
-                m_Neurons[n] = false;
-                outputs.push_back(0.0);
-            }
+            m_Inputs = values;
         }
 
-        return outputs;
+        drawMask(ignoreDropout);
+
+        // Outputs are rescaled during training only (inverted dropout) so the layer
+        // is the identity when dropout is ignored.
+        if (!ignoreDropout)
+        {
+            // Kept neurons from previous layer are rescaled, others are deactivated
+            m_Mask.apply(values.data(), values.data(), m_DropoutRate);
+        }
     }
 
     size_t probableClass() const override
@@ -458,7 +740,7 @@ public:
         // Nothing to propagate backward.
         // Just calculate the sum of next layer delta
 
-        for (size_t n = 0; n < m_Neurons.size(); n++)
+        for (size_t n = 0; n < m_Mask.size(); n++)
         {
             m_SumDeltaNextLayer[n] = nextLayer.sumDelta(n);
         }
@@ -471,7 +753,7 @@ public:
 
     bool droppedNeuron(size_t neuronN) const override
     {
-        return !m_Neurons[neuronN];
+        return !m_Mask.kept(neuronN);
     }
 
     bool dropoutLayer() const override
@@ -484,24 +766,138 @@ public:
         return m_DropoutRate;
     }
 
-    void updateWeights() override
+    const DropoutMask* dropoutMask() const override
+    {
+        return &m_Mask;
+    }
+
+    void updateWeights(size_t threadsN) override
+    {
+
+    }
+
+    size_t parametersCount() const override
+    {
+        return 0;
+    }
+
+    LayerCost cost(TrainingPhase phase, size_t summedN) const override
+    {
+        const double size = static_cast<double>(m_Mask.size());
+        LayerCost cost;
+
+        if (phase == TrainingPhase::Forward)
+        {
+            // Outputs of the previous layer rescaled in place
+            cost.flops = size;
+            cost.bytes = sizeof(double) * 2.0 * size;
+        }
+        else if (phase == TrainingPhase::Backward)
+        {
+            cost.flops = 2.0 * size * summedN;
+            cost.bytes = sizeof(double) * (2.0 * size * summedN + size);
+        }
+
+        return cost;
+    }
+
+    LayerMemory memory() const override
+    {
+        // Dropout is applied in place: the mask and the sums of the deltas of the next
+        // layer are only used for training.
+        LayerMemory memory;
+        memory.trainingBytes = m_Mask.bytes()
+            + sizeof(double) * (m_SumDeltaNextLayer.size() + (m_KeepInputs ? m_Mask.size() : 0));
+
+        return memory;
+    }
+
+    void copyParameters(std::vector<double>& params) const override
+    {
+
+    }
+
+    size_t restoreParameters(const std::vector<double>& params, size_t offset) override
+    {
+        return offset;
+    }
+
+    void copyOptimizerState(std::vector<double>& state) const override
+    {
+
+    }
+
+    size_t restoreOptimizerState(const std::vector<double>& state, size_t offset) override
+    {
+        return offset;
+    }
+
+    //! @returns State of the generator drawing the masks, so that a resumed training
+    //!   draws the same masks.
+    std::string generatorState() const override
+    {
+        std::ostringstream os;
+        os << m_Generator;
+
+        return os.str();
+    }
+
+    void restoreGeneratorState(const std::string& state) override
+    {
+        std::istringstream is(state);
+        is >> m_Generator;
+
+        if (!is)
+        {
+            throw std::domain_error("[Dropout layer] Generator state cannot be read.");
+        }
+    }
+
+    void keepInputs(bool keep) override
+    {
+        m_KeepInputs = keep;
+        releaseInputs();
+    }
+
+    const std::vector<double>& storedInputs() const override
+    {
+        return m_Inputs;
+    }
+
+    void releaseInputs() override
     {
+        if (!m_KeepInputs)
+        {
+            m_Inputs.clear();
+            m_Inputs.shrink_to_fit();
+        }
+    }
+
+    //! Applies the mask of the last forward propagation again.
+    std::vector<double> replayForward(const std::vector<double>& inputs) override
+    {
+        std::vector<double> outputs(m_Mask.size());
+        m_Mask.apply(inputs.data(), outputs.data(), m_DropoutRate);
 
+        return outputs;
     }
 
     void saveToFile(std::ofstream& output) const override
     {
         output << "LayerType: " << static_cast<int>(LayerType::Dropout) << "\n"
             << "[LayerBegin] \n"
-            << "Size: " << m_Neurons.size() << "\n"
+            << "Size: " << m_Mask.size() << "\n"
             << "DropoutRate: " << m_DropoutRate << "\n"
-            << "Generator: " << m_Generator << "\n";
+            << "Generator: ";
+
+        SeedGenerator::writeEngine(output, m_Engine);
+        output << m_Generator << "\n";
 
         output << "Activations: ";
 
-        for (const auto& val : m_Neurons)
+        for (size_t n = 0; n < m_Mask.size(); n++)
         {
-            output << val << " ";
+            output << m_Mask.kept(n) << " ";
         }
 
         output << "\n"
@@ -527,9 +923,11 @@ public:
         std::mt19937 generator;
         file >> tag >> sizeN;
         file >> tag >> rate;
-        file >> tag >> generator;
+        file >> tag;
+        const RandomEngine engine = SeedGenerator::readEngine(file);
+        file >> generator;
 
-        DropoutLayer layer(rate, sizeN, generator);
+        DropoutLayer layer(rate, sizeN, generator, engine);
 
         Utils::checkTag(file, tag, "Activations:");
         int a;
@@ -537,7 +935,7 @@ public:
         for (size_t n = 0; n < sizeN; n++)
         {
             file >> a;
-            layer.m_Neurons[n] = a;
+            layer.m_Mask.set(n, a != 0);
         }
 
         Utils::checkTag(file, tag, "Deltas:");
@@ -553,12 +951,45 @@ public:
     }
 
 private:
-    std::vector<bool> m_Neurons;
+    DropoutMask m_Mask;
     const double m_DropoutRate = 0.0;
     std::vector<double> m_SumDeltaNextLayer;
 
     std::mt19937 m_Generator;
     std::uniform_real_distribution<double> m_Dist;
+    const RandomEngine m_Engine;
+
+    //! Only kept as a checkpoint to replay the following layers; not needed to propagate backward.
+    std::vector<double> m_Inputs;
+    bool m_KeepInputs = false;
+
+    //! Buffer of the uniform values drawn in bulk with the counter-based engine.
+    std::vector<double> m_Uniforms;
+
+    //! Draws which neurons of the previous layer are kept. With the counter-based engine
+    //! the generator of the layer is drawn once to key a Philox generator, and the
+    //! value of each unit only depends on its index.
+    void drawMask(bool ignoreDropout)
+    {
+        if (ignoreDropout)
+        {
+            m_Mask.keepAll();
+        }
+        else if (m_Engine == RandomEngine::Philox)
+        {
+            const Philox4x32 philox(m_Generator());
+            m_Uniforms.resize(m_Mask.size());
+            philox.fillUniform(m_Uniforms.data(), 0, m_Uniforms.size(), 0.0, 1.0);
+            m_Mask.draw(m_Uniforms.data(), m_DropoutRate);
+        }
+        else
+        {
+            for (size_t n = 0; n < m_Mask.size(); n++)
+            {
+                m_Mask.set(n, m_Dist(m_Generator) >= m_DropoutRate);
+            }
+        }
+    }
 };
 
 
@@ -566,28 +997,37 @@ class OutputClassificationLayer : public DenseLayer // public inheritance to be
 {
 public:
     explicit OutputClassificationLayer(size_t neuronsN, size_t prevLayerNeuronsN,
-        double learningRate, double momentum,
-        const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0) :
-        DenseLayer(neuronsN, prevLayerNeuronsN, ActivationFunctions::Identity, learningRate,
-            momentum, seedGen, bias), m_Outputs(neuronsN)
+        const std::shared_ptr<const SGDOptimizer>& optimizer,
+        const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0, size_t threadsN = 1) :
+        DenseLayer(neuronsN, prevLayerNeuronsN, ActivationFunctions::Identity, optimizer,
+            seedGen, bias, threadsN), m_Outputs(neuronsN)
+    {
+
+    }
+
+    //! Creates a layer of zero weights and biases, to be read with setParameter().
+    explicit OutputClassificationLayer(size_t neuronsN, size_t prevLayerNeuronsN,
+        const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        DenseLayer(neuronsN, prevLayerNeuronsN, ActivationFunctions::Identity, optimizer),
+        m_Outputs(neuronsN)
     {
 
     }
 
     explicit OutputClassificationLayer(const std::vector<std::vector<double>>& layerWeights,
-        double learningRate, double momentum,
+        const std::shared_ptr<const SGDOptimizer>& optimizer,
         const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0) :
-        DenseLayer(layerWeights, ActivationFunctions::Identity, learningRate,
-            momentum, seedGen, bias), m_Outputs(layerWeights.size())
+        DenseLayer(layerWeights, ActivationFunctions::Identity, optimizer,
+            seedGen, bias), m_Outputs(layerWeights.size())
     {
 
     }
 
     explicit OutputClassificationLayer(const std::vector<std::vector<double>>& layerWeights,
-        const std::vector<double>& layerBias, double learningRate, double momentum,
+        const std::vector<double>& layerBias, const std::shared_ptr<const SGDOptimizer>& optimizer,
         const std::shared_ptr<SeedGenerator>& seedGen) :
-        DenseLayer(layerWeights, layerBias, ActivationFunctions::Identity, learningRate,
-            momentum, seedGen), m_Outputs(layerWeights.size())
+        DenseLayer(layerWeights, layerBias, ActivationFunctions::Identity, optimizer,
+            seedGen), m_Outputs(layerWeights.size())
     {
 
     }
@@ -604,8 +1044,22 @@ public:
         return LayerType::OutputClassification;
     }
 
+    LayerMemory memory() const override
+    {
+        // Outputs of the softmax besides those of the neurons
+        LayerMemory memory = DenseLayer::memory();
+        memory.activationBytes += sizeof(double) * m_Outputs.size();
+
+        return memory;
+    }
+
     std::vector<double> propagateForward(const std::vector<double>& inputs, bool ignoreDropout) override
     {
+        if (m_KeepInputs)
+        {
+            m_Inputs = inputs;
+        }
+
         m_Outputs.clear();
 
         std::for_each(m_Neurons.begin(), m_Neurons.end(),
@@ -643,16 +1097,31 @@ public:
             );
         }
 
+        return crossEntropyError(m_Outputs.data(), expectedOutputs.data(), m_Outputs.size());
+    }
+
+    //! @returns Cross entropy error of @p outputsN outputs, e.g. predicted by an
+    //!   InferencePlan, for @p expectedOutputs.
+    static double crossEntropyError(const double* outputs, const double* expectedOutputs, size_t outputsN)
+    {
         double total_error = 0.0;
 
-        for (size_t n = 0; n < m_Outputs.size(); n++)
+        for (size_t n = 0; n < outputsN; n++)
         {
-            total_error += -expectedOutputs[n] * std::log(m_Outputs[n]);
+            total_error += -expectedOutputs[n] * std::log(outputs[n]);
         }
 
         return total_error;
     }
 
+    //! @returns Cross entropy error of @p outputs for the one-hot expected outputs of
+    //!   @p expectedClass, without building them: the terms of the other classes are zero.
+    static double crossEntropyError(const double* outputs, size_t expectedClass)
+    {
+        const double expectedOutput = 1.0;
+        return crossEntropyError(outputs + expectedClass, &expectedOutput, 1);
+    }
+
     void propagateBackwardOuputLayer(const std::vector<double>& expectedOutputs) override
     {
         double sumExpectedOuputs = std::accumulate(expectedOutputs.cbegin(), expectedOutputs.cend(), 0.0);
@@ -662,7 +1131,7 @@ public:
             // -[expectedOutputs[n] - m_Outputs[n] * Sum(expectedOutputs)]
             // Equivalent to m_Outputs[n] - expectedOutputs[n] = out - target when Sum = 1.
             m_Neurons[n].propagateBackwardClassificationLayer(-(expectedOutputs[n]
-                - m_Outputs[n] * sumExpectedOuputs));
+                - m_Outputs[n] * sumExpectedOuputs), m_Inputs);
         }
     }
 
@@ -671,7 +1140,7 @@ public:
         DenseLayer::saveToFile(output, LayerType::OutputClassification, &m_Outputs);
     }
 
-    static OutputClassificationLayer readFromFile(std::ifstream& file)
+    static OutputClassificationLayer readFromFile(std::ifstream& file, const std::shared_ptr<const SGDOptimizer>& optimizer)
     {
         std::string tag;
 
@@ -688,7 +1157,7 @@ public:
         file >> tag >> inputN;
         file >> tag >> outputN;
 
-        OutputClassificationLayer layer(outputN, learningRate, momentum);
+        OutputClassificationLayer layer(outputN, optimizer);
 
         Utils::checkTag(file, tag, "OutputClassification:");
 
@@ -699,7 +1168,7 @@ public:
 
         for (size_t n = 0; n < outputN; n++)
         {
-            layer.m_Neurons.push_back(Neuron::readFromFile(file));
+            layer.m_Neurons.push_back(Neuron::readFromFile(file, optimizer, layer.m_Inputs));
         }
 
         Utils::checkTag(file, tag, "[LayerEnd]");
@@ -708,8 +1177,8 @@ public:
     }
 
 protected:
-    explicit OutputClassificationLayer(size_t neuronsN, double learningRate, double momentum) :
-        DenseLayer(ActivationFunctions::Identity, learningRate, momentum), m_Outputs(neuronsN)
+    explicit OutputClassificationLayer(size_t neuronsN, const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        DenseLayer(ActivationFunctions::Identity, optimizer), m_Outputs(neuronsN)
     {
 
     }
@@ -723,25 +1192,33 @@ class OutputRegressionLayer : public DenseLayer // public inheritance to be able
 {
 public:
     explicit OutputRegressionLayer(size_t neuronsN, size_t prevLayerNeuronsN,
-        ActivationFunctions afunc, double learningRate, double momentum,
-        const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0) :
-        DenseLayer(neuronsN, prevLayerNeuronsN, afunc, learningRate, momentum, seedGen, bias)
+        ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer,
+        const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0, size_t threadsN = 1) :
+        DenseLayer(neuronsN, prevLayerNeuronsN, afunc, optimizer, seedGen, bias, threadsN)
+    {
+
+    }
+
+    //! Creates a layer of zero weights and biases, to be read with setParameter().
+    explicit OutputRegressionLayer(size_t neuronsN, size_t prevLayerNeuronsN,
+        ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        DenseLayer(neuronsN, prevLayerNeuronsN, afunc, optimizer)
     {
 
     }
 
     explicit OutputRegressionLayer(const std::vector<std::vector<double>>& layerWeights,
-        ActivationFunctions afunc, double learningRate, double momentum,
+        ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer,
         const std::shared_ptr<SeedGenerator>& seedGen, double bias = 0.0) :
-        DenseLayer(layerWeights, afunc, learningRate, momentum, seedGen, bias)
+        DenseLayer(layerWeights, afunc, optimizer, seedGen, bias)
     {
 
     }
 
     explicit OutputRegressionLayer(const std::vector<std::vector<double>>& layerWeights,
         const std::vector<double>& layerBias, ActivationFunctions afunc,
-        double learningRate, double momentum, const std::shared_ptr<SeedGenerator>& seedGen) :
-        DenseLayer(layerWeights, layerBias, afunc, learningRate, momentum, seedGen)
+        const std::shared_ptr<const SGDOptimizer>& optimizer, const std::shared_ptr<SeedGenerator>& seedGen) :
+        DenseLayer(layerWeights, layerBias, afunc, optimizer, seedGen)
     {
 
     }
@@ -770,7 +1247,22 @@ public:
 
         for (size_t n = 0; n < m_Neurons.size(); n++)
         {
-            total_error += m_Neurons[n].squaredError(expectedOutputs[n]);
+            const double output = m_Neurons[n].output();
+            total_error += squaredError(&output, &expectedOutputs[n], 1);
+        }
+
+        return total_error;
+    }
+
+    //! @returns Total squared error of @p outputsN outputs, e.g. predicted by an
+    //!   InferencePlan, for @p expectedOutputs.
+    static double squaredError(const double* outputs, const double* expectedOutputs, size_t outputsN)
+    {
+        double total_error = 0.0;
+
+        for (size_t n = 0; n < outputsN; n++)
+        {
+            total_error += std::pow(expectedOutputs[n] - outputs[n], 2);
         }
 
         return total_error;
@@ -781,7 +1273,7 @@ public:
         DenseLayer::saveToFile(output, LayerType::OutputRegression);
     }
 
-    static OutputRegressionLayer readFromFile(std::ifstream& file)
+    static OutputRegressionLayer readFromFile(std::ifstream& file, const std::shared_ptr<const SGDOptimizer>& optimizer)
     {
         std::string tag;
 
@@ -798,11 +1290,11 @@ public:
         file >> tag >> inputN;
         file >> tag >> outputN;
 
-        OutputRegressionLayer layer(static_cast<ActivationFunctions>(afunc), learningRate, momentum);
+        OutputRegressionLayer layer(static_cast<ActivationFunctions>(afunc), optimizer);
 
         for (size_t n = 0; n < outputN; n++)
         {
-            layer.m_Neurons.push_back(Neuron::readFromFile(file));
+            layer.m_Neurons.push_back(Neuron::readFromFile(file, optimizer, layer.m_Inputs));
         }
 
         Utils::checkTag(file, tag, "[LayerEnd]");
@@ -811,8 +1303,8 @@ public:
     }
 
 protected:
-    explicit OutputRegressionLayer(ActivationFunctions afunc, double learningRate, double momentum) :
-        DenseLayer(afunc, learningRate, momentum)
+    explicit OutputRegressionLayer(ActivationFunctions afunc, const std::shared_ptr<const SGDOptimizer>& optimizer) :
+        DenseLayer(afunc, optimizer)
     {
 
     }
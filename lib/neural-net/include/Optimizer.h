@@ -0,0 +1,49 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_OPTIMIZER_H
+#define YANNL_OPTIMIZER_H
+
+namespace YANNL
+{
+
+//! @brief Hyper-parameters of the stochastic gradient descent. A single instance is
+//! shared by all the layers and neurons of a network so that changing the learning
+//! rate, e.g. after each batch with a scheduler, costs O(1) whatever the network size.
+class SGDOptimizer
+{
+public:
+    //! @param learningRate Learning rate (eta).
+    //! @param momentum The momentum (lambda). 0 by default; no momentum.
+    explicit SGDOptimizer(double learningRate, double momentum = 0.0) :
+        m_LearningRate(learningRate), m_Momentum(momentum)
+    {
+
+    }
+
+    // No need to apply the rule of five as the class contains no raw pointers
+
+    double learningRate() const
+    {
+        return m_LearningRate;
+    }
+
+    void setLearningRate(double learningRate)
+    {
+        m_LearningRate = learningRate;
+    }
+
+    double momentum() const
+    {
+        return m_Momentum;
+    }
+
+private:
+    double m_LearningRate = 0.0;
+    const double m_Momentum = 0.0;
+};
+
+}
+
+#endif // YANNL_OPTIMIZER_H
@@ -0,0 +1,167 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_PROGRESS_REPORTER_H
+#define YANNL_PROGRESS_REPORTER_H
+
+#include "Terminal.h"
+#include <algorithm>            // std::min
+#include <atomic>               // std::atomic
+#include <chrono>               // std::chrono
+#include <condition_variable>   // std::condition_variable
+#include <iomanip>              // std::setprecision
+#include <mutex>                // std::mutex
+#include <string>               // std::string
+#include <thread>               // std::thread
+
+namespace YANNL
+{
+
+//! @brief Renders a progress bar from a separate thread at a fixed wall-clock interval.
+//! The training loop only publishes its progress with @ref update(), which costs
+//! a couple of atomic stores, so that the terminal I/O does not slow down the training.
+//! Rendering looks like:
+//! Epoch 1 / 3 | 1200 / 60000 [ =/________ ] 2% | Error: 0.1234
+class ProgressReporter
+{
+public:
+    //! Starts the rendering thread.
+    //! @param os Stream where the progress is rendered.
+    //! @param total Number of steps, e.g. samples of an epoch.
+    //! @param label Text printed before the counter, e.g. "Epoch 1 / 3 |". Empty by default.
+    //! @param interval Time between two renderings. 200 ms by default.
+    //! @param barWidth Number of characters of the bar. 50 by default.
+    explicit ProgressReporter(std::ostream& os, size_t total, const std::string& label = "",
+        std::chrono::milliseconds interval = std::chrono::milliseconds(200), size_t barWidth = 50) :
+        m_Os(os), m_Total(total), m_Label(label), m_Interval(interval), m_BarWidth(barWidth)
+    {
+        if (&m_Os == &std::cout)
+        {
+            Terminal::showCursor(false);
+        }
+
+        m_Thread = std::thread(&ProgressReporter::run, this);
+    }
+
+    //! Renders the final state if @ref finish() was not called.
+    ~ProgressReporter()
+    {
+        finish();
+    }
+
+    // Owns a thread: neither copyable nor movable
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+    //! @param done Number of steps done.
+    void update(size_t done)
+    {
+        m_Done.store(done, std::memory_order_relaxed);
+    }
+
+    //! @param done Number of steps done.
+    //! @param error Current error, rendered after the bar.
+    void update(size_t done, double error)
+    {
+        m_Error.store(error, std::memory_order_relaxed);
+        m_HasError.store(true, std::memory_order_relaxed);
+        m_Done.store(done, std::memory_order_relaxed);
+    }
+
+    //! Stops the rendering thread and renders the final state followed by a new line.
+    void finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            if (m_Stop)
+            {
+                return;
+            }
+
+            m_Stop = true;
+        }
+
+        m_Cv.notify_one();
+        m_Thread.join();
+
+        render();
+        m_Os << "\n";
+        m_Os.flush();
+
+        if (&m_Os == &std::cout)
+        {
+            Terminal::showCursor(true);
+        }
+    }
+
+private:
+    std::ostream& m_Os;
+    const size_t m_Total;
+    const std::string m_Label;
+    const std::chrono::milliseconds m_Interval;
+    const size_t m_BarWidth;
+
+    std::atomic<size_t> m_Done{ 0 };
+    std::atomic<double> m_Error{ 0.0 };
+    std::atomic<bool> m_HasError{ false };
+
+    std::mutex m_Mutex;
+    std::condition_variable m_Cv;
+    bool m_Stop = false;
+    std::thread m_Thread;
+    size_t m_RenderN = 0;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        while (!m_Cv.wait_for(lock, m_Interval, [this]() { return m_Stop; }))
+        {
+            render();
+            m_Os << "\r";
+            m_Os.flush();
+        }
+    }
+
+    void render()
+    {
+        const size_t done = std::min(m_Done.load(std::memory_order_relaxed), m_Total);
+        const double progress = m_Total > 0 ? done * 100.0 / m_Total : 100.0;
+        const size_t position = static_cast<size_t>(progress / 100.0 * m_BarWidth);
+        const char currentPosChar = (m_RenderN++ % 2 == 0) ? '/' : '\\';
+
+        if (!m_Label.empty())
+        {
+            m_Os << m_Label << " ";
+        }
+
+        m_Os << done << " / " << m_Total << " [ ";
+
+        for (size_t i = 0; i < m_BarWidth; i++)
+        {
+            if (i < position) { m_Os << "="; }
+            else if (i == position) { m_Os << currentPosChar; }
+            else { m_Os << "_"; }
+        }
+
+        m_Os << " ] " << static_cast<int>(progress) << "%";
+
+        if (m_HasError.load(std::memory_order_relaxed))
+        {
+            const std::ios_base::fmtflags flags = m_Os.flags();
+            const std::streamsize precision = m_Os.precision();
+
+            m_Os << " | Error: " << std::fixed << std::setprecision(4)
+                << m_Error.load(std::memory_order_relaxed);
+
+            m_Os.flags(flags);
+            m_Os.precision(precision);
+        }
+    }
+};
+
+}
+
+#endif // YANNL_PROGRESS_REPORTER_H
@@ -0,0 +1,115 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_RANDOM_H
+#define YANNL_RANDOM_H
+
+#include <array>    // std::array
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t & uint64_t
+
+namespace YANNL
+{
+
+//! Engine used to draw the initial weights and the dropout masks.
+enum class RandomEngine
+{
+    //! One std::mt19937 per neuron and per dropout layer, drawn serially.
+    MersenneTwister = 0,
+    //! Counter-based: each value only depends on the key and its index so that
+    //! values can be drawn in bulk and in parallel, in any order.
+    Philox
+};
+
+//! @brief Philox4x32-10 counter-based generator from Salmon et al. "Parallel Random
+//! Numbers: As Easy as 1, 2, 3" (SC'11). A block of 4 random words is a pure function
+//! of a 128-bit counter and a 64-bit key: there is no state to share between threads
+//! and the values do not depend on how a range is split across threads.
+class Philox4x32
+{
+public:
+    using Block = std::array<uint32_t, 4>;
+
+    explicit Philox4x32(uint64_t key) :
+        m_Key{ static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32) }
+    {
+
+    }
+
+    //! @param counter Low 64 bits of the counter, e.g. the index of the block.
+    //! @param stream High 64 bits of the counter, e.g. the index of a neuron.
+    //! @returns Block of 4 random words.
+    Block operator()(uint64_t counter, uint64_t stream = 0) const
+    {
+        Block ctr{ static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32),
+            static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32) };
+        std::array<uint32_t, 2> key = m_Key;
+
+        for (int r = 0; r < kRounds; r++)
+        {
+            if (r > 0)
+            {
+                key[0] += kWeyl0;
+                key[1] += kWeyl1;
+            }
+
+            const uint64_t p0 = static_cast<uint64_t>(kMultiplier0) * ctr[0];
+            const uint64_t p1 = static_cast<uint64_t>(kMultiplier1) * ctr[2];
+
+            ctr = Block{ static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0], static_cast<uint32_t>(p1),
+                static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1], static_cast<uint32_t>(p0) };
+        }
+
+        return ctr;
+    }
+
+    //! @returns Uniform value in [0, 1) built from the 53 upper bits of two words.
+    static double toUniform(uint32_t high, uint32_t low)
+    {
+        const uint64_t bits = (static_cast<uint64_t>(high) << 21) ^ (low >> 11);
+        return static_cast<double>(bits) * (1.0 / 9007199254740992.0); // 2^-53
+    }
+
+    //! @returns Uniform value in [0, 1) at position @p index of @p stream. A block
+    //!   gives two values.
+    double uniform(uint64_t index, uint64_t stream = 0) const
+    {
+        const Block block = (*this)(index / 2, stream);
+        const size_t w = (index % 2) * 2;
+
+        return toUniform(block[w], block[w + 1]);
+    }
+
+    //! Fills the range [@p begin, @p end) of @p out with uniform values in [@p low, @p high)
+    //! of @p stream. Value i is the same whatever the range it is drawn with.
+    void fillUniform(double* out, size_t begin, size_t end, double low, double high,
+        uint64_t stream = 0) const
+    {
+        Block block{};
+
+        for (size_t i = begin; i < end; i++)
+        {
+            if (i == begin || i % 2 == 0)
+            {
+                block = (*this)(i / 2, stream);
+            }
+
+            const size_t w = (i % 2) * 2;
+            out[i] = low + (high - low) * toUniform(block[w], block[w + 1]);
+        }
+    }
+
+private:
+    static constexpr int kRounds = 10;
+    static constexpr uint32_t kMultiplier0 = 0xD2511F53;
+    static constexpr uint32_t kMultiplier1 = 0xCD9E8D57;
+    static constexpr uint32_t kWeyl0 = 0x9E3779B9;
+    static constexpr uint32_t kWeyl1 = 0xBB67AE85;
+
+    const std::array<uint32_t, 2> m_Key;
+};
+
+}
+
+#endif // YANNL_RANDOM_H
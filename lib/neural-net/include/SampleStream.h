@@ -0,0 +1,113 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_SAMPLE_STREAM_H
+#define YANNL_SAMPLE_STREAM_H
+
+#include <cstddef>  // size_t
+#include <future>   // std::future & std::async
+#include <vector>   // std::vector
+
+namespace YANNL
+{
+
+//! @brief Source of training samples read block by block, e.g. from a file larger
+//! than the memory, for MLPRegressor::fit(SampleStream&) and MLPClassifer::fit(SampleStream&, t_Labels).
+//! Each sample is inputSize() values and one target: a value or a label.
+class SampleStream
+{
+public:
+    virtual ~SampleStream() = default;
+
+    //! @returns Number of inputs of each sample.
+    virtual size_t inputSize() const = 0;
+
+    //! @returns Number of samples of the stream.
+    virtual size_t size() const = 0;
+
+    //! Reads the next samples. The vectors are resized, keeping their capacity.
+    //! @param maxSamples Maximum number of samples read.
+    //! @param inputs Inputs of the samples read, one after another.
+    //! @param targets Target of each sample read.
+    //! @returns Number of samples read; 0 at the end of the stream.
+    virtual size_t read(size_t maxSamples, std::vector<double>& inputs, std::vector<double>& targets) = 0;
+
+    //! Goes back to the first sample, e.g. for the next epoch.
+    virtual void rewind() = 0;
+};
+
+//! Samples read from a SampleStream.
+struct SampleBatch
+{
+    size_t samplesN = 0;
+    std::vector<double> inputs;
+    std::vector<double> targets;
+};
+
+//! @brief Reads the samples of a stream with two buffers: while a block is used, the
+//! next one is read by a background task. The memory used is two blocks whatever the
+//! size of the stream.
+class DoubleBufferedReader
+{
+public:
+    //! Starts reading the first block.
+    //! @param stream Stream read from its current position. It must not be used by
+    //!   anything else until the reader is destroyed.
+    //! @param blockSize Number of samples per block.
+    explicit DoubleBufferedReader(SampleStream& stream, size_t blockSize) :
+        m_Stream(stream), m_BlockSize(blockSize)
+    {
+        readAsync(m_Batches[0]);
+    }
+
+    //! Waits for the block being read.
+    ~DoubleBufferedReader()
+    {
+        if (m_Pending.valid())
+        {
+            m_Pending.wait();
+        }
+    }
+
+    // The background task refers to the buffers: neither copyable nor movable
+    DoubleBufferedReader(const DoubleBufferedReader&) = delete;
+    DoubleBufferedReader& operator=(const DoubleBufferedReader&) = delete;
+
+    //! Waits for the block being read and starts reading the following one.
+    //! @returns Block valid until the next call; no samples at the end of the stream.
+    //! @throws Exceptions thrown by SampleStream::read().
+    const SampleBatch& next()
+    {
+        SampleBatch& batch = m_Batches[m_Current];
+        batch.samplesN = m_Pending.valid() ? m_Pending.get() : 0;
+
+        if (batch.samplesN > 0)
+        {
+            m_Current = 1 - m_Current;
+            readAsync(m_Batches[m_Current]);
+        }
+
+        return batch;
+    }
+
+private:
+    SampleStream& m_Stream;
+    const size_t m_BlockSize;
+    SampleBatch m_Batches[2];
+    size_t m_Current = 0;
+    std::future<size_t> m_Pending;
+
+    void readAsync(SampleBatch& batch)
+    {
+        m_Pending = std::async(std::launch::async,
+            [this, &batch]()
+            {
+                return m_Stream.read(m_BlockSize, batch.inputs, batch.targets);
+            });
+    }
+};
+
+}
+
+#endif // YANNL_SAMPLE_STREAM_H
@@ -0,0 +1,67 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_TERMINAL_H
+#define YANNL_TERMINAL_H
+
+#include <iostream> // std::cout
+#include <cstdio>   // stdout
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX    // Keep std::min & std::max usable
+#endif
+#include <windows.h> // GetConsoleCursorInfo & SetConsoleCursorInfo
+#include <io.h>      // _isatty
+#else
+#include <unistd.h>  // isatty
+#endif
+
+namespace YANNL
+{
+
+//! Console helpers. All the platform specific code is kept here.
+class Terminal
+{
+public:
+    //! @returns Whether the standard output is an interactive console and not
+    //!   redirected to a file or a pipe.
+    static bool isInteractive()
+    {
+#ifdef _WIN32
+        return _isatty(_fileno(stdout)) != 0;
+#else
+        return isatty(STDOUT_FILENO) != 0;
+#endif
+    }
+
+    //! Show or hide the console cursor to avoid it blinking when updating the
+    //! console output fast. Does nothing if the output is not a console.
+    //! @param showFlag True to show the cursor, false to hide.
+    static void showCursor(bool showFlag)
+    {
+        if (!isInteractive())
+        {
+            return;
+        }
+
+#ifdef _WIN32
+        HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+
+        CONSOLE_CURSOR_INFO cursorInfo;
+
+        GetConsoleCursorInfo(out, &cursorInfo);
+        cursorInfo.bVisible = showFlag; // set the cursor visibility
+        SetConsoleCursorInfo(out, &cursorInfo);
+#else
+        // ANSI escape sequences DECTCEM
+        std::cout << (showFlag ? "\033[?25h" : "\033[?25l");
+        std::cout.flush();
+#endif
+    }
+};
+
+}
+
+#endif // YANNL_TERMINAL_H
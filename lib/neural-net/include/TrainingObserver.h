@@ -0,0 +1,145 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_TRAINING_OBSERVER_H
+#define YANNL_TRAINING_OBSERVER_H
+
+#include <chrono>   // std::chrono
+#include <limits>   // std::numeric_limits
+#include <memory>   // std::shared_ptr
+
+namespace YANNL
+{
+
+enum class TrainingPhase
+{
+    Data = 0,   //!< Fetching the sample and preparing the expected output
+    Forward,    //!< Forward propagation
+    Backward,   //!< Loss and backward propagation
+    Update      //!< Weights update
+};
+
+//! Metrics of one training epoch. Times are in seconds.
+struct EpochMetrics
+{
+    size_t epoch = 0;
+    size_t samplesN = 0;
+    size_t batchesN = 0;
+    double loss = 0.0;
+    //! Loss on the validation set; NaN if there is no validation set.
+    double validationLoss = std::numeric_limits<double>::quiet_NaN();
+    //! Learning rate at the end of the epoch, before the epoch-level schedule applies.
+    double learningRate = 0.0;
+    double dataSeconds = 0.0;
+    double forwardSeconds = 0.0;
+    double backwardSeconds = 0.0;
+    double updateSeconds = 0.0;
+    //! Wall time of the whole epoch, validation included.
+    double totalSeconds = 0.0;
+
+    double samplesPerSecond() const
+    {
+        return totalSeconds > 0.0 ? samplesN / totalSeconds : 0.0;
+    }
+};
+
+//! @brief Receives the training metrics. Override only the notifications needed.
+//! Attach it with @ref NeuralNetwork::setObserver to time each phase of a custom
+//! training loop, or with @ref MLP::setTrainingObserver to also get the metrics
+//! of each epoch. Nothing is measured when no observer is attached.
+class TrainingObserver
+{
+public:
+    virtual ~TrainingObserver() = default;
+
+    //! Called each time a phase completes, i.e. once per sample for the data,
+    //! forward and backward phases and once per batch for the update phase.
+    virtual void onPhase(TrainingPhase phase, double seconds)
+    {
+
+    }
+
+    virtual void onEpochEnd(const EpochMetrics& metrics)
+    {
+
+    }
+
+    //! @param epochsN Number of epochs run.
+    //! @param seconds Wall time of the whole training.
+    virtual void onTrainingEnd(size_t epochsN, double seconds)
+    {
+
+    }
+};
+
+//! Measures the duration of a scope and reports it to the observer. Does not
+//! read the clock if the observer is null.
+class PhaseTimer
+{
+public:
+    PhaseTimer(TrainingObserver* observer, TrainingPhase phase) :
+        m_Observer(observer), m_Phase(phase)
+    {
+        if (m_Observer != nullptr)
+        {
+            m_Start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~PhaseTimer()
+    {
+        if (m_Observer != nullptr)
+        {
+            m_Observer->onPhase(m_Phase, std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - m_Start).count());
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    TrainingObserver* const m_Observer;
+    const TrainingPhase m_Phase;
+    std::chrono::steady_clock::time_point m_Start;
+};
+
+//! Sums the time spent in each phase and forwards the notifications to another
+//! observer.
+class PhaseAccumulator : public TrainingObserver
+{
+public:
+    explicit PhaseAccumulator(const std::shared_ptr<TrainingObserver>& next) :
+        m_Next(next)
+    {
+
+    }
+
+    void onPhase(TrainingPhase phase, double seconds) override
+    {
+        m_Seconds[static_cast<size_t>(phase)] += seconds;
+        m_Next->onPhase(phase, seconds);
+    }
+
+    double seconds(TrainingPhase phase) const
+    {
+        return m_Seconds[static_cast<size_t>(phase)];
+    }
+
+    void reset()
+    {
+        for (double& s : m_Seconds)
+        {
+            s = 0.0;
+        }
+    }
+
+private:
+    const std::shared_ptr<TrainingObserver> m_Next;
+    double m_Seconds[4] = { 0.0, 0.0, 0.0, 0.0 };
+};
+
+}
+
+#endif // YANNL_TRAINING_OBSERVER_H
@@ -5,12 +5,22 @@
 #ifndef YANNL_UTILS_H
 #define YANNL_UTILS_H
 
+#include "Random.h"
+#include "Terminal.h"
 #include <iostream>     // std::ostream
 #include <sstream>      // std::ostringstream
 #include <vector>       // std::vector
 #include <algorithm>    // std_max_element & std::min_element
 #include <random>       // std::random_device
-#include <windows.h>    // GetConsoleCursorInfo & SetConsoleCursorInfo
+#include <thread>       // std::thread
+
+// Tells the compiler that pointers of hot loops do not alias so that these loops
+// can be vectorized without runtime overlap checks.
+#if defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__)
+#define YANNL_RESTRICT __restrict
+#else
+#define YANNL_RESTRICT
+#endif
 
 namespace YANNL
 {
@@ -102,17 +112,51 @@ struct Utils
     }
 
     //! Show or hide the console cursor to avoid it blinking when updating the
-    //! console output fast.
+    //! console output fast. See @ref Terminal::showCursor.
     //! @param showFlag True to show the cursor, false to hide.
     static void ShowConsoleCursor(bool showFlag)
     {
-        HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+        Terminal::showCursor(showFlag);
+    }
+
+    //! Splits the range [0, count) into contiguous chunks and processes each chunk
+    //! on its own thread. The calling thread processes the first chunk so that
+    //! no thread is created when @p threadsN is 1. The other threads are created and
+    //! joined at each call, which costs tens of microseconds.
+    //! @param count Number of items to process.
+    //! @param threadsN Maximum number of threads to use, calling thread included.
+    //! @param func Function called as func(begin, end) on each chunk.
+    template <class Function>
+    static void parallelFor(size_t count, size_t threadsN, Function func)
+    {
+        threadsN = std::max<size_t>(1, std::min(threadsN, count));
+
+        if (threadsN == 1)
+        {
+            func(0, count);
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        threads.reserve(threadsN - 1);
 
-        CONSOLE_CURSOR_INFO cursorInfo;
+        const size_t chunk = count / threadsN;
+        const size_t remainder = count % threadsN;
+        size_t begin = chunk + (remainder > 0 ? 1 : 0);
 
-        GetConsoleCursorInfo(out, &cursorInfo);
-        cursorInfo.bVisible = showFlag; // set the cursor visibility
-        SetConsoleCursorInfo(out, &cursorInfo);
+        for (size_t t = 1; t < threadsN; t++)
+        {
+            size_t end = begin + chunk + (t < remainder ? 1 : 0);
+            threads.emplace_back(func, begin, end);
+            begin = end;
+        }
+
+        func(0, chunk + (remainder > 0 ? 1 : 0));
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
     }
 
     static void checkTag(std::istream& ifs, std::string& tag, const std::string& expectedTag)
@@ -133,12 +177,16 @@ struct Utils
 //! @brief Class for generating seeds. It uses itself a seed to make sure
 //! the seed sequence is always the same if the user wants it. If the
 //! user does not want to generate always the same sequence he/she can provide a custom seed.
+//! It also tells the layers which @ref RandomEngine to draw their values with.
 class SeedGenerator
 {
 public:
     //! @param useCustomSeed Tells whether to use a custom seed
     //! @param seed Custom seed, used only if useCustomSeed is true
-    SeedGenerator(bool useCustomSeed = false, unsigned int seed = 0)
+    //! @param engine Engine used by the layers. Mersenne Twister by default.
+    SeedGenerator(bool useCustomSeed = false, unsigned int seed = 0,
+        RandomEngine engine = RandomEngine::MersenneTwister) :
+        m_Engine(engine)
     {
         if (!useCustomSeed)
         {
@@ -154,20 +202,61 @@ public:
         return mtGenerator();
     }
 
+    //! @returns 64-bit key for a @ref Philox4x32 generator, made of two seeds.
+    uint64_t key()
+    {
+        const uint64_t high = mtGenerator();
+        return (high << 32) | mtGenerator();
+    }
+
+    RandomEngine engine() const
+    {
+        return m_Engine;
+    }
+
+    //! Writes the state of the generator, preceded by "Philox" with this engine.
     friend std::ostream& operator<<(std::ostream& os, const SeedGenerator& generator)
     {
+        writeEngine(os, generator.m_Engine);
         os << generator.mtGenerator;
         return os;
     }
 
     friend std::istream& operator>>(std::istream& is, SeedGenerator& generator)
     {
+        generator.m_Engine = readEngine(is);
         is >> generator.mtGenerator;
         return is;
     }
 
+    //! Writes the engine before a generator state. Nothing is written for the default
+    //! engine so that files saved before counter-based generation are still read.
+    static void writeEngine(std::ostream& os, RandomEngine engine)
+    {
+        if (engine == RandomEngine::Philox)
+        {
+            os << "Philox ";
+        }
+    }
+
+    //! Reads the engine written by @ref writeEngine(std::ostream&, RandomEngine).
+    static RandomEngine readEngine(std::istream& is)
+    {
+        is >> std::ws;
+
+        if (is.peek() == 'P')
+        {
+            std::string tag;
+            is >> tag;
+            return RandomEngine::Philox;
+        }
+
+        return RandomEngine::MersenneTwister;
+    }
+
 private:
     std::mt19937 mtGenerator;
+    RandomEngine m_Engine = RandomEngine::MersenneTwister;
 };
 
 }
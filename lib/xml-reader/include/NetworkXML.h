@@ -0,0 +1,555 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_NETWORK_XML_H
+#define YANNL_NETWORK_XML_H
+
+#include "NeuralNetwork.h"
+#include "XMLDocument.h"
+#include <cstdint>  // uint64_t
+#include <cstring>  // std::memcpy
+#include <limits>   // std::numeric_limits
+
+namespace YANNL
+{
+
+//! Text encoding of the blocks of parameters of a network saved in XML.
+enum class XMLBinaryEncoding
+{
+    Base64 = 0,
+    Hex
+};
+
+//! @brief Saves and loads a NeuralNetwork as XML: the topology is readable XML while the
+//! weights and biases of each dense or convolutional layer are one block of binary doubles encoded in
+//! base64 or hexadecimal. Loading builds each layer then decodes its block straight into
+//! its weights, without converting each number from text nor copying the parameters. The
+//! values are exact.
+//!
+//! @code{.xml}
+//! <network version="1" inputs="2" learningRate="0.5" momentum="0.9" generator="...">
+//!   <layer type="Hidden" neurons="5" activation="Logistic">
+//!     <parameters encoding="base64" count="15">...</parameters>
+//!     <previousChanges encoding="base64" count="15">...</previousChanges>
+//!   </layer>
+//!   <layer type="Dropout" neurons="5" rate="0.2" generator="..."/>
+//!   <layer type="OutputRegression" neurons="1" activation="Logistic">
+//!     <parameters encoding="hex" count="6">...</parameters>
+//!     <previousChanges encoding="hex" count="6">...</previousChanges>
+//!   </layer>
+//! </network>
+//! @endcode
+//! Image layers also describe the images they read and their kernel:
+//! @code{.xml}
+//! <layer type="Conv2D" neurons="1152" channels="1" height="28" width="28" kernel="5" stride="1"
+//!     filters="2" padding="0" activation="Tanh">
+//!   <parameters encoding="base64" count="52">...</parameters>
+//!   <previousChanges encoding="base64" count="52">...</previousChanges>
+//! </layer>
+//! <layer type="MaxPool" neurons="288" channels="2" height="24" width="24" kernel="2" stride="2"/>
+//! @endcode
+//! Parameters are stored neuron or filter by filter, weights then bias, as IEEE 754 doubles in
+//! little-endian order whatever the machine. Like NeuralNetwork::saveToFile(), the
+//! previous changes used by the momentum and the generators are saved as well so that a
+//! loaded network trains on exactly like the saved one. The previous changes are optional
+//! when loading: they are zero if missing.
+class NetworkXML
+{
+public:
+    //! @returns false if the file cannot be written.
+    static bool saveToFile(const NeuralNetwork& net, const std::string& filepath,
+        XMLBinaryEncoding encoding = XMLBinaryEncoding::Base64)
+    {
+        std::ofstream output(filepath, std::ios::binary);
+
+        if (!output)
+        {
+            return false;
+        }
+
+        write(net, output, encoding);
+        output.close();
+
+        return static_cast<bool>(output);
+    }
+
+    static void write(const NeuralNetwork& net, std::ostream& os,
+        XMLBinaryEncoding encoding = XMLBinaryEncoding::Base64)
+    {
+        std::ostringstream generator;
+        generator << *net.m_SeedGenerator;
+
+        const std::streamsize precision = os.precision(std::numeric_limits<double>::max_digits10);
+
+        os << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+            << "<network version=\"" << kVersion << "\" inputs=\"" << net.m_InputSize
+            << "\" learningRate=\"" << net.learningRate() << "\" momentum=\"" << net.m_Optimizer->momentum()
+            << "\" generator=\"" << generator.str() << "\">\n";
+
+        std::vector<double> params;
+        std::string text;
+
+        for (const std::shared_ptr<NeuronLayer>& layer : net.m_Layers)
+        {
+            os << "  <layer type=\"" << layerTypeName(layer->type())
+                << "\" neurons=\"" << layer->size() << "\"";
+
+            if (layer->dropoutLayer())
+            {
+                os << " rate=\"" << layer->dropoutRate() << "\" generator=\"" << layer->generatorState() << "\"/>\n";
+                continue;
+            }
+            else if (isImageLayer(layer->type()))
+            {
+                const ImageLayer& image = static_cast<const ImageLayer&>(*layer);
+                os << " channels=\"" << image.inputShape().channels << "\" height=\"" << image.inputShape().height
+                    << "\" width=\"" << image.inputShape().width << "\" kernel=\"" << image.kernelSize()
+                    << "\" stride=\"" << image.stride() << "\"";
+
+                if (layer->type() != LayerType::Conv2D)
+                {
+                    os << "/>\n";
+                    continue;
+                }
+
+                const Conv2DLayer& conv = static_cast<const Conv2DLayer&>(image);
+                os << " filters=\"" << conv.filtersCount() << "\" padding=\"" << conv.padding()
+                    << "\" activation=\"" << activationName(conv.activationFunction()) << "\">\n";
+            }
+            else
+            {
+                const DenseLayer& dense = static_cast<const DenseLayer&>(*layer);
+                os << " activation=\"" << activationName(dense.activationFunction()) << "\">\n";
+            }
+
+            params.clear();
+            layer->copyParameters(params);
+            writeBlock(os, "parameters", params, encoding, text);
+
+            params.clear();
+            layer->copyOptimizerState(params);
+            writeBlock(os, "previousChanges", params, encoding, text);
+
+            os << "  </layer>\n";
+        }
+
+        os << "</network>\n";
+        os.precision(precision);
+    }
+
+    //! @throws std::domain_error If the file cannot be read or does not describe a
+    //!   network with an output layer.
+    static NeuralNetwork loadFromFile(const std::string& filepath)
+    {
+        return read(XMLDocument::readFile(filepath));
+    }
+
+    //! @throws std::domain_error If @p doc does not describe a network with an output layer.
+    static NeuralNetwork read(const XMLDocument& doc)
+    {
+        const XMLElement& root = doc.root();
+
+        if (root.name != "network" || attribute(root, "version") != std::to_string(kVersion))
+        {
+            throw std::domain_error("[Load XML network] Document is not a network of a supported version.");
+        }
+
+        std::istringstream generatorState(attribute(root, "generator"));
+        SeedGenerator generator;
+        generatorState >> generator;
+        const size_t inputSize = number<size_t>(root, "inputs");
+
+        NeuralNetwork net(inputSize, number<double>(root, "learningRate"), number<double>(root, "momentum"),
+            generator);
+        size_t prevLayerSize = inputSize;
+
+        for (const XMLElement* element = root.firstChild; element != nullptr; element = element->nextSibling)
+        {
+            if (element->name != "layer")
+            {
+                continue;
+            }
+
+            if (net.isLastLayerAnOutput())
+            {
+                throw std::domain_error("[Load XML network] Layer after an output layer.");
+            }
+
+            const std::string type = attribute(*element, "type");
+            const size_t neuronsN = number<size_t>(*element, "neurons");
+
+            if (type == layerTypeName(LayerType::Dropout))
+            {
+                if (neuronsN != prevLayerSize)
+                {
+                    throw std::domain_error("[Load XML network] Dropout layer is not of the size of the previous layer.");
+                }
+
+                std::shared_ptr<DropoutLayer> layer = std::make_shared<DropoutLayer>(
+                    number<double>(*element, "rate"), neuronsN, std::mt19937(), net.m_SeedGenerator->engine());
+                layer->restoreGeneratorState(attribute(*element, "generator"));
+                net.m_Layers.push_back(layer);
+                continue;
+            }
+            else if (isImageLayer(typeOf(type)))
+            {
+                net.m_Layers.push_back(readImageLayer(*element, typeOf(type), prevLayerSize, net.m_Optimizer));
+
+                if (net.m_Layers.back()->size() != neuronsN)
+                {
+                    throw std::domain_error("[Load XML network] Image layer is not of the size of its outputs.");
+                }
+
+                prevLayerSize = neuronsN;
+                continue;
+            }
+
+            const ActivationFunctions afunc = activation(attribute(*element, "activation"));
+            const size_t valuesN = neuronsN * (prevLayerSize + 1);
+            std::shared_ptr<DenseLayer> layer;
+
+            if (type == layerTypeName(LayerType::Hidden))
+            {
+                layer = std::make_shared<HiddenLayer>(neuronsN, prevLayerSize, afunc, net.m_Optimizer);
+            }
+            else if (type == layerTypeName(LayerType::OutputClassification))
+            {
+                layer = std::make_shared<OutputClassificationLayer>(neuronsN, prevLayerSize, net.m_Optimizer);
+            }
+            else if (type == layerTypeName(LayerType::OutputRegression))
+            {
+                layer = std::make_shared<OutputRegressionLayer>(neuronsN, prevLayerSize, afunc, net.m_Optimizer);
+            }
+            else
+            {
+                throw std::domain_error("[Load XML network] Unknown layer type " + type + ".");
+            }
+
+            // Straight into the weights of the neurons, in the order of copyParameters()
+            decode(block(*element, "parameters", valuesN, true), valuesN,
+                [&](size_t n, double value)
+                {
+                    layer->setParameter(n, value);
+                });
+
+            net.m_Layers.push_back(layer);
+            readChanges(*element, *net.m_Layers.back());
+            prevLayerSize = neuronsN;
+        }
+
+        if (!net.isLastLayerAnOutput())
+        {
+            throw std::domain_error("[Load XML network] Network has no output layer.");
+        }
+
+        net.applyActivationCheckpoints();
+        net.restoreInputShape();
+
+        return net;
+    }
+
+private:
+    static constexpr int kVersion = 1;
+
+    //! Block of parameters of a layer, with its encoding.
+    struct Block
+    {
+        XMLString text;
+        XMLBinaryEncoding encoding = XMLBinaryEncoding::Base64;
+    };
+
+    static std::string attribute(const XMLElement& element, const char* name)
+    {
+        const XMLString* value = element.attribute(name);
+
+        if (value == nullptr)
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Load XML network] Attribute " << name << " of <" << element.name << "> is missing.").str()
+            );
+        }
+
+        return value->str();
+    }
+
+    template<typename T>
+    static T number(const XMLElement& element, const char* name)
+    {
+        std::istringstream is(attribute(element, name));
+        T value = T();
+        is >> value;
+
+        if (!is || is.peek() != std::char_traits<char>::eof())
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Load XML network] Attribute " << name << " of <" << element.name << "> is not a number.").str()
+            );
+        }
+
+        return value;
+    }
+
+    //! @returns Type of the layer named @p name; LayerType::Hidden if none.
+    static LayerType typeOf(const std::string& name)
+    {
+        for (size_t n = 0; n <= static_cast<size_t>(LayerType::AvgPool); n++)
+        {
+            if (name == layerTypeName(static_cast<LayerType>(n)))
+            {
+                return static_cast<LayerType>(n);
+            }
+        }
+
+        return LayerType::Hidden;
+    }
+
+    //! @throws std::domain_error If the layer does not read @p prevLayerSize values or
+    //!   if its kernel does not fit its images.
+    static std::shared_ptr<ImageLayer> readImageLayer(const XMLElement& element, LayerType type,
+        size_t prevLayerSize, const std::shared_ptr<const SGDOptimizer>& optimizer)
+    {
+        const ImageShape inputShape(number<size_t>(element, "channels"), number<size_t>(element, "height"),
+            number<size_t>(element, "width"));
+        const size_t kernelSize = number<size_t>(element, "kernel");
+        const size_t stride = number<size_t>(element, "stride");
+
+        if (inputShape.size() != prevLayerSize)
+        {
+            throw std::domain_error("[Load XML network] Image layer does not read the outputs of the previous layer.");
+        }
+        else if (type != LayerType::Conv2D)
+        {
+            return std::make_shared<PoolLayer>(type, inputShape, kernelSize, stride);
+        }
+
+        std::shared_ptr<Conv2DLayer> layer = std::make_shared<Conv2DLayer>(inputShape,
+            number<size_t>(element, "filters"), kernelSize, stride, number<size_t>(element, "padding"),
+            activation(attribute(element, "activation")), optimizer);
+        const size_t valuesN = layer->parametersCount();
+        decode(block(element, "parameters", valuesN, true), valuesN,
+            [&](size_t n, double value)
+            {
+                layer->setParameter(n, value);
+            });
+
+        readChanges(element, *layer);
+
+        return layer;
+    }
+
+    //! Restores the previous changes of @p layer, if they were saved.
+    static void readChanges(const XMLElement& element, NeuronLayer& layer)
+    {
+        const size_t valuesN = layer.parametersCount();
+        const Block changes = block(element, "previousChanges", valuesN, false);
+
+        if (changes.text.data != nullptr)
+        {
+            std::vector<double> state(valuesN);
+            decode(changes, valuesN,
+                [&](size_t n, double value)
+                {
+                    state[n] = value;
+                });
+            layer.restoreOptimizerState(state, 0);
+        }
+    }
+
+    static const char* activationName(ActivationFunctions afunc)
+    {
+        static const char* const names[5] = { "Identity", "Logistic", "Tanh", "ReLU", "ISRLU" };
+        return names[static_cast<size_t>(afunc)];
+    }
+
+    static ActivationFunctions activation(const std::string& name)
+    {
+        for (size_t n = 0; n <= static_cast<size_t>(ActivationFunctions::ISRLU); n++)
+        {
+            if (name == activationName(static_cast<ActivationFunctions>(n)))
+            {
+                return static_cast<ActivationFunctions>(n);
+            }
+        }
+
+        throw std::domain_error("[Load XML network] Unknown activation function " + name + ".");
+    }
+
+    //! @returns Block of the child @p name of @p layer; a block without text if there is
+    //!   none and it is not @p required.
+    //! @throws std::domain_error If the block is missing or has not @p count values.
+    static Block block(const XMLElement& layer, const char* name, size_t count, bool required)
+    {
+        const XMLElement* element = layer.child(name);
+
+        if (element == nullptr && !required)
+        {
+            return Block();
+        }
+        else if (element == nullptr || number<size_t>(*element, "count") != count)
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Load XML network] Layer must have " << count << " " << name << ".").str()
+            );
+        }
+
+        const std::string encoding = attribute(*element, "encoding");
+        Block block;
+        block.text = element->value;
+
+        if (encoding == "hex")
+        {
+            block.encoding = XMLBinaryEncoding::Hex;
+        }
+        else if (encoding != "base64")
+        {
+            throw std::domain_error("[Load XML network] Unknown encoding " + encoding + ".");
+        }
+
+        return block;
+    }
+
+    static void writeBlock(std::ostream& os, const char* name, const std::vector<double>& values,
+        XMLBinaryEncoding encoding, std::string& text)
+    {
+        encode(values, encoding, text);
+        os << "    <" << name << " encoding=\"" << (encoding == XMLBinaryEncoding::Hex ? "hex" : "base64")
+            << "\" count=\"" << values.size() << "\">" << text << "</" << name << ">\n";
+    }
+
+    static void encode(const std::vector<double>& values, XMLBinaryEncoding encoding, std::string& text)
+    {
+        static const char* const base64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        static const char* const hex = "0123456789abcdef";
+
+        std::string bytes(values.size() * sizeof(double), '\0');
+
+        for (size_t n = 0; n < values.size(); n++)
+        {
+            uint64_t bits = 0;
+            std::memcpy(&bits, &values[n], sizeof(double));
+
+            for (size_t b = 0; b < sizeof(double); b++)
+            {
+                bytes[n * sizeof(double) + b] = static_cast<char>(bits >> (8 * b));
+            }
+        }
+
+        text.clear();
+
+        if (encoding == XMLBinaryEncoding::Hex)
+        {
+            text.reserve(2 * bytes.size());
+
+            for (char byte : bytes)
+            {
+                text += hex[static_cast<unsigned char>(byte) >> 4];
+                text += hex[static_cast<unsigned char>(byte) & 0xF];
+            }
+
+            return;
+        }
+
+        text.reserve((bytes.size() + 2) / 3 * 4);
+
+        for (size_t n = 0; n < bytes.size(); n += 3)
+        {
+            const size_t remaining = bytes.size() - n;
+            const uint32_t group = static_cast<uint32_t>(static_cast<unsigned char>(bytes[n])) << 16
+                | (remaining > 1 ? static_cast<uint32_t>(static_cast<unsigned char>(bytes[n + 1])) << 8 : 0)
+                | (remaining > 2 ? static_cast<uint32_t>(static_cast<unsigned char>(bytes[n + 2])) : 0);
+
+            text += base64[(group >> 18) & 0x3F];
+            text += base64[(group >> 12) & 0x3F];
+            text += remaining > 1 ? base64[(group >> 6) & 0x3F] : '=';
+            text += remaining > 2 ? base64[group & 0x3F] : '=';
+        }
+    }
+
+    //! @returns Value of the digit @p c in base 64 or 16; -1 for a space; -2 otherwise.
+    static int digit(char c, XMLBinaryEncoding encoding)
+    {
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        {
+            return -1;
+        }
+        else if (encoding == XMLBinaryEncoding::Hex)
+        {
+            return c >= '0' && c <= '9' ? c - '0'
+                : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                : -2;
+        }
+
+        return c >= 'A' && c <= 'Z' ? c - 'A'
+            : c >= 'a' && c <= 'z' ? c - 'a' + 26
+            : c >= '0' && c <= '9' ? c - '0' + 52
+            : c == '+' ? 62
+            : c == '/' ? 63
+            : -2;
+    }
+
+    //! Decodes the doubles of @p block one by one, without intermediate buffer.
+    //! @param store Called with the index and the value of each double.
+    //! @throws std::domain_error If the block is not valid or has not @p valuesN values.
+    template<typename Store>
+    static void decode(const Block& block, size_t valuesN, Store store)
+    {
+        const int bitsPerDigit = block.encoding == XMLBinaryEncoding::Hex ? 4 : 6;
+        size_t valueN = 0, bytesN = 0;
+        uint64_t bits = 0;
+        uint32_t pending = 0;
+        int pendingBits = 0;
+        size_t n = 0;
+
+        for (; n < block.text.size && block.text.data[n] != '='; n++)
+        {
+            const int d = digit(block.text.data[n], block.encoding);
+
+            if (d == -1)
+            {
+                continue;
+            }
+            else if (d == -2 || valueN == valuesN)
+            {
+                break;
+            }
+
+            pending = (pending << bitsPerDigit) | static_cast<uint32_t>(d);
+            pendingBits += bitsPerDigit;
+
+            if (pendingBits >= 8)
+            {
+                pendingBits -= 8;
+                bits |= static_cast<uint64_t>((pending >> pendingBits) & 0xFF) << (8 * bytesN);
+                pending &= (1u << pendingBits) - 1;
+
+                if (++bytesN == sizeof(double))
+                {
+                    double value = 0.0;
+                    std::memcpy(&value, &bits, sizeof(double));
+                    store(valueN++, value);
+                    bits = 0;
+                    bytesN = 0;
+                }
+            }
+        }
+
+        // Only padding and spaces can follow the values
+        while (n < block.text.size && (block.text.data[n] == '=' || digit(block.text.data[n], block.encoding) == -1))
+        {
+            ++n;
+        }
+
+        if (valueN != valuesN || bytesN != 0 || n != block.text.size)
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[Load XML network] Block of parameters is invalid: " << valuesN << " values expected.").str()
+            );
+        }
+    }
+};
+
+}
+
+#endif // YANNL_NETWORK_XML_H
@@ -11,6 +11,8 @@
 #include <map>
 #include <memory>   // std::unique_ptr & std::shared_ptr
 #include <algorithm> // std::for_each
+#include <cstdlib>  // std::strtoul
+#include <unordered_map> // std::unordered_map
 
 namespace YANNL
 {
@@ -80,168 +82,224 @@ struct XMLNode
         }
     }
 
-    XMLNode* getNode(std::string path)
+    //! @returns Node of @p path, e.g. "/nn/layers/layer[1]", starting with the name of
+    //!   this node; nullptr if there is none. See XMLQuery, which compiles the path once
+    //!   for repeated lookups.
+    XMLNode* getNode(const std::string& path);
+
+    //! @returns Nodes of @p path, e.g. all the neurons of the second layer for
+    //!   "/nn/layers/layer[1]/neurons/neuron". See XMLQuery.
+    std::vector<XMLNode*> getCollection(const std::string& path);
+
+    //! @returns Children named @p name, in their order. The index of the children by
+    //!   name is built at the first call and kept: call clearIndex() after modifying
+    //!   the children. Not thread-safe.
+    const std::vector<XMLNode*>& childrenNamed(const std::string& name)
+    {
+        static const std::vector<XMLNode*> none;
+
+        if (!childrenByName)
+        {
+            childrenByName = std::make_unique<std::unordered_map<std::string, std::vector<XMLNode*>>>();
+
+            for (const std::unique_ptr<XMLNode>& child : children)
+            {
+                (*childrenByName)[child->name].push_back(child.get());
+            }
+        }
+
+        const auto found = childrenByName->find(name);
+
+        return found != childrenByName->end() ? found->second : none;
+    }
+
+    void clearIndex()
+    {
+        childrenByName.reset();
+    }
+
+private:
+    //! Children by name, built by childrenNamed().
+    std::unique_ptr<std::unordered_map<std::string, std::vector<XMLNode*>>> childrenByName;
+};
+
+//! @brief Path of nodes compiled once, e.g. "/nn/layers/layer[1]/neurons/neuron", to be
+//! evaluated many times without parsing it again or allocating. The first name is the one
+//! of the node queried and each following name is a child of the previous node; [n]
+//! selects the nth child of that name, the first one by default. Without an index, the
+//! last name selects all the children of that name in a collection.
+//! With @p indexChildren the children are found through the index of each node, built
+//! at the first query (see XMLNode::childrenNamed()), instead of scanning them all.
+class XMLQuery
+{
+public:
+    //! @throws std::domain_error If @p path has no name or an invalid index.
+    explicit XMLQuery(const std::string& path, bool indexChildren = false) :
+        m_IndexChildren(indexChildren)
     {
-        const char delimiter = '/';
-        XMLNode* curNode = this;
-        XMLNode* node = nullptr;
+        size_t begin = 0;
+
+        while (begin < path.size())
+        {
+            size_t end = path.find('/', begin);
+            end = end == std::string::npos ? path.size() : end;
+
+            if (end > begin)
+            {
+                m_Steps.push_back(parseStep(path.substr(begin, end - begin)));
+            }
+
+            begin = end + 1;
+        }
 
-        // Remove first delimiter if exists
-        if (!path.empty() && path[0] == delimiter)
+        if (m_Steps.empty())
         {
-            path.erase(0, 1);
+            throw std::domain_error("[XML query] Path has no node name.");
         }
+    }
+
+    // No need to apply the rule of five as the class contains no raw pointers
+
+    //! @returns Node of the path from @p root, taking the first child when there is no
+    //!   index; nullptr if there is none.
+    XMLNode* node(XMLNode& root) const
+    {
+        XMLNode* node = m_Steps[0].name == root.name ? &root : nullptr;
 
-        // Add a delimiter to the end if it does not exist
-        if (!path.empty() && path[path.size() - 1] != delimiter)
+        for (size_t s = 1; s < m_Steps.size() && node != nullptr; s++)
         {
-            path += delimiter;
+            node = child(*node, m_Steps[s]);
         }
 
-        size_t pos = 0;
-        std::string token;
+        return node;
+    }
 
-        if ((pos = path.find(delimiter)) != std::string::npos
-            && path.substr(0, pos) == curNode->name)
+    //! Appends the nodes of the path from @p root to @p nodes: all the children named
+    //! after the last name if it has no index. The capacity of @p nodes is reused.
+    void collect(XMLNode& root, std::vector<XMLNode*>& nodes) const
+    {
+        const Step& last = m_Steps.back();
+
+        if (m_Steps.size() == 1 || last.indexed)
         {
-            // Check whether it is at the right place, i.e. the top node provided is
-            // the current node. Once done, remove it from the hierarchy.
-            path.erase(0, pos + 1);
+            XMLNode* found = node(root);
 
-            while ((pos = path.find(delimiter)) != std::string::npos)
+            if (found != nullptr)
             {
-                token = path.substr(0, pos);
-                size_t index = 0;
+                nodes.push_back(found);
+            }
 
-                size_t indexB = token.find_first_of('[');
-                size_t indexE = token.find_first_of(']');
+            return;
+        }
 
-                if (indexB != std::string::npos && indexE != std::string::npos)
-                {
-                    std::stringstream sstream(token.substr(indexB + 1, indexE - indexB - 1));
-                    sstream >> index;
-                    token = token.substr(0, indexB);
-                }
+        XMLNode* parent = m_Steps[0].name == root.name ? &root : nullptr;
 
-                size_t n = 0;
+        for (size_t s = 1; s + 1 < m_Steps.size() && parent != nullptr; s++)
+        {
+            parent = child(*parent, m_Steps[s]);
+        }
 
-                for (size_t i = 0; i < curNode->children.size() && n <= index; i++)
+        if (parent == nullptr)
+        {
+            return;
+        }
+
+        if (m_IndexChildren)
+        {
+            const std::vector<XMLNode*>& named = parent->childrenNamed(last.name);
+            nodes.insert(nodes.end(), named.cbegin(), named.cend());
+        }
+        else
+        {
+            for (const std::unique_ptr<XMLNode>& child : parent->children)
+            {
+                if (child->name == last.name)
                 {
-                    if (curNode->children[i]->name == token)
-                    {
-                        if (n == index)
-                        {
-                            curNode = curNode->children[i].get();
-
-                            // If there is only one delimiter left (at the end)
-                            // it means the element the user seeks is found. 
-                            // Returns that element.
-                            if (std::count(path.begin(), path.end(), delimiter) == 1)
-                            {
-                                node = curNode;
-                            }
-                        }
-
-                        n++;
-                    }
+                    nodes.push_back(child.get());
                 }
-
-                path.erase(0, pos + 1);
             }
         }
+    }
 
-        return node;
+    std::vector<XMLNode*> collection(XMLNode& root) const
+    {
+        std::vector<XMLNode*> nodes;
+        collect(root, nodes);
+
+        return nodes;
     }
 
-    std::vector<XMLNode*> getCollection(std::string path)
+private:
+    struct Step
     {
-        const char delimiter = '/';
-        XMLNode* curNode = this;
-        std::vector<XMLNode*> collection;
+        std::string name;
+        size_t index = 0;
+        bool indexed = false;
+    };
 
-        // Remove first delimiter if exists
-        if (!path.empty() && path[0] == delimiter)
-        {
-            path.erase(0, 1);
-        }
+    std::vector<Step> m_Steps;
+    bool m_IndexChildren = false;
 
-        // Add a delimiter to the end if it does not exist
-        if (!path.empty() && path[path.size() - 1] != delimiter)
+    static Step parseStep(const std::string& token)
+    {
+        Step step;
+        const size_t indexB = token.find('[');
+
+        if (indexB == std::string::npos)
         {
-            path += delimiter;
+            step.name = token;
+            return step;
         }
 
-        size_t pos = 0;
-        std::string token;
+        const size_t indexE = token.find(']', indexB);
+        char* digitsEnd = nullptr;
+        step.index = std::strtoul(token.c_str() + indexB + 1, &digitsEnd, 10);
 
-        if ((pos = path.find(delimiter)) != std::string::npos
-            && path.substr(0, pos) == curNode->name)
+        if (indexB == 0 || indexE != token.size() - 1 || indexE == indexB + 1
+            || digitsEnd != token.c_str() + indexE)
         {
-            path.erase(0, pos + 1);
+            throw std::domain_error("[XML query] Invalid node " + token + ".");
+        }
 
-            while ((pos = path.find(delimiter)) != std::string::npos)
-            {
-                token = path.substr(0, pos);
-                size_t index = 0;
+        step.name = token.substr(0, indexB);
+        step.indexed = true;
 
-                size_t indexB = token.find_first_of('[');
-                size_t indexE = token.find_first_of(']');
-                bool indexFound = (indexB != std::string::npos && indexE != std::string::npos);
+        return step;
+    }
 
-                if (indexFound)
-                {
-                    std::stringstream sstream(token.substr(indexB + 1, indexE - indexB - 1));
-                    sstream >> index;
-                    token = token.substr(0, indexB);
-                }
+    XMLNode* child(XMLNode& parent, const Step& step) const
+    {
+        if (m_IndexChildren)
+        {
+            const std::vector<XMLNode*>& named = parent.childrenNamed(step.name);
 
-                size_t n = 0;
-                bool lastElement = (std::count(path.begin(), path.end(), delimiter) == 1);
+            return step.index < named.size() ? named[step.index] : nullptr;
+        }
 
-                for (size_t i = 0; i < curNode->children.size() && n <= index; i++)
-                {
-                    if (curNode->children[i]->name == token)
-                    {
-                        if (!lastElement)
-                        {
-                            if (n == index)
-                            {
-                                curNode = curNode->children[i].get();
-                            }
-
-                            n++;
-                        }
-                        else // if (lastElement)
-                        {
-                            if (indexFound)
-                            {
-                                // e.g. /network/layers/layer[1]/neurons[0]
-                                // Index provided: add only the requested node
-                                if (n == index)
-                                {
-                                    collection.push_back(curNode->children[i].get());
-                                }
-
-                                n++;
-                            }
-                            else // if (!indexFound)
-                            {
-                                // e.g. /network/layers/layer[1]/neurons
-                                // No index provided: add all the nodes
-                                collection.push_back(curNode->children[i].get());
-                            }
-                        }
-                    }
-                }
+        size_t n = 0;
 
-                path.erase(0, pos + 1);
+        for (const std::unique_ptr<XMLNode>& child : parent.children)
+        {
+            if (child->name == step.name && n++ == step.index)
+            {
+                return child.get();
             }
         }
 
-        return collection;
+        return nullptr;
     }
 };
 
+inline XMLNode* XMLNode::getNode(const std::string& path)
+{
+    return XMLQuery(path).node(*this);
+}
+
+inline std::vector<XMLNode*> XMLNode::getCollection(const std::string& path)
+{
+    return XMLQuery(path).collection(*this);
+}
+
 std::unique_ptr<XMLNode> readXMLStream(std::istream& ifs)
 {
     std::string line, tag, attr, value;
@@ -0,0 +1,526 @@
+//! Yet Another Neural Network Library C++ (YANNL-C++)
+//! @copyright  Copyright(c) 2022 - Mickael Deloison
+//! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
+
+#ifndef YANNL_XML_DOCUMENT_H
+#define YANNL_XML_DOCUMENT_H
+
+#include <algorithm>    // std::sort
+#include <cstring>      // std::strlen & std::memcmp
+#include <fstream>      // std::ifstream
+#include <iterator>     // std::istreambuf_iterator
+#include <memory>       // std::unique_ptr
+#include <sstream>      // std::ostringstream
+#include <stdexcept>    // std::domain_error
+#include <string>       // std::string
+#include <vector>       // std::vector
+
+namespace YANNL
+{
+
+//! Characters of the buffer of an XMLDocument; not null-terminated.
+struct XMLString
+{
+    const char* data = nullptr;
+    size_t size = 0;
+
+    bool empty() const
+    {
+        return size == 0;
+    }
+
+    std::string str() const
+    {
+        return std::string(data, size);
+    }
+
+    bool operator==(const XMLString& other) const
+    {
+        return size == other.size && std::memcmp(data, other.data, size) == 0;
+    }
+
+    bool operator==(const char* other) const
+    {
+        return std::strlen(other) == size && std::memcmp(data, other, size) == 0;
+    }
+
+    bool operator!=(const char* other) const
+    {
+        return !(*this == other);
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const XMLString& str)
+{
+    return os.write(str.data, str.size);
+}
+
+struct XMLAttribute
+{
+    XMLString name;
+    XMLString value;
+};
+
+//! Element of an XMLDocument. Children are linked from the first one to the last one.
+struct XMLElement
+{
+    XMLString name;
+    //! Text before the first child or the closing tag, trimmed; the last non-empty text
+    //! if comments split it. Entities are not decoded.
+    XMLString value;
+    const XMLAttribute* attributes = nullptr;
+    size_t attributesN = 0;
+    XMLElement* parent = nullptr;
+    XMLElement* firstChild = nullptr;
+    XMLElement* nextSibling = nullptr;
+    size_t childrenN = 0;
+
+    //! @returns Value of the attribute @p name; nullptr if there is none.
+    const XMLString* attribute(const char* name) const
+    {
+        for (size_t n = 0; n < attributesN; n++)
+        {
+            if (attributes[n].name == name)
+            {
+                return &attributes[n].value;
+            }
+        }
+
+        return nullptr;
+    }
+
+    //! @returns First child named @p name; nullptr if there is none.
+    const XMLElement* child(const char* name) const
+    {
+        for (const XMLElement* child = firstChild; child != nullptr; child = child->nextSibling)
+        {
+            if (child->name == name)
+            {
+                return child;
+            }
+        }
+
+        return nullptr;
+    }
+};
+
+//! @brief XML document parsed in one pass over the whole file read at once. Names,
+//! values and attributes refer to the characters of the buffer kept by the document
+//! instead of being copied. Attributes are stored in one flat vector and elements are
+//! allocated by blocks. Parsing does not recurse, so the depth of the document is not
+//! limited by the stack.
+//! Same syntax as readXMLStream(), plus self-closing tags, single quotes and
+//! processing instructions (<?xml ... ?>), which are skipped like comments.
+class XMLDocument
+{
+public:
+    //! Parses @p buffer, kept by the document.
+    //! @throws std::domain_error If the document has no element or if a closing tag does
+    //!   not match the opening one.
+    explicit XMLDocument(std::vector<char> buffer) :
+        m_Buffer(std::move(buffer))
+    {
+        parse();
+    }
+
+    //! @throws std::domain_error If the file cannot be read or is not valid.
+    static XMLDocument readFile(const std::string& filepath)
+    {
+        std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+
+        if (!file)
+        {
+            throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+                << "[XML document] " << filepath << " is not accessible.").str()
+            );
+        }
+
+        std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(buffer.data(), buffer.size());
+
+        return XMLDocument(std::move(buffer));
+    }
+
+    //! Reads the rest of @p is, then parses it.
+    static XMLDocument read(std::istream& is)
+    {
+        return XMLDocument(std::vector<char>(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>()));
+    }
+
+    // Elements refer to the buffer and to each other: movable but not copyable
+    XMLDocument(XMLDocument&&) = default;
+    XMLDocument& operator=(XMLDocument&&) = default;
+    XMLDocument(const XMLDocument&) = delete;
+    XMLDocument& operator=(const XMLDocument&) = delete;
+
+    const XMLElement& root() const
+    {
+        return *m_Root;
+    }
+
+    //! @returns Number of elements of the document.
+    size_t size() const
+    {
+        return m_ElementsN;
+    }
+
+    //! Same output as XMLNode::inspect(): attributes sorted by name.
+    void inspect(std::ostream& os) const
+    {
+        // Elements still to close, with their indentation
+        std::vector<std::pair<const XMLElement*, size_t>> open;
+        std::vector<const XMLAttribute*> attributes;
+        const XMLElement* element = m_Root;
+        size_t indent = 0;
+
+        while (element != nullptr)
+        {
+            attributes.clear();
+
+            for (size_t n = 0; n < element->attributesN; n++)
+            {
+                attributes.push_back(&element->attributes[n]);
+            }
+
+            std::sort(attributes.begin(), attributes.end(),
+                [](const XMLAttribute* a, const XMLAttribute* b)
+                {
+                    return std::lexicographical_compare(a->name.data, a->name.data + a->name.size,
+                        b->name.data, b->name.data + b->name.size);
+                });
+
+            os << std::string(indent, ' ') << "<" << element->name;
+
+            for (const XMLAttribute* attribute : attributes)
+            {
+                os << " " << attribute->name << "=\"" << attribute->value << "\"";
+            }
+
+            os << ">";
+
+            if (element->firstChild != nullptr)
+            {
+                os << "\n";
+
+                if (!element->value.empty())
+                {
+                    os << std::string(indent + 2, ' ') << element->value << "\n";
+                }
+
+                open.emplace_back(element, indent);
+                element = element->firstChild;
+                indent += 2;
+                continue;
+            }
+
+            os << element->value << "</" << element->name << ">\n";
+
+            // Closes the parents whose last child was just written
+            while (element->nextSibling == nullptr && !open.empty())
+            {
+                element = open.back().first;
+                indent = open.back().second;
+                open.pop_back();
+                os << std::string(indent, ' ') << "</" << element->name << ">\n";
+            }
+
+            element = open.empty() ? nullptr : element->nextSibling;
+        }
+    }
+
+private:
+    //! Number of elements per block of the arena.
+    static constexpr size_t kBlockSize = 1024;
+
+    std::vector<char> m_Buffer;
+    std::vector<XMLAttribute> m_Attributes;
+    std::vector<std::unique_ptr<XMLElement[]>> m_Blocks;
+    size_t m_ElementsN = 0;
+    XMLElement* m_Root = nullptr;
+
+    XMLElement* newElement()
+    {
+        if (m_ElementsN % kBlockSize == 0)
+        {
+            m_Blocks.emplace_back(new XMLElement[kBlockSize]);
+        }
+
+        return &m_Blocks.back()[m_ElementsN++ % kBlockSize];
+    }
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+
+    static XMLString trimmed(const char* begin, const char* end)
+    {
+        while (begin < end && isSpace(*begin))
+        {
+            ++begin;
+        }
+
+        while (end > begin && isSpace(end[-1]))
+        {
+            --end;
+        }
+
+        XMLString str;
+        str.data = begin;
+        str.size = static_cast<size_t>(end - begin);
+
+        return str;
+    }
+
+    //! @returns Position of @p pattern from @p p; @p end if not found.
+    static const char* find(const char* p, const char* end, const char* pattern)
+    {
+        const size_t length = std::strlen(pattern);
+
+        while (static_cast<size_t>(end - p) >= length)
+        {
+            p = static_cast<const char*>(std::memchr(p, pattern[0], static_cast<size_t>(end - p)));
+
+            if (p == nullptr || static_cast<size_t>(end - p) < length)
+            {
+                break;
+            }
+
+            if (std::memcmp(p, pattern, length) == 0)
+            {
+                return p;
+            }
+
+            ++p;
+        }
+
+        return end;
+    }
+
+    [[noreturn]] void throwError(const char* p, const std::string& msg) const
+    {
+        const size_t lineN = 1 + std::count(m_Buffer.data(), p, '\n');
+
+        throw std::domain_error(static_cast<const std::ostringstream&>(std::ostringstream()
+            << "[XML document] " << msg << " on line " << lineN << ".").str()
+        );
+    }
+
+    void parse()
+    {
+        const char* p = m_Buffer.data();
+        const char* const end = p + m_Buffer.size();
+        XMLElement* current = nullptr;
+        XMLElement* lastChild = nullptr;
+        // Indices of the attributes of each element, pointed to once all are read
+        std::vector<std::pair<XMLElement*, size_t>> firstAttributes;
+        const char* text = p;
+
+        while (true)
+        {
+            const char* tag = static_cast<const char*>(std::memchr(p, '<', static_cast<size_t>(end - p)));
+
+            if (tag == nullptr)
+            {
+                break;
+            }
+
+            // The value is the text before the first child or the closing tag
+            if (current != nullptr && current->firstChild == nullptr)
+            {
+                const XMLString value = trimmed(text, tag);
+
+                if (!value.empty())
+                {
+                    current->value = value;
+                }
+            }
+
+            p = tag + 1;
+
+            if (p < end && (*p == '!' || *p == '?'))
+            {
+                // Comment, processing instruction or declaration
+                const char* close = (end - p >= 3 && p[1] == '-' && p[2] == '-') ? find(p, end, "-->") + 2
+                    : *p == '?' ? find(p, end, "?>") + 1
+                    : find(p, end, ">");
+                p = close < end ? close + 1 : end;
+                text = p;
+                continue;
+            }
+
+            if (p < end && *p == '/')
+            {
+                const char* nameBegin = ++p;
+
+                while (p < end && *p != '>' && !isSpace(*p))
+                {
+                    ++p;
+                }
+
+                XMLString name;
+                name.data = nameBegin;
+                name.size = static_cast<size_t>(p - nameBegin);
+
+                if (current == nullptr || !(current->name == name))
+                {
+                    throwError(tag, "Closing tag </" + name.str() + "> does not match with opening tag <"
+                        + (current != nullptr ? current->name.str() : std::string()) + ">");
+                }
+
+                p = static_cast<const char*>(std::memchr(p, '>', static_cast<size_t>(end - p)));
+                p = p != nullptr ? p + 1 : end;
+                lastChild = current;
+                current = current->parent;
+                text = p;
+                continue;
+            }
+
+            XMLElement* element = newElement();
+            const char* nameBegin = p;
+
+            while (p < end && *p != '>' && *p != '/' && !isSpace(*p))
+            {
+                ++p;
+            }
+
+            element->name.data = nameBegin;
+            element->name.size = static_cast<size_t>(p - nameBegin);
+            element->parent = current;
+            firstAttributes.emplace_back(element, m_Attributes.size());
+            bool selfClosing = false;
+
+            // Attributes: name="value", name='value' or name=value
+            while (p < end && *p != '>')
+            {
+                if (isSpace(*p))
+                {
+                    ++p;
+                }
+                else if (*p == '/')
+                {
+                    selfClosing = true;
+                    ++p;
+                }
+                else
+                {
+                    XMLAttribute attribute;
+                    attribute.name.data = p;
+
+                    while (p < end && *p != '=' && *p != '>' && !isSpace(*p))
+                    {
+                        ++p;
+                    }
+
+                    attribute.name.size = static_cast<size_t>(p - attribute.name.data);
+
+                    while (p < end && isSpace(*p))
+                    {
+                        ++p;
+                    }
+
+                    if (p < end && *p == '=')
+                    {
+                        ++p;
+
+                        while (p < end && isSpace(*p))
+                        {
+                            ++p;
+                        }
+
+                        if (p < end && (*p == '"' || *p == '\''))
+                        {
+                            const char* quote = static_cast<const char*>(
+                                std::memchr(p + 1, *p, static_cast<size_t>(end - p - 1)));
+
+                            if (quote == nullptr)
+                            {
+                                throwError(tag, "Attribute value is not closed");
+                            }
+
+                            attribute.value.data = p + 1;
+                            attribute.value.size = static_cast<size_t>(quote - p - 1);
+                            p = quote + 1;
+                        }
+                        else
+                        {
+                            attribute.value.data = p;
+
+                            while (p < end && *p != '>' && !isSpace(*p))
+                            {
+                                ++p;
+                            }
+
+                            attribute.value.size = static_cast<size_t>(p - attribute.value.data);
+                        }
+                    }
+
+                    m_Attributes.push_back(attribute);
+                    selfClosing = false;
+                }
+            }
+
+            if (p == end)
+            {
+                throwError(tag, "Tag <" + element->name.str() + "> is not closed");
+            }
+
+            ++p;
+            element->attributesN = m_Attributes.size() - firstAttributes.back().second;
+
+            if (current == nullptr)
+            {
+                if (m_Root != nullptr)
+                {
+                    throwError(tag, "Document has several root elements");
+                }
+
+                m_Root = element;
+            }
+            else
+            {
+                if (current->firstChild == nullptr)
+                {
+                    current->firstChild = element;
+                }
+                else
+                {
+                    lastChild->nextSibling = element;
+                }
+
+                ++current->childrenN;
+            }
+
+            if (selfClosing)
+            {
+                lastChild = element;
+            }
+            else
+            {
+                current = element;
+                lastChild = nullptr;
+            }
+
+            text = p;
+        }
+
+        if (m_Root == nullptr)
+        {
+            throw std::domain_error("[XML document] Document has no element.");
+        }
+        else if (current != nullptr)
+        {
+            throwError(end, "Tag <" + current->name.str() + "> is not closed");
+        }
+
+        for (const std::pair<XMLElement*, size_t>& first : firstAttributes)
+        {
+            first.first->attributes = m_Attributes.data() + first.second;
+        }
+    }
+};
+
+}
+
+#endif // YANNL_XML_DOCUMENT_H
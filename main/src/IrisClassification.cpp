@@ -3,7 +3,9 @@
 //! @license    https://opensource.org/licenses/GPL-3.0 GPL-3.0
 
 #include "IrisClassification.h"
+#include "CsvReader.h"
 #include "MLP.h"
+#include "ProgressReporter.h"
 
 #include <iomanip>  // std::setprecision
 #include <cassert>  // assert()
@@ -15,23 +17,15 @@ namespace YANNL
 
 void IrisClassification::loadIrisDataset(const std::string& irisDataSetPath)
 {
-    Utils::ShowConsoleCursor(false);
-
     std::cout << "Loading " << irisDataSetPath << " file... ";
 
-    char c; // To eat the commas
-
-    double sepalLength = 0.0, sepalWidth = 0.0, petalLength = 0.0, petalWidth = 0.0;
-    std::string irisClass;
-
-    std::ifstream file(irisDataSetPath);
-    std::string line;
+    CsvOptions options;
+    options.labels = true;
+    const CsvDataset dataset = CsvReader::read(irisDataSetPath, options);
 
-    std::getline(file, line); // Ignore header line
-
-    while (file >> sepalLength >> c >> sepalWidth >> c >> petalLength >> c
-        >> petalWidth >> c >> irisClass)
+    for (size_t r = 0; r < dataset.rowsN; r++)
     {
+        const std::string& irisClass = dataset.labels[static_cast<size_t>(dataset.targets[r])];
         t_IrisCls cls = 0;
 
         if (irisClass == "iris_setosa") { cls = 0; }
@@ -39,10 +33,9 @@ void IrisClassification::loadIrisDataset(const std::string& irisDataSetPath)
         else if (irisClass == "iris_virginica") { cls = 2; }
 
         m_IrisData.push_back({
-            t_IrisData({ sepalLength, sepalWidth, petalLength, petalWidth }),
+            t_IrisData(dataset.row(r), dataset.row(r) + dataset.colsN),
             t_IrisCls(cls)
             });
-
     }
 
     assert(m_IrisData.size() == 150);
@@ -70,29 +63,10 @@ void IrisClassification::irisClassificationTrainTestManualNN(const std::string&
     net.addOutputClassificationLayer(3);
 
     double error = 0.0;
-    char current_pos_char = '/';
+    ProgressReporter progress(std::cout, kEpochN, "Epoch", std::chrono::milliseconds(200), kBarWidth);
 
     for (size_t epoch = 0; epoch < kEpochN; epoch++)
     {
-        std::cout << "Epoch " << (epoch + 1) << " / " << kEpochN << " [ ";
-        double progress = epoch * 100.0 / kEpochN;
-        size_t position = static_cast<size_t>(progress / 100.0 * kBarWidth);
-
-        if (kEpochN >= kBarWidth && epoch % (kEpochN / kBarWidth) == 0)
-        {
-            if (current_pos_char == '/') { current_pos_char = '\\'; }
-            else { current_pos_char = '/'; }
-        }
-
-        for (size_t i = 0; i < kBarWidth; i++)
-        {
-            if (i < position) { std::cout << "="; }
-            else if (i == position) { std::cout << current_pos_char; }
-            else { std::cout << "_"; }
-        }
-
-        std::cout << " ] " << static_cast<int>(progress) << "% | Error: ";
-
         error = 0.0;
 
         for (const std::pair<t_IrisData, t_IrisCls>& irisItem : m_IrisData)
@@ -103,24 +77,10 @@ void IrisClassification::irisClassificationTrainTestManualNN(const std::string&
             error += net.calcError(expectedOutput);
         }
 
-        if (kEpochN >= kBarWidth && epoch % (kEpochN / kBarWidth) == 0)
-        {
-            std::cout << std::fixed << std::setprecision(4)
-                << (error / m_IrisData.size());
-        }
-
-        std::cout << "\r";
-        std::cout.flush();
-    }
-
-    std::cout << "Epoch " << kEpochN << " / " << kEpochN << " [ ";
-
-    for (size_t i = 0; i < kBarWidth; i++)
-    {
-        std::cout << "=";
+        progress.update(epoch + 1, error / m_IrisData.size());
     }
 
-    std::cout << " ] 100% | Error: " << (error / m_IrisData.size()) << "\n";
+    progress.finish();
 
     std::cout << "done. \n";
 
@@ -5,8 +5,7 @@
 #include "MnistPrediction.h"
 #include "NeuralNetwork.h"
 #include "MnistReader.h"
-
-#include <iomanip> // std::setprecision
+#include "ProgressReporter.h"
 
 using namespace YANNL;
 
@@ -16,9 +15,6 @@ namespace YANNL
 void MnistPrediction::mnistTrain(const std::string& trainImagePath, const std::string& trainLabelPath,
     const std::string& outputPath)
 {
-    Utils::ShowConsoleCursor(false);
-    constexpr size_t kBarWidth = 50;
-
     // Read training images
     std::cout << "Opening training image file... \n";
     MnistReader::ImageContainer trainImages;
@@ -57,55 +53,29 @@ void MnistPrediction::mnistTrain(const std::string& trainImagePath, const std::s
 
     for (size_t epoch = 0; epoch < epochN; epoch++)
     {
-        std::cout << "Epoch " << (epoch + 1) << " / " << epochN << "\n";
-        char current_pos_char = '/';
+        // The progress is rendered from another thread a few times per second
+        ProgressReporter progress(std::cout, static_cast<size_t>(trainCount),
+            "Epoch " + std::to_string(epoch + 1) + " / " + std::to_string(epochN) + " |");
 
         // For each set of image and label
 
         for (size_t n = 0; n < static_cast<size_t>(trainCount); n++)
         {
-            if (n % 50 == 0)
-            {
-                if (current_pos_char == '/') { current_pos_char = '\\'; }
-                else { current_pos_char = '/'; }
-            }
-
-            std::cout << (n + 1) << " / " << trainCount << " [ ";
-            double progress = n * 100.0 / trainCount;
-            size_t position = static_cast<size_t>(progress / 100.0 * kBarWidth);
-
             net.propagateForward(trainNormImages[n]);
             net.propagateBackward(Utils::convertLabelToVect(trainLabels[n], 0, 9));
 
-            for (size_t i = 0; i < kBarWidth; i++)
+            if (n % 100 == 0)
             {
-                if (i < position) { std::cout << "="; }
-                else if (i == position) { std::cout << current_pos_char; }
-                else { std::cout << "_"; }
+                progress.update(n + 1, net.calcError(Utils::convertLabelToVect(trainLabels[n], 0, 9)));
             }
-
-            std::cout << " ] " << static_cast<int>(progress) << "% | Error: ";
-
-            if (n % 100 == 0)
+            else
             {
-                std::cout << std::fixed << std::setprecision(4)
-                    << net.calcError(Utils::convertLabelToVect(trainLabels[n], 0, 9));
+                progress.update(n + 1);
             }
-
-            std::cout << "\r";
-            std::cout.flush();
         }
 
-        std::cout << trainCount << " / " << trainCount << " [ ";
-
-        for (size_t i = 0; i < kBarWidth; i++)
-        {
-            std::cout << "=";
-        }
-
-        std::cout << " ] 100% | Error: "
-            << net.calcError(Utils::convertLabelToVect(trainLabels.back(), 0, 9)) << "\n";
-        std::cout.unsetf(std::ios_base::fixed);
+        progress.update(trainCount, net.calcError(Utils::convertLabelToVect(trainLabels.back(), 0, 9)));
+        progress.finish();
     }
 
     net.saveToFile(outputPath);
@@ -115,9 +85,6 @@ void MnistPrediction::mnistTrain(const std::string& trainImagePath, const std::s
 void MnistPrediction::mnistTest(const std::string& networkPath, const std::string& testImagePath,
     const std::string& testLabelPath)
 {
-    Utils::ShowConsoleCursor(false);
-    constexpr size_t kBarWidth = 50;
-
     // Read test images
     std::cout << "Opening test image file... \n";
     MnistReader::ImageContainer testImages;
@@ -150,12 +117,10 @@ void MnistPrediction::mnistTest(const std::string& networkPath, const std::strin
 
     std::cout << "Start validating the network on " << testCount << " images... \n";
     size_t passed = 0;
+    ProgressReporter progress(std::cout, static_cast<size_t>(testCount));
 
     for (size_t n = 0; n < static_cast<size_t>(testCount); n++)
     {
-        std::cout << (n + 1) << " / " << testCount << " [ ";
-        double progress = n * 100.0 / testCount;
-        size_t position = static_cast<size_t>(progress / 100.0 * kBarWidth);
         constexpr bool ignoreDropout = true;
 
         net.propagateForward(testNormImages[n], ignoreDropout);
@@ -165,25 +130,10 @@ void MnistPrediction::mnistTest(const std::string& networkPath, const std::strin
             passed++;
         }
 
-        for (size_t i = 0; i < kBarWidth; i++)
-        {
-            if (i < position) { std::cout << "="; }
-            else if (i == position) { std::cout << "/"; }
-            else { std::cout << "_"; }
-        }
-
-        std::cout << " ] " << static_cast<int>(progress) << "% \r";
-        std::cout.flush();
-    }
-
-    std::cout << testCount << " / " << testCount << " [ ";
-
-    for (size_t i = 0; i < kBarWidth; i++)
-    {
-        std::cout << "=";
+        progress.update(n + 1);
     }
 
-    std::cout << " ] 100% \n";
+    progress.finish();
     std::cout << "Validation results: passed " << passed << " / " << testCount << " "
         << "( accuracy " << (passed * 100.0 / testCount) << "% ). \n";
 }
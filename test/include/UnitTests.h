@@ -7,7 +7,12 @@
 
 #include "MLP.h"
 #include "MnistReader.h"
+#include "CsvReader.h"
 #include "SimpleXMLReader.h"
+#include "XMLDocument.h"
+#include "NetworkXML.h"
+#include "ProgressReporter.h"
+#include "InferenceServer.h"
 #include <cassert> // assert for testing purpose
 
 using namespace YANNL;
@@ -104,6 +109,38 @@ public:
                 "classification layer of 3 neurons... ";
             saveAndLoadNetworkClassificationOutput3N();
             std::cout << "done. \n";
+
+            std::cout << ">> Testing in-memory snapshot and restore of the network parameters... ";
+            snapshotAndRestoreParameters();
+            std::cout << "done. \n";
+
+            std::cout << ">> Testing binary checkpoints written in the background and exact resume... ";
+            binaryCheckpoints();
+            std::cout << "done. \n";
+
+            std::cout << ">> Testing activation checkpoints on a deep network with dropout... ";
+            activationCheckpoints();
+            std::cout << "done. \n";
+
+            std::cout << ">> Testing the compiled inference plan of a network with dropout... ";
+            compiledInferencePlan();
+            std::cout << "done. \n";
+
+            std::cout << ">> Testing micro-batched inference requests from several threads... ";
+            inferenceServer();
+            std::cout << "done. \n";
+
+            std::cout << ">> Testing the gradients of convolutional and pooling layers... ";
+            convolutionGradients();
+            std::cout << "done. \n";
+
+            std::cout << ">> Testing the direct and im2col convolutions... ";
+            convolutionAlgorithms();
+            std::cout << "done. \n";
+
+            std::cout << ">> Testing save, load and inference plan of a convolutional network... ";
+            convolutionalNetwork();
+            std::cout << "done. \n";
         }
         catch (std::exception& e)
         {
@@ -134,6 +171,10 @@ public:
             << "network in the middle of a batch training... ";
         batchSaveAndLoadNetworkClassification();
         std::cout << "done. \n";
+
+        std::cout << ">> Testing weight updates of a wide layer split across 4 threads... ";
+        batchParallelUpdate();
+        std::cout << "done. \n";
     }
 
     void execMnistTests()
@@ -157,6 +198,22 @@ public:
             "weights but fixed seed... ";
         xorRandomWeightsFixedSeed();
         std::cout << "done. \n";
+
+        std::cout << ">> Testing the progress reporter rendering from its own thread... ";
+        progressReporter();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing the counter-based random generator for weights and dropout... ";
+        philoxGenerator();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing the bit-packed dropout mask... ";
+        dropoutMask();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing the CSV reader by chunks on several threads and fitting its matrix... ";
+        csvReader();
+        std::cout << "done. \n";
     }
 
     void execXMLTests()
@@ -164,6 +221,18 @@ public:
         std::cout << ">> Reading XML file, saving it and comparing it... ";
         xmlReadAndSave();
         std::cout << "done. \n";
+
+        std::cout << ">> Reading XML file in one buffer with the non-recursive parser... ";
+        xmlDocument();
+        std::cout << "done. \n";
+
+        std::cout << ">> Querying XML nodes with compiled paths, with and without index... ";
+        xmlQuery();
+        std::cout << "done. \n";
+
+        std::cout << ">> Saving and loading a network in XML with base64 and hex blocks of weights... ";
+        networkXML();
+        std::cout << "done. \n";
     }
 
     void execMLPTests()
@@ -195,6 +264,42 @@ public:
         std::cout << ">> Testing MLPRegressor with full batch... ";
         mlpRegressorBatch();
         std::cout << "done. \n";
+
+        std::cout << ">> Testing MLPRegressor with early stopping on a validation set... ";
+        mlpRegressorValidationEarlyStopping();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing learning rate schedulers with warmup, step decay, cosine and one cycle... ";
+        learningRateSchedulers();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing training metrics reported to an observer... ";
+        trainingObserver();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing the time and cost of each layer recorded by a profiler... ";
+        layerProfiler();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing the memory and operations estimated for a network... ";
+        networkFootprint();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing the batch sizes and thread count found by the autotuner and cached... ";
+        autotuner();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing MLPRegressor and MLPClassifier trained on streams of samples... ";
+        mlpStreamingFit();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing partial_fit continuing the training on new samples... ";
+        mlpPartialFit();
+        std::cout << "done. \n";
+
+        std::cout << ">> Testing MLPRegressor resumed exactly from a checkpoint... ";
+        mlpCheckpointResume();
+        std::cout << "done. \n";
     }
 
 private:
@@ -800,6 +905,553 @@ private:
         }
     }
 
+    void snapshotAndRestoreParameters()
+    {
+        NeuralNetwork net(2, 0.5, 0.9, true, 10);
+        net.addHiddenLayer(5, ActivationFunctions::Logistic);
+        net.addDropoutLayer(0.2);
+        net.addOutputRegressionLayer(2, ActivationFunctions::Logistic);
+
+        net.propagateForward({ 0.05, 0.1 });
+        net.propagateBackwardAndUpdateWeights({ 0.01, 0.99 });
+
+        std::vector<double> params;
+        net.copyParameters(params);
+        assert(params.size() == net.parametersCount() && params.size() == 5 * 3 + 2 * 6);
+        std::vector<double> outputSnapshot = net.propagateForward({ 0.05, 0.1 }, true);
+
+        for (size_t n = 0; n < 10; n++)
+        {
+            net.propagateForward({ 0.05, 0.1 });
+            net.propagateBackwardAndUpdateWeights({ 0.01, 0.99 });
+        }
+
+        assert(net.propagateForward({ 0.05, 0.1 }, true) != outputSnapshot);
+
+        net.restoreParameters(params);
+        assert(net.propagateForward({ 0.05, 0.1 }, true) == outputSnapshot);
+
+        try
+        {
+            params.pop_back();
+            net.restoreParameters(params);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+    }
+
+    void binaryCheckpoints()
+    {
+        auto buildNet = [](unsigned int seed)
+        {
+            NeuralNetwork net(2, 0.5, 0.9, true, seed);
+            net.addHiddenLayer(5, ActivationFunctions::Logistic);
+            net.addDropoutLayer(0.2);
+            net.addOutputRegressionLayer(2, ActivationFunctions::Logistic);
+
+            return net;
+        };
+
+        auto trainEpoch = [](NeuralNetwork& net)
+        {
+            net.propagateForward({ 0.05, 0.1 });
+            net.propagateBackwardAndUpdateWeights({ 0.01, 0.99 });
+            net.propagateForward({ 0.9, 0.3 });
+            net.propagateBackwardAndUpdateWeights({ 0.7, 0.2 });
+        };
+
+        const std::string prefix = std::string(kOutputDir) + "binaryCheckpoints";
+        std::remove((prefix + ".latest").c_str());
+
+        NeuralNetwork net = buildNet(10);
+        std::vector<std::string> kept;
+
+        {
+            CheckpointWriter writer(prefix, 2);
+
+            for (size_t epoch = 1; epoch <= 6; epoch++)
+            {
+                trainEpoch(net);
+                writer.save(net, epoch, 2 * epoch);
+            }
+
+            writer.wait();
+            kept = writer.checkpoints();
+            assert(kept.size() == 2 && kept[0] == writer.path(5) && kept[1] == writer.path(6));
+            assert(!std::ifstream(writer.path(4)) && !std::ifstream(writer.path(5) + ".tmp"));
+        }
+
+        trainEpoch(net);
+        const std::vector<double> outputs = net.propagateForward({ 0.05, 0.1 });
+
+        // Weights, momentum, learning rate and dropout generator restored in another
+        // network: the next epoch is the same
+        NeuralNetwork resumed = buildNet(99);
+        TrainingState state;
+        assert(CheckpointWriter::restoreLatest(prefix, resumed, state));
+        assert(state.epoch == 6 && state.step == 12);
+        trainEpoch(resumed);
+        assert(resumed.propagateForward({ 0.05, 0.1 }) == outputs);
+
+        NeuralNetwork other(2, 0.5, 0.9);
+        other.addHiddenLayer(4, ActivationFunctions::Logistic);
+        other.addOutputRegressionLayer(2, ActivationFunctions::Logistic);
+
+        try
+        {
+            CheckpointWriter::restoreLatest(prefix, other, state);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        {
+            std::fstream file(kept[1], std::ios::in | std::ios::out | std::ios::binary);
+            file.seekp(40);
+            file.put('\x7f');
+        }
+
+        try
+        {
+            CheckpointWriter::read(kept[1]);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        for (const std::string& file : kept)
+        {
+            std::remove(file.c_str());
+        }
+
+        std::remove((prefix + ".latest").c_str());
+
+        // Epochs written again by a new writer, e.g. for a second training, become the
+        // latest checkpoints and are never deleted while listed
+        {
+            CheckpointWriter writer(prefix, 3);
+
+            for (size_t epoch = 1; epoch <= 3; epoch++)
+            {
+                writer.save(net, epoch, epoch);
+            }
+
+            writer.wait();
+        }
+
+        CheckpointWriter writer(prefix, 3);
+        writer.save(resumed, 1, 100);
+        writer.wait();
+        kept = writer.checkpoints();
+        assert(kept.size() == 3 && kept[0] == writer.path(2) && kept[1] == writer.path(3) && kept[2] == writer.path(1));
+        assert(std::ifstream(writer.path(1)) && std::ifstream(writer.path(2)) && std::ifstream(writer.path(3)));
+        assert(CheckpointWriter::restoreLatest(prefix, net, state));
+        assert(state.epoch == 1 && state.step == 100);
+
+        for (const std::string& file : kept)
+        {
+            std::remove(file.c_str());
+        }
+
+        std::remove((prefix + ".latest").c_str());
+    }
+
+    void activationCheckpoints()
+    {
+        auto buildNet = [](size_t every)
+        {
+            NeuralNetwork net(4, 0.1, 0.9, true, 7);
+            net.addHiddenLayer(16, ActivationFunctions::Tanh);
+            net.addHiddenLayer(16, ActivationFunctions::ReLU);
+            net.addDropoutLayer(0.3);
+            net.addHiddenLayer(16, ActivationFunctions::Logistic);
+            net.addHiddenLayer(16, ActivationFunctions::Tanh);
+            net.addHiddenLayer(16, ActivationFunctions::ReLU);
+            net.addOutputClassificationLayer(3);
+            net.setActivationCheckpoints(every);
+            return net;
+        };
+
+        NeuralNetwork full = buildNet(0);
+        NeuralNetwork checkpointed = buildNet(3);
+        const std::vector<double> inputs{ 0.1, -0.4, 0.7, 0.2 };
+        const std::vector<double> expected{ 0.0, 1.0, 0.0 };
+
+        for (size_t n = 0; n < 5; n++)
+        {
+            full.propagateForward(inputs);
+            checkpointed.propagateForward(inputs);
+            assert(checkpointed.storedActivationsCount() < full.storedActivationsCount());
+
+            full.propagateBackwardAndUpdateWeights(expected);
+            checkpointed.propagateBackwardAndUpdateWeights(expected);
+        }
+
+        std::vector<double> paramsFull, paramsCheckpointed;
+        full.copyParameters(paramsFull);
+        checkpointed.copyParameters(paramsCheckpointed);
+        assert(paramsFull == paramsCheckpointed);
+
+        // Only the checkpoints remain once the segments are propagated backward:
+        // inputs of layers 0 (4 values), 3 and 6 (16 values each).
+        assert(checkpointed.storedActivationsCount() == 4 + 16 + 16);
+        assert(full.storedActivationsCount() == 4 + 16 * 5);
+    }
+
+    void compiledInferencePlan()
+    {
+        NeuralNetwork classifier(4, 0.1, 0.9, true, 3);
+        classifier.addHiddenLayer(12, ActivationFunctions::Tanh);
+        classifier.addDropoutLayer(0.4);
+        classifier.addHiddenLayer(8, ActivationFunctions::Identity);
+        classifier.addOutputClassificationLayer(3);
+
+        NeuralNetwork regressor(4, 0.1, 0.9, true, 3);
+        regressor.addDropoutLayer(0.2);
+        regressor.addHiddenLayer(6, ActivationFunctions::ReLU);
+        regressor.addOutputRegressionLayer(2, ActivationFunctions::Logistic);
+
+        const std::vector<std::vector<double>> samples{ { 0.1, -0.4, 0.7, 0.2 },
+            { -0.9, 0.3, 0.0, 0.5 }, { 0.6, 0.6, -0.2, -0.8 } };
+
+        for (const std::vector<double>& sample : samples)
+        {
+            classifier.propagateForward(sample);
+            classifier.propagateBackwardAndUpdateWeights({ 0.0, 1.0, 0.0 });
+            regressor.propagateForward(sample);
+            regressor.propagateBackwardAndUpdateWeights({ 0.2, 0.8 });
+        }
+
+        const InferencePlan classifierPlan = classifier.compile();
+        const InferencePlan regressorPlan = regressor.compile();
+        assert(classifierPlan.stepsCount() == 3 && regressorPlan.stepsCount() == 2);
+        assert(classifierPlan.outputSize() == 3 && regressorPlan.outputSize() == 2);
+
+        InferenceSession classifierSession(std::make_shared<InferencePlan>(classifierPlan));
+        InferenceSession regressorSession(std::make_shared<InferencePlan>(regressorPlan));
+
+        for (const std::vector<double>& sample : samples)
+        {
+            // Dropout is the identity when ignored
+            assert(classifierPlan.predict(sample) == classifier.propagateForward(sample, true));
+            assert(classifierPlan.probableClass(sample) == classifier.probableClass());
+            assert(regressorPlan.predict(sample) == regressor.propagateForward(sample, true));
+            assert(regressorPlan.probableClass(sample) == regressor.probableClass());
+
+            const double* outputs = classifierSession.predict(sample.data());
+            assert(std::vector<double>(outputs, outputs + 3) == classifierPlan.predict(sample));
+            assert(classifierSession.probableClass(sample.data()) == classifierPlan.probableClass(sample));
+            outputs = regressorSession.predict(sample.data());
+            assert(std::vector<double>(outputs, outputs + 2) == regressorPlan.predict(sample));
+        }
+
+        // Samples read through pointers, e.g. the validation rows of MLP::fit
+        const std::vector<std::vector<double>> batchOutputs = classifierPlan.predictBatch(samples);
+        std::vector<double> rowsOutputs;
+        classifierPlan.predictBatch({ samples[2].data(), samples[0].data() }, rowsOutputs);
+        assert(rowsOutputs.size() == 6);
+        assert(std::vector<double>(rowsOutputs.begin(), rowsOutputs.begin() + 3) == batchOutputs[2]);
+        assert(std::vector<double>(rowsOutputs.begin() + 3, rowsOutputs.end()) == batchOutputs[0]);
+
+        try
+        {
+            classifierPlan.predict({ 0.1, 0.2 });
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+    }
+
+    void inferenceServer()
+    {
+        NeuralNetwork net(5, 0.1, 0.9, true, 4);
+        net.addHiddenLayer(40, ActivationFunctions::Tanh);
+        net.addOutputClassificationLayer(4);
+        const std::shared_ptr<const InferencePlan> plan = std::make_shared<InferencePlan>(net.compile());
+
+        std::mt19937 gen(4);
+        std::uniform_real_distribution<double> dist(-1.0, 1.0);
+        std::vector<std::vector<double>> samples(64, std::vector<double>(5));
+
+        for (std::vector<double>& sample : samples)
+        {
+            std::generate(sample.begin(), sample.end(), [&]() { return dist(gen); });
+        }
+
+        const std::vector<std::vector<double>> expected = plan->predictBatch(samples);
+
+        for (size_t n = 0; n < samples.size(); n++)
+        {
+            assert(expected[n] == plan->predict(samples[n]));
+        }
+
+        std::vector<std::vector<double>> outputs(samples.size());
+
+        {
+            InferenceServer server(plan, 8, std::chrono::microseconds(1000));
+            std::vector<std::thread> clients;
+
+            for (size_t c = 0; c < 4; c++)
+            {
+                clients.emplace_back([&, c]()
+                    {
+                        for (size_t n = c; n < samples.size(); n += 4)
+                        {
+                            outputs[n] = server.predict(samples[n]).get();
+                        }
+                    });
+            }
+
+            for (std::thread& client : clients)
+            {
+                client.join();
+            }
+
+            assert(server.requestsCount() == samples.size());
+            assert(server.batchesCount() <= samples.size());
+
+            try
+            {
+                server.predict({ 0.1, 0.2 });
+                assert(false);
+            }
+            catch (std::domain_error&) {}
+        }
+
+        assert(outputs == expected);
+    }
+
+    void convolutionGradients()
+    {
+        // 1x7x7 -> 2x7x7 (direct, padded) -> 2x3x3 -> 3x2x2 (im2col, stride 2) -> 3x1x1
+        NeuralNetwork net(49, 1.0, 0.0, true, 4);
+        net.setInputShape(ImageShape(1, 7, 7));
+        net.addConv2DLayer(2, 3, ActivationFunctions::Logistic, 1, 1);
+        net.addMaxPoolLayer(2);
+        net.addConv2DLayer(3, 3, ActivationFunctions::Logistic, 2, 1);
+        net.addAvgPoolLayer(2);
+        net.addOutputRegressionLayer(2, ActivationFunctions::Identity);
+        assert(net.parametersCount() == 2 * 10 + 3 * 19 + 2 * 4);
+
+        std::vector<double> inputs(49);
+
+        for (size_t n = 0; n < inputs.size(); n++)
+        {
+            inputs[n] = std::sin(0.7 * n);
+        }
+
+        const std::vector<double> expected{ 0.3, -0.2 };
+        std::vector<double> params, updated;
+        net.copyParameters(params);
+
+        // With a learning rate of 1 and no momentum, the change of each parameter is its
+        // gradient for the error 0.5 * Sum((t - o)^2), i.e. calcError() * 2 / 2.
+        net.propagateForward(inputs);
+        net.propagateBackwardAndUpdateWeights(expected);
+        net.copyParameters(updated);
+
+        for (size_t n = 0; n < params.size(); n++)
+        {
+            const double step = 1.0E-6;
+            std::vector<double> shifted(params);
+            shifted[n] = params[n] + step;
+            net.restoreParameters(shifted);
+            net.propagateForward(inputs, true);
+            const double errorPlus = net.calcError(expected);
+            shifted[n] = params[n] - step;
+            net.restoreParameters(shifted);
+            net.propagateForward(inputs, true);
+            const double errorMinus = net.calcError(expected);
+
+            const double numerical = (errorPlus - errorMinus) / (2.0 * step);
+            assert(std::abs(params[n] - updated[n] - numerical) < 1.0E-6);
+        }
+    }
+
+    void convolutionAlgorithms()
+    {
+        const std::shared_ptr<const SGDOptimizer> optimizer = std::make_shared<SGDOptimizer>(0.5, 0.9);
+        const ImageShape shape(3, 6, 5);
+        std::vector<double> inputs(shape.size());
+
+        for (size_t n = 0; n < inputs.size(); n++)
+        {
+            inputs[n] = std::cos(1.3 * n);
+        }
+
+        for (size_t stride : { 1, 2 })
+        {
+            for (size_t padding : { 0, 1, 2 })
+            {
+                Conv2DLayer direct(shape, 4, 3, stride, padding, ActivationFunctions::Logistic, optimizer,
+                    std::make_shared<SeedGenerator>(true, 8));
+                Conv2DLayer im2col(shape, 4, 3, stride, padding, ActivationFunctions::Logistic, optimizer,
+                    std::make_shared<SeedGenerator>(true, 8));
+                direct.setAlgorithm(ConvAlgorithm::Direct);
+                im2col.setAlgorithm(ConvAlgorithm::Im2col);
+                assert(direct.outputShape() == ImageShape(4, (6 + 2 * padding - 3) / stride + 1,
+                    (5 + 2 * padding - 3) / stride + 1));
+
+                const std::vector<double> outputs = direct.propagateForward(inputs, false);
+                assert(outputs == im2col.propagateForward(inputs, false));
+                std::vector<double> planOutputs(outputs.size()), scratch(im2col.scratchSize());
+                assert(direct.scratchSize() == 0 && scratch.size() == 3 * 3 * shape.channels * outputs.size() / 4);
+                im2col.calcOutputs(inputs.data(), planOutputs.data(), scratch.data());
+                assert(planOutputs == outputs);
+
+                // Same gradients and deltas of the inputs through a dense layer
+                HiddenLayer next(3, outputs.size(), ActivationFunctions::Identity, optimizer,
+                    std::make_shared<SeedGenerator>(true, 9));
+                next.propagateForward(outputs, false);
+                next.propagateBackwardOuputLayer({ 0.1, 0.5, 0.9 });
+                direct.propagateBackwardHiddenLayer(next);
+                im2col.propagateBackwardHiddenLayer(next);
+
+                for (size_t i = 0; i < inputs.size(); i++)
+                {
+                    assert(std::abs(direct.sumDelta(i) - im2col.sumDelta(i)) < 1.0E-12);
+                }
+
+                direct.updateWeights(1);
+                im2col.updateWeights(1);
+                std::vector<double> directParams, im2colParams;
+                direct.copyParameters(directParams);
+                im2col.copyParameters(im2colParams);
+
+                for (size_t n = 0; n < directParams.size(); n++)
+                {
+                    assert(std::abs(directParams[n] - im2colParams[n]) < 1.0E-12);
+                }
+            }
+        }
+    }
+
+    void convolutionalNetwork()
+    {
+        // Vertical or horizontal bar on images of 6x6
+        std::vector<std::vector<double>> images;
+        std::vector<std::vector<double>> labels;
+
+        for (size_t n = 0; n < 6; n++)
+        {
+            std::vector<double> vertical(36, 0.0), horizontal(36, 0.0);
+
+            for (size_t i = 0; i < 6; i++)
+            {
+                vertical[i * 6 + n] = 1.0;
+                horizontal[n * 6 + i] = 1.0;
+            }
+
+            images.push_back(vertical);
+            labels.push_back({ 1.0, 0.0 });
+            images.push_back(horizontal);
+            labels.push_back({ 0.0, 1.0 });
+        }
+
+        NeuralNetwork net(36, 0.5, 0.5, true, 2);
+        net.setInputShape(ImageShape(1, 6, 6));
+        net.addConv2DLayer(4, 3, ActivationFunctions::Logistic, 1, 1);
+        net.addMaxPoolLayer(2);
+        net.addDropoutLayer(0.1);
+        net.addConv2DLayer(3, 2, ActivationFunctions::Logistic);
+        net.addAvgPoolLayer(2);
+        net.addHiddenLayer(4, ActivationFunctions::Logistic);
+        net.addOutputClassificationLayer(2);
+        assert(net.inputShape() == ImageShape(1, 6, 6));
+        assert(net.parametersCount() == 4 * 10 + 3 * 17 + 4 * 4 + 2 * 5);
+        assert(net.footprint().parametersN == net.parametersCount());
+
+        for (size_t epoch = 0; epoch < 300; epoch++)
+        {
+            for (size_t n = 0; n < images.size(); n++)
+            {
+                net.propagateForward(images[n]);
+                net.propagateBackwardAndUpdateWeights(labels[n]);
+            }
+        }
+
+        for (size_t n = 0; n < images.size(); n++)
+        {
+            net.propagateForward(images[n], true);
+            assert(net.probableClass() == n % 2);
+        }
+
+        // Same outputs and same training after saving and loading
+        const std::string filepath = std::string(kOutputDir) + "convolutionalNetwork.txt";
+        assert(net.saveToFile(filepath));
+        NeuralNetwork loaded = NeuralNetwork::loadFromFile(filepath);
+        std::remove(filepath.c_str());
+        assert(loaded.inputShape() == net.inputShape() && loaded.parametersCount() == net.parametersCount());
+
+        for (size_t n = 0; n < 3; n++)
+        {
+            assert(loaded.propagateForward(images[n]) == net.propagateForward(images[n]));
+            loaded.propagateBackwardAndUpdateWeights(labels[n]);
+            net.propagateBackwardAndUpdateWeights(labels[n]);
+        }
+
+        // Same outputs with the inference plan, and with activation checkpoints
+        const InferencePlan plan = net.compile();
+        assert(plan.stepsCount() == 6);
+        const std::vector<std::vector<double>> predictions = plan.predictBatch(images);
+
+        for (size_t n = 0; n < images.size(); n++)
+        {
+            const std::vector<double> outputs = net.propagateForward(images[n], true);
+            assert(plan.predict(images[n]) == outputs && predictions[n] == outputs);
+            assert(plan.probableClass(images[n]) == net.probableClass());
+        }
+
+        std::vector<double> params, checkpointedParams;
+        loaded.setActivationCheckpoints(3);
+
+        for (size_t n = 0; n < 3; n++)
+        {
+            assert(loaded.propagateForward(images[n]) == net.propagateForward(images[n]));
+            loaded.propagateBackwardAndUpdateWeights(labels[n]);
+            net.propagateBackwardAndUpdateWeights(labels[n]);
+        }
+
+        net.copyParameters(params);
+        loaded.copyParameters(checkpointedParams);
+        assert(params == checkpointedParams);
+
+        try
+        {
+            net.setInputShape(ImageShape(1, 6, 6));
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        NeuralNetwork invalid(36, 0.5);
+
+        try
+        {
+            invalid.setInputShape(ImageShape(1, 6, 5));
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        try
+        {
+            // Inputs are 36 channels of 1x1 by default
+            invalid.addConv2DLayer(2, 3, ActivationFunctions::Logistic);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        try
+        {
+            invalid.addMaxPoolLayer(0);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        try
+        {
+            net.addAvgPoolLayer(2);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+    }
+
     void batch3PBackPropRegression()
     {
         std::ostringstream os;
@@ -895,9 +1547,46 @@ private:
         compareLineByLine(__func__, os2.str(), os3.str());
     }
 
-    void xorRandomWeightsFixedSeed()
+    void batchParallelUpdate()
     {
-        std::ostringstream os;
+        // 300 x 256 weights on the hidden layer: above DenseLayer::kParallelUpdateMinWeights
+        std::vector<double> inputs(300);
+        std::vector<double> params[2];
+        const size_t threadCounts[2] = { 1, 4 };
+
+        for (size_t n = 0; n < inputs.size(); n++)
+        {
+            inputs[n] = static_cast<double>(n % 7) / 7.0;
+        }
+
+        for (size_t t = 0; t < 2; t++)
+        {
+            NeuralNetwork net(inputs.size(), 0.1, 0.9, true, 10);
+            net.addHiddenLayer(256, ActivationFunctions::Logistic);
+            net.addOutputRegressionLayer(2, ActivationFunctions::Logistic);
+            net.setThreadCount(threadCounts[t]);
+
+            for (size_t batch = 0; batch < 3; batch++)
+            {
+                for (size_t pass = 0; pass < 3; pass++)
+                {
+                    net.propagateForward(inputs);
+                    net.propagateBackward({ 0.01, 0.99 });
+                }
+
+                net.updateWeights();
+            }
+
+            net.copyParameters(params[t]);
+        }
+
+        assert(params[0].size() == 256 * 301 + 2 * 257);
+        assert(params[0] == params[1]);
+    }
+
+    void xorRandomWeightsFixedSeed()
+    {
+        std::ostringstream os;
         std::stringstream is = readExpectedResultFile(kTestDir + std::string(__func__) + kTestFileExt);
 
         NeuralNetwork net(2, 0.5, 0.9, true, 10); // Random weights but with a fixed seed
@@ -991,6 +1680,203 @@ private:
         compareLineByLine(__func__, os.str(), is.str());
     }
 
+    void xmlDocument()
+    {
+        // Same tree as the stream reader
+        std::ostringstream os;
+        std::stringstream is = readExpectedResultFile(kTestDir + std::string("xmlReadAndSave") + kTestFileExt);
+        const XMLDocument file = XMLDocument::readFile(kTestDir + std::string("xmlReadAndSave.xml"));
+        file.inspect(os);
+        compareLineByLine(__func__, os.str(), is.str());
+
+        const std::string text = "<?xml version=\"1.0\"?>\n<!DOCTYPE net>\n"
+            "<net name='n1' size = 3 empty=\"\">\n"
+            "  <layer index=\"0\"/>\n"
+            "  <layer index=\"1\"> 0.5 <!-- a > b --></layer>\n"
+            "</net>\n";
+        std::istringstream iss(text);
+        XMLDocument moved = XMLDocument::read(iss);
+        const XMLDocument doc = std::move(moved);
+        const XMLElement& root = doc.root();
+
+        assert(doc.size() == 3 && root.name == "net" && root.childrenN == 2 && root.attributesN == 3);
+        assert(*root.attribute("name") == "n1" && *root.attribute("size") == "3");
+        assert(root.attribute("empty")->empty() && root.attribute("index") == nullptr);
+        assert(root.firstChild->childrenN == 0 && root.firstChild->value.empty());
+        assert(root.child("layer") == root.firstChild && root.child("neuron") == nullptr);
+        assert(root.firstChild->nextSibling->value == "0.5" && *root.firstChild->nextSibling->attribute("index") == "1");
+        assert(root.firstChild->nextSibling->nextSibling == nullptr);
+        assert(root.firstChild->nextSibling->parent == &root);
+
+        // Deeper than the stack would allow with a recursive parser
+        std::string deep;
+
+        for (size_t n = 0; n < 200000; n++)
+        {
+            deep += "<a>";
+        }
+
+        for (size_t n = 0; n < 200000; n++)
+        {
+            deep += "</a>";
+        }
+
+        const XMLDocument deepDoc(std::vector<char>(deep.begin(), deep.end()));
+        size_t depth = 0;
+
+        for (const XMLElement* element = &deepDoc.root(); element != nullptr; element = element->firstChild)
+        {
+            ++depth;
+        }
+
+        assert(deepDoc.size() == 200000 && depth == 200000);
+
+        for (const char* invalid : { "<a><b></a>", "<a>", "text", "<a></a><b></b>", "<a b=\"1></a>" })
+        {
+            try
+            {
+                XMLDocument(std::vector<char>(invalid, invalid + std::strlen(invalid)));
+                assert(false);
+            }
+            catch (std::domain_error&) {}
+        }
+    }
+
+    void xmlQuery()
+    {
+        std::ifstream ifs(kTestDir + std::string("xmlReadAndSave.xml"));
+        std::unique_ptr<XMLNode> xml = readXMLStream(ifs);
+
+        for (bool indexChildren : { false, true })
+        {
+            const XMLQuery neurons("/nn/layers/layer[1]/neurons/neuron", indexChildren);
+            const XMLQuery neuron("nn/layers/layer[1]/neurons/neuron[2]/", indexChildren);
+            const XMLQuery missing("/nn/layers/layer[2]/neurons", indexChildren);
+            std::vector<XMLNode*> nodes;
+
+            for (size_t n = 0; n < 2; n++)
+            {
+                nodes.clear();
+                neurons.collect(*xml, nodes);
+                assert(nodes.size() == 4 && nodes[0]->value == "5.1 \"5.2\"" && nodes[3]->value == "8.1 8.2 8.3");
+                assert(neuron.node(*xml) == nodes[2] && neuron.collection(*xml) == std::vector<XMLNode*>{ nodes[2] });
+                assert(missing.node(*xml) == nullptr && missing.collection(*xml).empty());
+            }
+
+            assert(XMLQuery("/nn", indexChildren).node(*xml) == xml.get());
+            assert(XMLQuery("/other/layers", indexChildren).node(*xml) == nullptr);
+        }
+
+        assert(xml->getNode("/nn/layers/layer[1]")->attributes["name"] == "L2");
+        assert(xml->getCollection("/nn/layers/layer").size() == 2);
+        assert(xml->getNode("/nn/unknown/layers") == nullptr);
+
+        for (const char* invalid : { "", "/", "/nn/layer[", "/nn/layer[a]", "/nn/[1]", "/nn/layer[1]x" })
+        {
+            try
+            {
+                XMLQuery query(invalid);
+                assert(false);
+            }
+            catch (std::domain_error&) {}
+        }
+    }
+
+    void networkXML()
+    {
+        NeuralNetwork net(3, 0.5, 0.9, true, 10);
+        net.addHiddenLayer(5, ActivationFunctions::ReLU);
+        net.addDropoutLayer(0.2);
+        net.addHiddenLayer(4, ActivationFunctions::Tanh);
+        net.addOutputRegressionLayer(2, ActivationFunctions::Logistic);
+        net.propagateForward({ 0.05, 0.1, 0.7 });
+        net.propagateBackwardAndUpdateWeights({ 0.01, 0.99 });
+
+        std::vector<double> params;
+        net.copyParameters(params);
+
+        const std::string textpath = std::string(kOutputDir) + "networkXML.txt";
+        const std::string filepath = std::string(kOutputDir) + "networkXML.xml";
+        assert(net.saveToFile(textpath));
+
+        for (XMLBinaryEncoding encoding : { XMLBinaryEncoding::Base64, XMLBinaryEncoding::Hex })
+        {
+            assert(NetworkXML::saveToFile(net, filepath, encoding));
+
+            // Same parameters to the bit, then same dropout masks and same training as
+            // the network loaded from the text format
+            NeuralNetwork loaded = NetworkXML::loadFromFile(filepath);
+            NeuralNetwork reference = NeuralNetwork::loadFromFile(textpath);
+            std::vector<double> loadedParams;
+            loaded.copyParameters(loadedParams);
+            assert(loadedParams == params && loaded.learningRate() == net.learningRate());
+
+            for (size_t n = 0; n < 3; n++)
+            {
+                assert(loaded.propagateForward({ 0.9, 0.3, 0.2 }) == reference.propagateForward({ 0.9, 0.3, 0.2 }));
+                loaded.propagateBackwardAndUpdateWeights({ 0.7, 0.2 });
+                reference.propagateBackwardAndUpdateWeights({ 0.7, 0.2 });
+            }
+        }
+
+        std::remove(filepath.c_str());
+        std::remove(textpath.c_str());
+
+        NeuralNetwork conv(32, 0.5, 0.9, true, 6);
+        conv.setInputShape(ImageShape(2, 4, 4));
+        conv.addConv2DLayer(3, 3, ActivationFunctions::Tanh, 1, 1);
+        conv.addMaxPoolLayer(2);
+        conv.addConv2DLayer(2, 2, ActivationFunctions::ISRLU);
+        conv.addAvgPoolLayer(1);
+        conv.addOutputRegressionLayer(2, ActivationFunctions::Logistic);
+        std::vector<double> image(32, 0.25);
+        image[5] = 0.9;
+        conv.propagateForward(image);
+        conv.propagateBackwardAndUpdateWeights({ 0.2, 0.6 });
+
+        std::ostringstream convXML;
+        NetworkXML::write(conv, convXML);
+        const std::string convText = convXML.str();
+        NeuralNetwork convLoaded = NetworkXML::read(XMLDocument(std::vector<char>(convText.begin(), convText.end())));
+        assert(convLoaded.inputShape() == conv.inputShape());
+
+        for (size_t n = 0; n < 3; n++)
+        {
+            assert(convLoaded.propagateForward(image) == conv.propagateForward(image));
+            convLoaded.propagateBackwardAndUpdateWeights({ 0.2, 0.6 });
+            conv.propagateBackwardAndUpdateWeights({ 0.2, 0.6 });
+        }
+
+        NeuralNetwork classifier(2, 0.1, 0.0, true, 3);
+        classifier.addOutputClassificationLayer(3);
+        std::ostringstream os;
+        NetworkXML::write(classifier, os, XMLBinaryEncoding::Hex);
+        const std::string xml = os.str();
+        const std::string text = xml.substr(xml.find("count=\"9\">") + 10, 9 * 16);
+        assert(NetworkXML::read(XMLDocument(std::vector<char>(xml.begin(), xml.end())))
+            .propagateForward({ 0.5, 0.2 }) == classifier.propagateForward({ 0.5, 0.2 }));
+
+        // Truncated block, wrong count, invalid digit, missing output layer
+        const std::vector<std::pair<std::string, std::string>> invalids{
+            { text, text.substr(0, text.size() - 2) },
+            { "count=\"9\"", "count=\"8\"" },
+            { text, "x" + text.substr(1) },
+            { "OutputClassification", "Hidden" } };
+
+        for (const std::pair<std::string, std::string>& invalid : invalids)
+        {
+            std::string modified = xml;
+            modified.replace(modified.find(invalid.first), invalid.first.size(), invalid.second);
+
+            try
+            {
+                NetworkXML::read(XMLDocument(std::vector<char>(modified.begin(), modified.end())));
+                assert(false);
+            }
+            catch (std::domain_error&) {}
+        }
+    }
+
     void mlpRegressorConstLearningRateNoEarlyStopping()
     {
         NeuralNetwork net(2, 0.01, 0.9, true, 10); // Random weights but with a fixed seed
@@ -1205,10 +2091,16 @@ private:
         );
         mlp.fit({ {0, 0}, {0, 1}, {1, 0}, {1, 1} }, { 0, 1, 1, 0 });
 
-        for (const std::pair<std::vector<double>, double>& testSet : trainingSets)
+        for (const std::pair<std::vector<double>, uint8_t>& testSet : trainingSets)
         {
-            net.propagateForward(testSet.first);
+            const std::vector<double> probabilities = net.propagateForward(testSet.first);
             assert(net.probableClass() == mlp.predict(testSet.first));
+
+            // Top classes have the probabilities of the full softmax
+            const std::vector<std::pair<size_t, double>> top = mlp.predict_top_k(testSet.first, 5);
+            assert(top.size() == 2 && top[0].first == mlp.predict(testSet.first) && top[1].first != top[0].first);
+            assert(top[0].second == probabilities[top[0].first] && top[1].second == probabilities[top[1].first]);
+            assert(mlp.predict_top_k(testSet.first, 1).size() == 1);
         }
     }
 
@@ -1339,6 +2231,794 @@ private:
         }
     }
 
+    void mlpRegressorValidationEarlyStopping()
+    {
+        std::vector<std::vector<double>> X;
+        std::vector<double> y;
+
+        for (size_t n = 0; n < 40; n++)
+        {
+            X.push_back({ n / 40.0 });
+            y.push_back(0.5 + 0.4 * std::sin(n / 6.0));
+        }
+
+        auto buildMLP = []()
+        {
+            return MLPRegressor({ 5 },          // hidden_layer_sizes
+                ActivationFunctions::Logistic,  // activation
+                Solvers::SGD,                   // solver
+                false,                          // use_batch_size
+                1,                              // batch_size
+                LearningRate::Constant,         // learning_rate
+                0.5,                            // learning_rate_init
+                0.5,                            // power_t
+                5000,                           // max_iter
+                true,                           // use_random_state
+                10,                             // random_state
+                0.0,                            // tol
+                false,                          // verbose
+                0.9,                            // momentum
+                true,                           // early_stopping
+                10,                             // n_iter_no_change
+                0.2                             // validation_fraction
+            );
+        };
+
+        class Recorder : public TrainingObserver
+        {
+        public:
+            std::vector<double> validationLosses;
+
+            void onEpochEnd(const EpochMetrics& metrics) override
+            {
+                validationLosses.push_back(metrics.validationLoss);
+            }
+        };
+
+        const std::shared_ptr<Recorder> recorder = std::make_shared<Recorder>();
+        MLPRegressor mlp1 = buildMLP();
+        MLPRegressor mlp2 = buildMLP();
+        mlp1.setTrainingObserver(recorder);
+        mlp1.fit(X, y);
+        mlp2.fit(X, y);
+
+        assert(mlp1.iterations() > 10 && mlp1.iterations() < 5000);
+        assert(mlp1.iterations() == mlp2.iterations());
+        assert(recorder->validationLosses.size() == mlp1.iterations());
+
+        for (const std::vector<double>& x : X)
+        {
+            assert(mlp1.predict(x) == mlp2.predict(x));
+        }
+
+        // With no tolerance the training stops after 10 epochs without any improvement, so
+        // the last epoch is not the best one. The weights of the best epoch are restored:
+        // the validation error of the final model, on the same 8 samples held out as by
+        // MLP::splitValidationSet(), is the best one recorded.
+        std::vector<size_t> indices(X.size());
+        std::iota(indices.begin(), indices.end(), 0);
+        SeedGenerator seedGen(true, 10);
+        std::mt19937 generator(seedGen.seed());
+        std::shuffle(indices.begin(), indices.end(), generator);
+        double validationError = 0.0;
+
+        for (size_t v = 0; v < 8; v++)
+        {
+            validationError += std::pow(y[indices[v]] - mlp1.predict(X[indices[v]]), 2);
+        }
+
+        validationError /= 8;
+        const double bestError = *std::min_element(recorder->validationLosses.cbegin(),
+            recorder->validationLosses.cend());
+        assert(std::fabs(validationError - bestError) < 1.0E-12);
+        assert(bestError < recorder->validationLosses.back());
+    }
+
+    void learningRateSchedulers()
+    {
+        auto near = [](double a, double b) { return std::fabs(a - b) < 1.0E-12; };
+
+        // 4 epochs of 5 batches
+        WarmupScheduler warmup(4, std::make_shared<StepDecayScheduler>(2, 0.5));
+        assert(near(warmup.start(0.4, 4, 5), 0.1));
+        assert(near(warmup.batchEnd(0, 0.1), 0.2));
+        assert(near(warmup.batchEnd(2, 0.3), 0.4));
+        assert(near(warmup.batchEnd(3, 0.4), 0.4));
+        assert(near(warmup.epochEnd(0, 1.0, 0.4), 0.4));
+        assert(near(warmup.epochEnd(1, 1.0, 0.4), 0.2));
+        assert(near(warmup.epochEnd(3, 1.0, 0.2), 0.1));
+
+        CosineAnnealingScheduler cosine(0.1);
+        assert(near(cosine.start(0.5, 4, 5), 0.5));
+        assert(near(cosine.batchEnd(9, 0.5), 0.3));
+        assert(near(cosine.batchEnd(19, 0.3), 0.1));
+
+        OneCycleScheduler oneCycle(1.0, 0.25, 10.0, 100.0);
+        assert(near(oneCycle.start(0.5, 4, 5), 0.1));
+        assert(near(oneCycle.batchEnd(4, 0.1), 1.0));
+        assert(near(oneCycle.batchEnd(19, 1.0), 0.001));
+
+        // The learning rate is shared by all the neurons so that the
+        // scheduler can update it after each batch.
+        NeuralNetwork net(2, 0.5, 0.9, true, 1);
+        net.addHiddenLayer(3, ActivationFunctions::Logistic);
+        net.addOutputRegressionLayer(1, ActivationFunctions::Logistic);
+        net.updateLearningRate(0.05);
+        assert(net.learningRate() == 0.05);
+
+        auto buildMLP = []()
+        {
+            return MLPRegressor({ 3 },          // hidden_layer_sizes
+                ActivationFunctions::Logistic,  // activation
+                Solvers::SGD,                   // solver
+                true,                           // use_batch_size
+                2,                              // batch_size
+                LearningRate::Constant,         // learning_rate
+                0.5,                            // learning_rate_init
+                0.5,                            // power_t
+                50,                             // max_iter
+                true,                           // use_random_state
+                10,                             // random_state
+                1.0E-4,                         // tol
+                false,                          // verbose
+                0.9,                            // momentum
+                false,                          // early_stopping
+                10                              // n_iter_no_change
+            );
+        };
+
+        const std::vector<std::vector<double>> X = { { 0.0 }, { 0.25 }, { 0.5 }, { 0.75 } };
+        const std::vector<double> y = { 0.2, 0.6, 0.8, 0.4 };
+
+        MLPRegressor constant = buildMLP();
+        MLPRegressor oneCycleMLP = buildMLP();
+        oneCycleMLP.setLearningRateScheduler(std::make_shared<OneCycleScheduler>(0.5));
+        constant.fit(X, y);
+        oneCycleMLP.fit(X, y);
+
+        assert(constant.predict(X[1]) != oneCycleMLP.predict(X[1]));
+    }
+
+    void progressReporter()
+    {
+        std::ostringstream os;
+
+        {
+            ProgressReporter progress(os, 10, "Epoch 1 / 1 |", std::chrono::milliseconds(1), 10);
+            progress.update(5);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            progress.update(10, 0.5);
+        } // Finished by the destructor
+
+        const std::string out = os.str();
+        const std::string last = out.substr(out.find_last_of('\r') + 1);
+
+        assert(last == "Epoch 1 / 1 | 10 / 10 [ ========== ] 100% | Error: 0.5000\n");
+    }
+
+    void philoxGenerator()
+    {
+        // Known answers of the Philox4x32-10 reference implementation
+        assert((Philox4x32(0)(0, 0) == Philox4x32::Block{ 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 }));
+        assert((Philox4x32(0xa4093822 | (uint64_t(0x299f31d0) << 32))(
+            0x243f6a88 | (uint64_t(0x85a308d3) << 32), 0x13198a2e | (uint64_t(0x03707344) << 32))
+            == Philox4x32::Block{ 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 }));
+
+        // Values do not depend on how the range is split
+        const Philox4x32 philox(42);
+        std::vector<double> whole(101), split(101);
+        philox.fillUniform(whole.data(), 0, whole.size(), -0.5, 0.5, 3);
+        philox.fillUniform(split.data(), 0, 37, -0.5, 0.5, 3);
+        philox.fillUniform(split.data(), 37, split.size(), -0.5, 0.5, 3);
+        assert(whole == split);
+        assert(std::all_of(whole.cbegin(), whole.cend(), [](double w) { return w >= -0.5 && w < 0.5; }));
+
+        auto buildNet = []()
+        {
+            NeuralNetwork net(3, 0.1, 0.9, true, 5, RandomEngine::Philox);
+            net.addHiddenLayer(8, ActivationFunctions::Tanh);
+            net.addDropoutLayer(0.5);
+            net.addOutputRegressionLayer(2, ActivationFunctions::Logistic);
+            return net;
+        };
+
+        NeuralNetwork net1 = buildNet();
+        NeuralNetwork net2 = buildNet();
+        NeuralNetwork netMT(3, 0.1, 0.9, true, 5);
+        netMT.addHiddenLayer(8, ActivationFunctions::Tanh);
+        netMT.addDropoutLayer(0.5);
+        netMT.addOutputRegressionLayer(2, ActivationFunctions::Logistic);
+
+        std::vector<double> params1, params2, paramsMT;
+        net1.copyParameters(params1);
+        net2.copyParameters(params2);
+        netMT.copyParameters(paramsMT);
+        assert(params1 == params2 && params1 != paramsMT);
+
+        // Weights of a wide layer drawn on several threads are the same as on one thread
+        std::vector<double> wideParams[2];
+
+        for (size_t t = 0; t < 2; t++)
+        {
+            NeuralNetwork wide(300, 0.1, 0.9, true, 5, RandomEngine::Philox);
+            wide.setThreadCount(t == 0 ? 1 : 4);
+            wide.addHiddenLayer(256, ActivationFunctions::Tanh);
+            wide.copyParameters(wideParams[t]);
+        }
+
+        assert(wideParams[0].size() == 256 * 301 && wideParams[0] == wideParams[1]);
+
+        // The engine and the state of the dropout generators are saved with the network
+        net1.propagateForward({ 0.2, 0.4, 0.6 });
+        net1.propagateBackwardAndUpdateWeights({ 0.1, 0.9 });
+        net1.saveToFile(std::string(kOutputDir) + "philox.txt");
+        NeuralNetwork net1b = NeuralNetwork::loadFromFile(std::string(kOutputDir) + "philox.txt");
+
+        for (size_t n = 0; n < 5; n++)
+        {
+            assert(net1.propagateForward({ 0.2, 0.4, 0.6 }) == net1b.propagateForward({ 0.2, 0.4, 0.6 }));
+            net1.propagateBackwardAndUpdateWeights({ 0.1, 0.9 });
+            net1b.propagateBackwardAndUpdateWeights({ 0.1, 0.9 });
+        }
+    }
+
+    void dropoutMask()
+    {
+        // Not a multiple of 64 to test the last partial word
+        DropoutMask mask(130);
+        mask.keepAll();
+        assert(mask.kept(0) && mask.kept(64) && mask.kept(129));
+
+        std::vector<double> uniforms(130);
+
+        for (size_t n = 0; n < uniforms.size(); n++)
+        {
+            uniforms[n] = (n % 3) / 3.0;
+        }
+
+        mask.draw(uniforms.data(), 0.5);
+        mask.set(129, true);
+
+        std::vector<double> values(130, 1.5);
+        mask.apply(values.data(), values.data(), 0.5);
+
+        for (size_t n = 0; n < values.size(); n++)
+        {
+            const bool kept = n % 3 == 2 || n == 129;
+            assert(mask.kept(n) == kept);
+            assert(values[n] == (kept ? 3.0 : 0.0));
+        }
+    }
+
+    void csvReader()
+    {
+        CsvOptions irisOptions;
+        irisOptions.labels = true;
+        const CsvDataset iris = CsvReader::read(std::string(kDataDir) + "iris_flowers.csv", irisOptions);
+        assert(iris.rowsN == 150 && iris.colsN == 4 && iris.features.size() == 600);
+        assert(iris.featureNames.back() == "petal_width" && iris.targetName == "class");
+        assert((iris.labels == std::vector<std::string>{ "iris_setosa", "iris_versicolor", "iris_virginica" }));
+        assert((std::vector<double>(iris.row(0), iris.row(1)) == std::vector<double>{ 5.1, 3.5, 1.4, 0.2 }));
+        assert(iris.targets[0] == 0 && iris.targets[149] == 2);
+
+        // Target first, spaces, CRLF and empty lines
+        const std::string csv = "y;a;b\r\n1.5; -2 ;3e2\n\n-0.25;1e-3; .5\r\n7;123456789012345678901;inf\n4;0.1;-8";
+        std::istringstream is1(csv), is2(csv);
+        CsvOptions options;
+        options.delimiter = ';';
+        options.targetColumn = 0;
+        const CsvDataset serial = CsvReader::read(is1, options);
+
+        // Chunks smaller than a line and more threads than lines per chunk
+        options.threadsN = 3;
+        options.chunkSize = 5;
+        const CsvDataset parallel = CsvReader::read(is2, options);
+
+        assert(serial.rowsN == 4 && serial.colsN == 2);
+        assert((serial.targets == std::vector<double>{ 1.5, -0.25, 7, 4 }));
+        assert((serial.features == std::vector<double>{ -2, 300, 0.001, 0.5,
+            std::strtod("123456789012345678901", nullptr), std::numeric_limits<double>::infinity(), 0.1, -8 }));
+        assert(parallel.features == serial.features && parallel.targets == serial.targets);
+
+        for (const char* text : { "0.1", "-2.5e-3", "9007199254740993", "1e23", "4.9e-324", "0x1p3" })
+        {
+            double value = 0.0;
+            assert(CsvReader::parseNumber(text, text + std::strlen(text), value));
+            assert(value == std::strtod(text, nullptr));
+        }
+
+        for (const char* invalid : { "a,b\n1,2\n3,x\n", "a,b\n1,2\n3\n", "a,b\n1,2,3\n" })
+        {
+            try
+            {
+                std::istringstream is(invalid);
+                CsvReader::read(is);
+                assert(false);
+            }
+            catch (std::domain_error&) {}
+        }
+
+        // The contiguous matrix gives the same training as one vector per sample
+        std::vector<std::vector<double>> rows;
+
+        for (size_t r = 0; r < iris.rowsN; r++)
+        {
+            rows.emplace_back(iris.row(r), iris.row(r) + iris.colsN);
+        }
+
+        MLPClassifer mlp1({ 5 }, ActivationFunctions::Logistic, Solvers::SGD, false, 1,
+            LearningRate::Constant, 0.01, 0.5, 5, true, 1);
+        MLPClassifer mlp2({ 5 }, ActivationFunctions::Logistic, Solvers::SGD, false, 1,
+            LearningRate::Constant, 0.01, 0.5, 5, true, 1);
+        mlp1.fit(rows, iris.targetsAs<t_Labels>());
+        mlp2.fit(iris.features, iris.colsN, iris.targetsAs<t_Labels>());
+
+        for (const std::vector<double>& row : rows)
+        {
+            assert(mlp1.predict_top_k(row, 3) == mlp2.predict_top_k(row, 3));
+        }
+    }
+
+    void mlpStreamingFit()
+    {
+        const std::string path = std::string(kOutputDir) + "mlpStreamingFit.csv";
+        const std::vector<std::vector<double>> inputs{ {0, 0}, {0, 1}, {1, 0}, {1, 1},
+            {0.1, 0.9}, {0.9, 0.1}, {0.2, 0.2}, {0.8, 0.8} };
+        const std::vector<double> targets{ 0, 1, 1, 0, 1, 1, 0, 0 };
+
+        {
+            std::ofstream file(path);
+            file << "x1,x2,y\n";
+
+            for (size_t n = 0; n < inputs.size(); n++)
+            {
+                file << inputs[n][0] << "," << inputs[n][1] << "," << targets[n] << "\n";
+            }
+        }
+
+        // Chunks of a few lines and blocks of 3 samples
+        CsvOptions options;
+        options.chunkSize = 16;
+        CsvSampleStream stream(path, options);
+        assert(stream.size() == 8 && stream.inputSize() == 2);
+
+        {
+            DoubleBufferedReader reader(stream, 3);
+            assert(reader.next().samplesN == 3 && reader.next().samplesN == 3);
+            const SampleBatch& last = reader.next();
+            assert(last.samplesN == 2 && last.targets == std::vector<double>({ 0, 0 }));
+            assert(last.inputs == std::vector<double>({ 0.2, 0.2, 0.8, 0.8 }));
+            assert(reader.next().samplesN == 0);
+        }
+
+        // Same batches and order as with the samples in memory: same weights
+        MLPRegressor inMemory({ 5 }, ActivationFunctions::Logistic, Solvers::SGD, true, 3,
+            LearningRate::Constant, 0.05, 0.5, 200, true, 10);
+        MLPRegressor streamed({ 5 }, ActivationFunctions::Logistic, Solvers::SGD, true, 3,
+            LearningRate::Constant, 0.05, 0.5, 200, true, 10);
+        inMemory.fit(inputs, targets);
+        streamed.fit(stream);
+        assert(streamed.iterations() == inMemory.iterations());
+
+        for (const std::vector<double>& input : inputs)
+        {
+            assert(streamed.predict(input) == inMemory.predict(input));
+        }
+
+        std::remove(path.c_str());
+
+        CsvOptions irisOptions;
+        irisOptions.labels = true;
+        const CsvDataset iris = CsvReader::read(std::string(kDataDir) + "iris_flowers.csv", irisOptions);
+        CsvSampleStream irisStream(std::string(kDataDir) + "iris_flowers.csv", irisOptions);
+
+        MLPClassifer classifier({ 5 }, ActivationFunctions::Logistic, Solvers::SGD, false, 1,
+            LearningRate::Constant, 0.01, 0.5, 5, true, 1);
+        MLPClassifer streamedClassifier({ 5 }, ActivationFunctions::Logistic, Solvers::SGD, false, 1,
+            LearningRate::Constant, 0.01, 0.5, 5, true, 1);
+        classifier.fit(iris.features, iris.colsN, iris.targetsAs<t_Labels>());
+        streamedClassifier.fit(irisStream, 3);
+
+        for (size_t r = 0; r < iris.rowsN; r++)
+        {
+            const std::vector<double> row(iris.row(r), iris.row(r) + iris.colsN);
+            assert(streamedClassifier.predict_top_k(row, 3) == classifier.predict_top_k(row, 3));
+        }
+    }
+
+    void mlpPartialFit()
+    {
+        const std::vector<std::vector<double>> inputs{ {0, 0}, {0, 1}, {1, 0}, {1, 1} };
+        const std::vector<double> targets{ 0, 1, 1, 0 };
+
+        // One call to partial_fit per epoch: same weights as fit
+        MLPRegressor fitted({ 4 }, ActivationFunctions::Tanh, Solvers::SGD, true, 2,
+            LearningRate::Constant, 0.1, 0.5, 20, true, 3);
+        MLPRegressor incremental({ 4 }, ActivationFunctions::Tanh, Solvers::SGD, true, 2,
+            LearningRate::Constant, 0.1, 0.5, 20, true, 3);
+        fitted.fit(inputs, targets);
+
+        for (size_t epoch = 0; epoch < 20; epoch++)
+        {
+            incremental.partial_fit(inputs, targets);
+        }
+
+        assert(incremental.iterations() == 20);
+
+        for (const std::vector<double>& input : inputs)
+        {
+            assert(incremental.predict(input) == fitted.predict(input));
+        }
+
+        // Continues after fit
+        fitted.partial_fit({ {0.5, 0.5} }, { 0.5 });
+        assert(fitted.iterations() == 21);
+        assert(fitted.predict(inputs[0]) != incremental.predict(inputs[0]));
+
+        try
+        {
+            fitted.partial_fit({ {0, 0, 0} }, { 0 });
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        MLPClassifer classifier({ 4 }, ActivationFunctions::Logistic, Solvers::SGD, false, 1,
+            LearningRate::Constant, 0.1, 0.5, 20, true, 3);
+        try
+        {
+            classifier.partial_fit({ {0, 0} }, { 0 }, 0);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        classifier.partial_fit({ {0, 0}, {1, 1} }, { 0, 2 }, 3);
+        classifier.partial_fit({ {0, 1} }, { 1 }, 0);
+        assert(classifier.predict_top_k({ 0, 1 }, 3).size() == 3);
+
+        try
+        {
+            classifier.partial_fit({ {1, 0} }, { 3 }, 0);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+    }
+
+    void mlpCheckpointResume()
+    {
+        const std::vector<std::vector<double>> inputs{ {0, 0}, {0, 1}, {1, 0}, {1, 1} };
+        const std::vector<double> targets{ 0, 1, 1, 0 };
+        const std::string prefix = std::string(kOutputDir) + "mlpCheckpointResume";
+        std::remove((prefix + ".latest").c_str());
+
+        // A large tol makes the adaptive schedule depend on the losses of the previous epochs
+        auto buildMLP = []()
+        {
+            return MLPRegressor({ 4 }, ActivationFunctions::Tanh, Solvers::SGD, true, 2,
+                LearningRate::Adaptive, 0.1, 0.5, 20, true, 3, 1.0);
+        };
+
+        MLPRegressor trained = buildMLP();
+        std::shared_ptr<CheckpointWriter> writer = std::make_shared<CheckpointWriter>(prefix, 2);
+        trained.setCheckpointWriter(writer);
+
+        for (size_t epoch = 0; epoch < 3; epoch++)
+        {
+            trained.partial_fit(inputs, targets);
+        }
+
+        writer->wait();
+        trained.setCheckpointWriter(nullptr);
+
+        for (size_t epoch = 0; epoch < 3; epoch++)
+        {
+            trained.partial_fit(inputs, targets);
+        }
+
+        MLPRegressor resumed = buildMLP();
+        assert(resumed.restoreCheckpoint(prefix, 2));
+        assert(resumed.iterations() == 3);
+
+        for (size_t epoch = 0; epoch < 3; epoch++)
+        {
+            resumed.partial_fit(inputs, targets);
+        }
+
+        assert(resumed.iterations() == 6);
+
+        for (const std::vector<double>& input : inputs)
+        {
+            assert(resumed.predict(input) == trained.predict(input));
+        }
+
+        try
+        {
+            MLPRegressor other({ 3 }, ActivationFunctions::Tanh);
+            other.restoreCheckpoint(prefix, 2);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        for (const std::string& file : writer->checkpoints())
+        {
+            std::remove(file.c_str());
+        }
+
+        std::remove((prefix + ".latest").c_str());
+        assert(!buildMLP().restoreCheckpoint(prefix, 2));
+    }
+
+    void trainingObserver()
+    {
+        class Recorder : public TrainingObserver
+        {
+        public:
+            size_t phases[4] = { 0, 0, 0, 0 };
+            std::vector<EpochMetrics> epochs;
+            size_t epochsN = 0;
+
+            void onPhase(TrainingPhase phase, double seconds) override
+            {
+                assert(seconds >= 0.0);
+                ++phases[static_cast<size_t>(phase)];
+            }
+
+            void onEpochEnd(const EpochMetrics& metrics) override
+            {
+                epochs.push_back(metrics);
+            }
+
+            void onTrainingEnd(size_t n, double seconds) override
+            {
+                epochsN = n;
+            }
+        };
+
+        const std::vector<std::vector<double>> X = { { 0.0, 0.0 }, { 0.0, 1.0 }, { 1.0, 0.0 }, { 1.0, 1.0 } };
+        const std::vector<t_Labels> y = { 0, 1, 1, 0 };
+
+        MLPClassifer mlp({ 3 },             // hidden_layer_sizes
+            ActivationFunctions::Tanh,      // activation
+            Solvers::SGD,                   // solver
+            true,                           // use_batch_size
+            3,                              // batch_size
+            LearningRate::Constant,         // learning_rate
+            0.1,                            // learning_rate_init
+            0.5,                            // power_t
+            20,                             // max_iter
+            true,                           // use_random_state
+            10,                             // random_state
+            1.0E-4,                         // tol
+            false,                          // verbose
+            0.9,                            // momentum
+            false,                          // early_stopping
+            10                              // n_iter_no_change
+        );
+
+        std::shared_ptr<Recorder> recorder = std::make_shared<Recorder>();
+        mlp.setTrainingObserver(recorder);
+        mlp.fit(X, y);
+
+        assert(recorder->epochsN == 20 && recorder->epochs.size() == 20);
+        assert(recorder->phases[static_cast<size_t>(TrainingPhase::Data)] == 20 * 4);
+        assert(recorder->phases[static_cast<size_t>(TrainingPhase::Forward)] == 20 * 4);
+        assert(recorder->phases[static_cast<size_t>(TrainingPhase::Backward)] == 20 * 4);
+        assert(recorder->phases[static_cast<size_t>(TrainingPhase::Update)] == 20 * 2);
+
+        for (size_t e = 0; e < recorder->epochs.size(); e++)
+        {
+            const EpochMetrics& m = recorder->epochs[e];
+            assert(m.epoch == e && m.samplesN == 4 && m.batchesN == 2);
+            assert(m.loss > 0.0 && std::isnan(m.validationLoss) && m.learningRate == 0.1);
+            assert(m.dataSeconds + m.forwardSeconds + m.backwardSeconds + m.updateSeconds <= m.totalSeconds);
+        }
+
+        // A training interrupted by the observer leaves no plan of the previous network
+        class Interrupter : public TrainingObserver
+        {
+        public:
+            void onEpochEnd(const EpochMetrics& metrics) override
+            {
+                throw std::runtime_error("Interrupted");
+            }
+        };
+
+        mlp.predict(X[0]);
+        mlp.setTrainingObserver(std::make_shared<Interrupter>());
+
+        try
+        {
+            mlp.fit(X, y);
+            assert(false);
+        }
+        catch (std::runtime_error&) {}
+
+        try
+        {
+            mlp.predict(X[0]);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        // Observer attached directly to the network
+        NeuralNetwork net(2, 0.5, 0.9, true, 1);
+        net.addHiddenLayer(3, ActivationFunctions::Logistic);
+        net.addOutputRegressionLayer(1, ActivationFunctions::Logistic);
+        std::shared_ptr<Recorder> netRecorder = std::make_shared<Recorder>();
+        net.setObserver(netRecorder);
+        net.propagateForward({ 1.0, 0.0 });
+        net.propagateBackwardAndUpdateWeights(1.0);
+        net.setObserver(nullptr);
+        net.propagateForward({ 1.0, 0.0 });
+
+        assert(netRecorder->phases[static_cast<size_t>(TrainingPhase::Forward)] == 1);
+        assert(netRecorder->phases[static_cast<size_t>(TrainingPhase::Backward)] == 1);
+        assert(netRecorder->phases[static_cast<size_t>(TrainingPhase::Update)] == 1);
+    }
+
+    void layerProfiler()
+    {
+        NeuralNetwork net(4, 0.5, 0.9, true, 1);
+        net.addHiddenLayer(3, ActivationFunctions::Logistic);
+        net.addDropoutLayer(0.2);
+        net.addOutputRegressionLayer(2, ActivationFunctions::Logistic);
+        std::shared_ptr<LayerProfiler> profiler = std::make_shared<LayerProfiler>();
+        net.setLayerProfiler(profiler);
+
+        for (size_t n = 0; n < 3; n++)
+        {
+            net.propagateForward({ 1.0, 0.0, 0.5, 0.2 });
+            net.propagateBackwardAndUpdateWeights({ 1.0, 0.0 });
+        }
+
+        net.setLayerProfiler(nullptr);
+        net.propagateForward({ 1.0, 0.0, 0.5, 0.2 });
+
+        const std::vector<LayerProfile>& layers = profiler->layers();
+        assert(layers.size() == 3);
+        const LayerProfile& hidden = layers[0];
+        const LayerProfile& dropout = layers[1];
+        const LayerProfile& output = layers[2];
+        assert(hidden.type == LayerType::Hidden && hidden.size == 3);
+        assert(dropout.type == LayerType::Dropout && output.type == LayerType::OutputRegression);
+
+        for (const LayerProfile& layer : layers)
+        {
+            for (size_t phaseN = 1; phaseN < 4; phaseN++)
+            {
+                assert(layer.calls[phaseN] == 3 && layer.seconds[phaseN] >= 0.0);
+            }
+        }
+
+        // 15 parameters: weighted sums and activations, sums of the deltas of the
+        // output layer done by the dropout layer, update with momentum
+        assert(hidden.flops[1] == 3 * (2.0 * 15 + 3) && hidden.flops[2] == 3 * (2.0 * 3 + 2.0 * 15));
+        assert(hidden.flops[3] == 3 * 5.0 * 15 && hidden.bytes[3] == 3 * 6.0 * 15 * sizeof(double));
+        assert(dropout.flops[2] == 3 * 2.0 * 3 * 2 && dropout.flops[3] == 0.0);
+        assert(output.flops[1] == 3 * (2.0 * 8 + 2));
+
+        std::ostringstream os;
+        net.inspectProfile(os);
+        assert(os.str().empty());
+        profiler->inspect(os);
+        assert(os.str().find("* Layer 2 Dropout of 3 neurons") != std::string::npos);
+
+        profiler->reset();
+        assert(profiler->layers().empty());
+    }
+
+    void networkFootprint()
+    {
+        NeuralNetwork net(4, 0.5, 0.9, true, 1);
+        net.addHiddenLayer(3, ActivationFunctions::Logistic);
+        net.addDropoutLayer(0.2);
+        net.addOutputClassificationLayer(2);
+
+        // Hidden: 15 parameters, previous changes and gradients, 4 inputs kept, outputs
+        // and deltas. Dropout: mask, sums of the deltas. Output: 8 parameters, 3 inputs
+        // kept, outputs and deltas of the neurons and of the softmax.
+        const NetworkFootprint footprint = net.footprint();
+        assert(footprint.layers.size() == 3 && footprint.widestLayer == 4);
+        assert(footprint.parametersN == net.parametersCount() && footprint.parameterBytes == 23 * sizeof(double));
+        assert(footprint.layers[0].memory.trainingBytes == (2 * 15 + 4) * sizeof(double));
+        assert(footprint.layers[1].memory.trainingBytes == sizeof(uint64_t) + 3 * sizeof(double));
+        assert(footprint.layers[2].memory.activationBytes == (2 * 2 + 2) * sizeof(double));
+        assert(footprint.trainingBytes == (34 + 1 + 3 + 19) * sizeof(double));
+        assert(footprint.activationBytes == 12 * sizeof(double));
+        assert(footprint.trainingTotalBytes() == (23 + 57 + 12) * sizeof(double));
+        assert(footprint.batchActivationBytes(10) == 2 * 10 * 4 * sizeof(double));
+
+        // Forward: weighted sums and activations, rescaling. Backward: the dropout layer
+        // sums the deltas of the output layer.
+        assert(footprint.forwardFlops == 33 + 3 + 18 && footprint.backwardFlops == 36 + 12 + 20);
+        assert(footprint.updateFlops == 5 * 23 && footprint.trainingFlops(10, 4) == 10 * 122 + 3 * 115);
+
+        std::ostringstream os;
+        footprint.inspect(os);
+        assert(os.str().find("* Parameters: 23 (184 bytes)") != std::string::npos);
+
+        MLPClassifer mlp({ 5 }, ActivationFunctions::ReLU, Solvers::SGD, false, 1, LearningRate::Constant,
+            0.1, 0.5, 2, true, 10, 1.0E-4, false, 0.9, false, 10);
+
+        try
+        {
+            mlp.footprint();
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        mlp.fit(std::vector<std::vector<double>>{ { 0.0, 1.0, 0.5 }, { 1.0, 0.0, 0.2 } }, std::vector<t_Labels>{ 0, 1 });
+        assert(mlp.footprint().parametersN == 5 * 4 + 2 * 6);
+    }
+
+    void autotuner()
+    {
+        const std::string cachePath = std::string(kOutputDir) + "autotuner.txt";
+        std::remove(cachePath.c_str());
+
+        NeuralNetwork net(4, 0.5, 0.9, true, 1);
+        net.addHiddenLayer(3, ActivationFunctions::Logistic);
+        net.addDropoutLayer(0.2);
+        net.addOutputClassificationLayer(2);
+        std::vector<double> params, tunedParams;
+        net.copyParameters(params);
+        const std::vector<double> outputs = net.propagateForward({ 1.0, 0.0, 0.5, 0.2 });
+        const std::string key = Autotuner::topologyKey(net);
+        assert(key == "4-H3-D3-C2@" + std::to_string(std::thread::hardware_concurrency()));
+
+        Autotuner tuner(cachePath, 0.002);
+        tuner.setCandidates({ 1, 8 }, { 1, 2 });
+        const TunedConfig config = tuner.tune(net);
+        assert((config.batchSize == 1 || config.batchSize == 8) && (config.threadsN == 1 || config.threadsN == 2));
+        assert((config.predictBatchSize == 1 || config.predictBatchSize == 8));
+        assert(config.samplesPerSecond > 0.0 && config.predictionsPerSecond > 0.0);
+
+        // The trials leave the network as it was: same weights, same next dropout mask
+        net.copyParameters(tunedParams);
+        assert(tunedParams == params && net.threadCount() == 1);
+        NeuralNetwork untuned(4, 0.5, 0.9, true, 1);
+        untuned.addHiddenLayer(3, ActivationFunctions::Logistic);
+        untuned.addDropoutLayer(0.2);
+        untuned.addOutputClassificationLayer(2);
+        untuned.propagateForward({ 1.0, 0.0, 0.5, 0.2 });
+        assert(net.propagateForward({ 0.3, 0.1, 0.5, 0.9 }) == untuned.propagateForward({ 0.3, 0.1, 0.5, 0.9 }));
+
+        // Read back from the cache by another tuner without trials
+        std::ifstream cache(cachePath);
+        std::string line;
+        std::getline(cache, line);
+        std::getline(cache, line);
+        assert(line.find(key + " " + std::to_string(config.batchSize) + " " + std::to_string(config.threadsN)) == 0);
+
+        Autotuner cachedTuner(cachePath, 60.0);
+        const TunedConfig cached = cachedTuner.apply(net);
+        assert(cached.batchSize == config.batchSize && cached.predictBatchSize == config.predictBatchSize);
+        assert(net.threadCount() == config.threadsN);
+
+        try
+        {
+            tuner.setCandidates({ 1, 0 }, { 1 });
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        MLPRegressor mlp({ 3 }, ActivationFunctions::Logistic, Solvers::SGD, false, 1, LearningRate::Constant,
+            0.1, 0.5, 2, true, 10, 1.0E-4, false, 0.9, false, 10);
+
+        try
+        {
+            mlp.autotune(tuner);
+            assert(false);
+        }
+        catch (std::domain_error&) {}
+
+        mlp.fit(std::vector<std::vector<double>>{ { 0.0, 1.0 }, { 1.0, 0.0 } }, std::vector<double>{ 0.0, 1.0 });
+        const TunedConfig applied = mlp.autotune(tuner);
+        assert(applied.batchSize == 1 || applied.batchSize == 8);
+        mlp.fit(std::vector<std::vector<double>>{ { 0.0, 1.0 }, { 1.0, 0.0 } }, std::vector<double>{ 0.0, 1.0 });
+
+        std::remove(cachePath.c_str());
+    }
+
     std::stringstream readExpectedResultFile(const std::string& filepath)
     {
         std::ifstream is(filepath);
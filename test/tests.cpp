@@ -4,21 +4,48 @@
 
 #include "UnitTests.h"
 #include <chrono>   // std::chrono
+#include <functional> // std::function
 
 using namespace YANNL;
 
+//! Usage: tests [group...]
+//! Runs all the groups of tests when no argument is provided. Otherwise only runs the
+//! groups named: exceptions, neural-network, batch, other, mnist, xml, mlp.
 int main(int argc, char* argv[])
 {
     auto t0 = std::chrono::high_resolution_clock::now();
 
     YANNL_UnitTests tests;
-    tests.execExceptionTests();
-    tests.execNeuralNetworkTests();
-    tests.execBatchTrainingTests();
-    tests.execOtherTests();
-    tests.execMnistTests();
-    tests.execXMLTests();
-    tests.execMLPTests();
+    const std::vector<std::pair<std::string, std::function<void()>>> groups{
+        { "exceptions", [&]() { tests.execExceptionTests(); } },
+        { "neural-network", [&]() { tests.execNeuralNetworkTests(); } },
+        { "batch", [&]() { tests.execBatchTrainingTests(); } },
+        { "other", [&]() { tests.execOtherTests(); } },
+        { "mnist", [&]() { tests.execMnistTests(); } },
+        { "xml", [&]() { tests.execXMLTests(); } },
+        { "mlp", [&]() { tests.execMLPTests(); } }
+    };
+
+    const std::vector<std::string> selected(argv + 1, argv + argc);
+
+    for (const std::string& name : selected)
+    {
+        if (std::find_if(groups.cbegin(), groups.cend(),
+            [&](const std::pair<std::string, std::function<void()>>& group) { return group.first == name; })
+            == groups.cend())
+        {
+            std::cerr << "Unknown group of tests " << name << "\n";
+            return 1;
+        }
+    }
+
+    for (const std::pair<std::string, std::function<void()>>& group : groups)
+    {
+        if (selected.empty() || std::find(selected.cbegin(), selected.cend(), group.first) != selected.cend())
+        {
+            group.second();
+        }
+    }
 
     auto t1 = std::chrono::high_resolution_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();